@@ -23,6 +23,8 @@
 
 #import <AudioUnit/AudioUnit.h>
 #import <Foundation/Foundation.h>
+#import "BKCBase.h"
+#import "BKCRenderCounters.h"
 
 #if __IPHONE_OS_VERSION_MIN_REQUIRED
 #	import <AudioToolbox/AudioToolbox.h>
@@ -36,6 +38,14 @@
  */
 typedef void (^ BKCAudioUnitRenderBlock) (BKCAudioUnit * unit, SInt16 * outBuffer, UInt32 inNumberFrames);
 
+/**
+ * Render block which provides sound data in the unit's output format
+ *
+ * `outBuffers` contains one buffer per channel if the unit is not interleaved,
+ * otherwise a single buffer
+ */
+typedef void (^ BKCAudioUnitBufferRenderBlock) (BKCAudioUnit * unit, void * const * outBuffers, UInt32 inNumberFrames);
+
 /**
  * Delegate object on which the render method is called
  */
@@ -46,6 +56,17 @@ typedef void (^ BKCAudioUnitRenderBlock) (BKCAudioUnit * unit, SInt16 * outBuffe
  */
 - (void)audioOutputUnitRender:(BKCAudioUnit *)unit outFrames:(SInt16 *)outBuffer numberFrames:(UInt32)inNumberFrames;
 
+@optional
+
+/**
+ * Render method which provides sound data in the unit's output format
+ *
+ * Is called instead of audioOutputUnitRender:outFrames:numberFrames:
+ * if implemented. `outBuffers` contains one buffer per channel if the unit
+ * is not interleaved, otherwise a single buffer.
+ */
+- (void)audioOutputUnitRender:(BKCAudioUnit *)unit outBuffers:(void * const *)outBuffers numberFrames:(UInt32)inNumberFrames;
+
 @end
 
 /**
@@ -56,6 +77,8 @@ typedef void (^ BKCAudioUnitRenderBlock) (BKCAudioUnit * unit, SInt16 * outBuffe
 	AudioStreamBasicDescription streamDescription;
 	AudioComponentInstance      audioComponent;
 	IMP                         delegateMethod;
+	IMP                         bufferDelegateMethod;
+	BKCRenderCounters           renderCounters;
 #if __IPHONE_OS_VERSION_MIN_REQUIRED
 	id                          interruptObserver;
 #endif
@@ -71,6 +94,20 @@ typedef void (^ BKCAudioUnitRenderBlock) (BKCAudioUnit * unit, SInt16 * outBuffe
  */
 @property (assign) UInt32 numberOfChannels;
 
+/**
+ * Sample format of output
+ *
+ * Default is BKCSampleFormatInt16
+ */
+@property (assign, nonatomic) BKCSampleFormat sampleFormat;
+
+/**
+ * Output channels are interleaved
+ *
+ * Default is YES. If NO, a separate buffer is used for every channel.
+ */
+@property (assign, nonatomic) BOOL interleaved;
+
 /**
  * Delegate
  */
@@ -81,6 +118,13 @@ typedef void (^ BKCAudioUnitRenderBlock) (BKCAudioUnit * unit, SInt16 * outBuffe
  */
 @property (copy) BKCAudioUnitRenderBlock renderBlock;
 
+/**
+ * Render block which provides sound data in the unit's output format
+ *
+ * Is used instead of `renderBlock` if assigned
+ */
+@property (copy) BKCAudioUnitBufferRenderBlock bufferRenderBlock;
+
 /**
  * Check if started
  */
@@ -91,6 +135,34 @@ typedef void (^ BKCAudioUnitRenderBlock) (BKCAudioUnit * unit, SInt16 * outBuffe
  */
 @property (readwrite) NSRecursiveLock * unitLock;
 
+/**
+ * Take `unitLock` in render callback
+ *
+ * Default is YES. Can be disabled if the render data is changed
+ * otherwise, e.g. through a BKCCommandQueue. The delegate and render block
+ * must then not be changed while the unit is started.
+ */
+@property (assign) BOOL locksRenderCallback;
+
+/**
+ * Counters of the render callback
+ */
+@property (readonly, nonatomic) BKCRenderCounters * renderCounters;
+
+/**
+ * Snapshot of render callback counters
+ *
+ * Contains callback times, time spent waiting on `unitLock` and the number
+ * of callbacks which took longer than the duration of their buffer. Can be
+ * read from any thread without locking.
+ */
+@property (readonly, nonatomic) BKCRenderThreadStatistics renderThreadStatistics;
+
+/**
+ * Set render callback counters to 0
+ */
+- (void)resetRenderThreadStatistics;
+
 /**
  * Initialize with number of channels and sample rate
  */
@@ -21,11 +21,17 @@
  * IN THE SOFTWARE.
  */
 
+#import "BKCBase.h"
+
+#if BKC_AUDIO_UNIT
+
 #import "BKCAudioUnit.h"
+#import "BKCRealtimeChecker.h"
 
 #define DEFAULT_NUM_CHANNELS 2
 #define DEFAULT_SAMPLE_RATE 44100
 #define DEFAULT_NUM_BITS 16
+#define MAX_NUM_CHANNELS 8
 
 #ifdef __IPHONE_OS_VERSION_MIN_REQUIRED
 #	define AUDIO_COMPONENT_SUB_TYPE kAudioUnitSubType_RemoteIO
@@ -34,6 +40,7 @@
 #endif
 
 typedef OSStatus (* BKCDelegateMethodFunc) (id, SEL, id, SInt16 *, UInt32);
+typedef OSStatus (* BKCBufferDelegateMethodFunc) (id, SEL, id, void * const *, UInt32);
 
 @interface BKCAudioUnit ()
 
@@ -44,29 +51,53 @@ typedef OSStatus (* BKCDelegateMethodFunc) (id, SEL, id, SInt16 *, UInt32);
 @implementation BKCAudioUnit
 
 static SEL delegateSelector;
+static SEL bufferDelegateSelector;
 
 @synthesize sampleRate;
 @synthesize numberOfChannels;
 @synthesize delegate;
 @synthesize renderBlock;
+@synthesize bufferRenderBlock;
+@synthesize sampleFormat;
+@synthesize interleaved;
 @synthesize unitLock;
+@synthesize locksRenderCallback;
 @synthesize isStarted;
 
 + (void)initialize
 {
-	delegateSelector = @selector(audioOutputUnitRender:outFrames:numberFrames:);
+	delegateSelector       = @selector(audioOutputUnitRender:outFrames:numberFrames:);
+	bufferDelegateSelector = @selector(audioOutputUnitRender:outBuffers:numberFrames:);
 }
 
 - (BOOL)initializeStreamDescription
 {
 	OSErr err;
+	UInt32 numBits = DEFAULT_NUM_BITS;
+	UInt32 numBufferChannels = interleaved ? numberOfChannels : 1;
+	AudioFormatFlags flags = kAudioFormatFlagIsSignedInteger;
+
+	if (sampleFormat == BKCSampleFormatFloat32) {
+		numBits = 32;
+		flags   = kAudioFormatFlagIsFloat;
+	}
+
+	if (interleaved == NO) {
+		// render callback passes at most this many buffers
+		if (numberOfChannels > MAX_NUM_CHANNELS) {
+			NSLog (@"*** Non-interleaved output supports at most %d channels", MAX_NUM_CHANNELS);
+			return NO;
+		}
+
+		flags |= kAudioFormatFlagIsNonInterleaved;
+	}
 
 	streamDescription.mSampleRate       = sampleRate;
 	streamDescription.mFormatID         = kAudioFormatLinearPCM;
-	streamDescription.mFormatFlags      = kAudioFormatFlagIsSignedInteger | kAudioFormatFlagsNativeEndian | kAudioFormatFlagIsPacked;
-	streamDescription.mBitsPerChannel   = DEFAULT_NUM_BITS;
+	streamDescription.mFormatFlags      = flags | kAudioFormatFlagsNativeEndian | kAudioFormatFlagIsPacked;
+	streamDescription.mBitsPerChannel   = numBits;
 	streamDescription.mChannelsPerFrame = numberOfChannels;
-	streamDescription.mBytesPerFrame    = numberOfChannels * DEFAULT_NUM_BITS / 8;
+	streamDescription.mBytesPerFrame    = numBufferChannels * numBits / 8;
 	streamDescription.mFramesPerPacket  = 1;
 	streamDescription.mBytesPerPacket   = streamDescription.mFramesPerPacket * streamDescription.mBytesPerFrame;
 
@@ -96,19 +127,89 @@ static SEL delegateSelector;
 	return YES;
 }
 
+/**
+ * Take lock and record time spent waiting
+ */
+static void lockRenderCallback (BKCAudioUnit * self)
+{
+	UInt64 startTime = BKCRenderClockNow ();
+
+	[self lock];
+
+	BKCRenderCountersAddLockWait (& self -> renderCounters, BKCRenderClockNow () - startTime);
+}
+
+/**
+ * Render all buffers at once in the unit's output format
+ */
+static OSStatus renderBuffers (BKCAudioUnit * self, UInt32 inNumberFrames, AudioBufferList * ioData, BOOL locks)
+{
+	void                      * outBuffers [MAX_NUM_CHANNELS];
+	UInt32                      numBuffers = ioData -> mNumberBuffers;
+	BKCBufferDelegateMethodFunc callback;
+
+	// buffers don't match the configured format
+	if (numBuffers > MAX_NUM_CHANNELS || (self -> interleaved == NO && numBuffers < self -> numberOfChannels)) {
+		for (UInt32 i = 0; i < numBuffers; i ++) {
+			memset (ioData -> mBuffers [i].mData, 0, ioData -> mBuffers [i].mDataByteSize);
+		}
+
+		return noErr;
+	}
+
+	for (UInt32 i = 0; i < numBuffers; i ++) {
+		outBuffers [i] = ioData -> mBuffers [i].mData;
+	}
+
+	if (locks) {
+		lockRenderCallback (self);
+	}
+
+	callback = (void *) self -> bufferDelegateMethod;
+
+	if (self -> bufferRenderBlock) {
+		self -> bufferRenderBlock (self, outBuffers, inNumberFrames);
+	}
+	else if (callback) {
+		callback (self -> delegate, bufferDelegateSelector, self, outBuffers, inNumberFrames);
+	}
+
+	if (locks) {
+		[self unlock];
+	}
+
+	return noErr;
+}
+
 static OSStatus renderCallback (BKCAudioUnit * self, AudioUnitRenderActionFlags * ioActionFlags, const AudioTimeStamp * inTimeStamp, UInt32 inBusNumber, UInt32 inNumberFrames, AudioBufferList * ioData)
 {
 	SInt16              * outFrames;
 	AudioBuffer         * buffer;
 	UInt32                numberFrames;
 	BKCDelegateMethodFunc callback;
+	BOOL                  locks = self -> locksRenderCallback;
+	UInt64                startTime = BKCRenderClockNow ();
+	UInt64                deadline = (UInt64) inNumberFrames * 1000000000 / MAX (self -> sampleRate, 1);
+
+	BKC_REALTIME_SECTION_BEGIN ();
+
+	if (self -> bufferRenderBlock || self -> bufferDelegateMethod) {
+		renderBuffers (self, inNumberFrames, ioData, locks);
+		BKCRenderCountersAddCallback (& self -> renderCounters, BKCRenderClockNow () - startTime, deadline);
+		BKC_REALTIME_SECTION_END ();
+
+		return noErr;
+	}
 
 	for (NSInteger i = 0; i < ioData -> mNumberBuffers; i ++) {
 		buffer       = & ioData -> mBuffers [i];
 		numberFrames = buffer -> mDataByteSize / buffer -> mNumberChannels / sizeof (SInt16);
 		outFrames    = (SInt16 *) buffer -> mData;
 
-		[self lock];
+		if (locks) {
+			lockRenderCallback (self);
+		}
+
 		{
 			callback = (void *) self -> delegateMethod;
 
@@ -119,9 +220,15 @@ static OSStatus renderCallback (BKCAudioUnit * self, AudioUnitRenderActionFlags
 				callback (self -> delegate, delegateSelector, self, outFrames, numberFrames);
 			}
 		}
-		[self unlock];
+
+		if (locks) {
+			[self unlock];
+		}
 	}
 
+	BKCRenderCountersAddCallback (& self -> renderCounters, BKCRenderClockNow () - startTime, deadline);
+	BKC_REALTIME_SECTION_END ();
+
 	return noErr;
 }
 
@@ -138,9 +245,13 @@ static OSStatus renderCallback (BKCAudioUnit * self, AudioUnitRenderActionFlags
 
 	if ((self = [super init])) {
 		unitLock = [[NSRecursiveLock alloc] init];
+		locksRenderCallback = YES;
+		BKCRenderCountersReset (& renderCounters);
 
 		numberOfChannels = theNumberOfChannels;
 		sampleRate       = theSampleRate;
+		sampleFormat     = BKCSampleFormatInt16;
+		interleaved      = YES;
 
 		memset (& defaultOutputDescription, 0, sizeof (defaultOutputDescription));
 
@@ -206,6 +317,34 @@ static OSStatus renderCallback (BKCAudioUnit * self, AudioUnitRenderActionFlags
 	}
 }
 
+- (BKCSampleFormat)sampleFormat
+{
+	return sampleFormat;
+}
+
+- (void)setSampleFormat:(BKCSampleFormat)newSampleFormat
+{
+	sampleFormat = newSampleFormat;
+
+	if ([self initializeStreamDescription] == NO) {
+		NSLog (@"*** Error setting sample format");
+	}
+}
+
+- (BOOL)interleaved
+{
+	return interleaved;
+}
+
+- (void)setInterleaved:(BOOL)newInterleaved
+{
+	interleaved = newInterleaved;
+
+	if ([self initializeStreamDescription] == NO) {
+		NSLog (@"*** Error setting interleaved");
+	}
+}
+
 - (id<BKCAudioUnitDelegate>)delegate
 {
 	return delegate;
@@ -215,7 +354,12 @@ static OSStatus renderCallback (BKCAudioUnit * self, AudioUnitRenderActionFlags
 {
 	[self lock];
 
-	delegateMethod = [(id) newDelegate methodForSelector:delegateSelector];
+	delegateMethod       = [(id) newDelegate methodForSelector:delegateSelector];
+	bufferDelegateMethod = NULL;
+
+	if ([(id) newDelegate respondsToSelector:bufferDelegateSelector]) {
+		bufferDelegateMethod = [(id) newDelegate methodForSelector:bufferDelegateSelector];
+	}
 
 	if (delegateMethod) {
 		delegate = newDelegate;
@@ -239,16 +383,53 @@ static OSStatus renderCallback (BKCAudioUnit * self, AudioUnitRenderActionFlags
 	[self unlock];
 }
 
+- (BKCAudioUnitBufferRenderBlock)bufferRenderBlock
+{
+	return [bufferRenderBlock copy];
+}
+
+- (void)setBufferRenderBlock:(BKCAudioUnitBufferRenderBlock)newBufferRenderBlock
+{
+	[self lock];
+	bufferRenderBlock = [newBufferRenderBlock copy];
+	[self unlock];
+}
+
+- (BKCRenderCounters *)renderCounters
+{
+	return & renderCounters;
+}
+
+- (BKCRenderThreadStatistics)renderThreadStatistics
+{
+	BKCRenderThreadStatistics statistics;
+
+	memset (& statistics, 0, sizeof (statistics));
+	BKCRenderCountersGetStatistics (& renderCounters, & statistics);
+
+	return statistics;
+}
+
+- (void)resetRenderThreadStatistics
+{
+	BKCRenderCountersReset (& renderCounters);
+}
+
 - (BOOL)start
 {
 	OSErr err;
 	AURenderCallbackStruct input;
 
-	if (delegate == nil && renderBlock == NULL) {
+	if (delegate == nil && renderBlock == NULL && bufferRenderBlock == NULL) {
 		NSLog (@"*** No delegate set");
 		return NO;
 	}
 
+	if ((sampleFormat != BKCSampleFormatInt16 || interleaved == NO) && bufferRenderBlock == NULL && bufferDelegateMethod == NULL) {
+		NSLog (@"*** Output format needs a buffer render block or a delegate implementing %s", sel_getName (bufferDelegateSelector));
+		return NO;
+	}
+
 #ifdef __IPHONE_OS_VERSION_MIN_REQUIRED
 	NSError * error = nil;
 	AVAudioSession * audioSession = [AVAudioSession sharedInstance];
@@ -342,3 +523,5 @@ static OSStatus renderCallback (BKCAudioUnit * self, AudioUnitRenderActionFlags
 }
 
 @end
+
+#endif
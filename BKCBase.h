@@ -24,6 +24,38 @@
 #import <Foundation/Foundation.h>
 #import "BlipKit.h"
 
+/**
+ * Output through AudioUnit
+ *
+ * Set to 0 to build without AudioUnit; contexts then only render offline
+ */
+#ifndef BKC_AUDIO_UNIT
+#	ifdef __APPLE__
+#		define BKC_AUDIO_UNIT 1
+#	else
+#		define BKC_AUDIO_UNIT 0
+#	endif
+#endif
+
+#ifndef __APPLE__
+typedef uint8_t  UInt8;
+typedef int16_t  SInt16;
+typedef uint16_t UInt16;
+typedef int32_t  SInt32;
+typedef uint32_t UInt32;
+typedef int64_t  SInt64;
+typedef uint64_t UInt64;
+#endif
+
+/**
+ * Sample format of output buffers
+ */
+typedef NS_ENUM(NSInteger, BKCSampleFormat)
+{
+	BKCSampleFormatInt16,
+	BKCSampleFormatFloat32,
+};
+
 /**
  * The following types are defined to be usable in Swift
  */
@@ -0,0 +1,147 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+#import "BKCContext.h"
+
+/**
+ * A song which is compiled and rendered by BKCBatchRenderer
+ */
+@interface BKCRenderJob : NSObject
+
+/**
+ * Source of song
+ */
+@property (readonly, nonatomic) NSData * source;
+
+/**
+ * Source file if initialized with URL
+ */
+@property (readonly, nonatomic) NSURL * sourceURL;
+
+/**
+ * File to write output to
+ *
+ * If nil, the rendered frames are collected in `data`
+ */
+@property (readwrite, nonatomic) NSURL * outputURL;
+
+/**
+ * Output format
+ */
+@property (readwrite, nonatomic) BKCRenderFormat format;
+
+/**
+ * Maximum duration; 0 renders until silent
+ */
+@property (readwrite, nonatomic) NSTimeInterval duration;
+
+/**
+ * Rendered interleaved frames if `outputURL` is nil
+ */
+@property (readonly, nonatomic) NSData * data;
+
+/**
+ * Error if job failed
+ */
+@property (readonly, nonatomic) NSError * error;
+
+/**
+ * Time needed to read and compile source
+ */
+@property (readonly, nonatomic) NSTimeInterval compileTime;
+
+/**
+ * Time needed to render
+ */
+@property (readonly, nonatomic) NSTimeInterval renderTime;
+
+/**
+ * Render statistics
+ */
+@property (readonly, nonatomic) BKCRenderStatistics statistics;
+
+/**
+ * Initialize with source string
+ */
+- (instancetype)initWithString:(NSString *)string;
+
+/**
+ * Initialize with source file
+ */
+- (instancetype)initWithContentsOfURL:(NSURL *)url;
+
+@end
+
+/**
+ * Compiles and renders songs in parallel
+ *
+ * Each job gets its own BKCCompiler and BKCContext. Jobs are distributed
+ * dynamically to a fixed number of workers; every worker reuses its render
+ * buffer for all jobs it takes.
+ */
+@interface BKCBatchRenderer : NSObject
+
+/**
+ * Number of channels
+ */
+@property (readwrite, nonatomic) UInt32 numberOfChannels;
+
+/**
+ * Sample rate
+ */
+@property (readwrite, nonatomic) UInt32 sampleRate;
+
+/**
+ * Number of workers
+ *
+ * Default is the number of active processors
+ */
+@property (readwrite, nonatomic) NSUInteger numberOfWorkers;
+
+/**
+ * Maximum number of bytes of frames collected in memory
+ *
+ * Jobs without `outputURL` which would exceed this limit fail.
+ * Default is 256 MB. Set to 0 for no limit.
+ */
+@property (readwrite, nonatomic) NSUInteger memoryLimit;
+
+/**
+ * Time needed for last batch
+ */
+@property (readonly, nonatomic) NSTimeInterval totalTime;
+
+/**
+ * Initialize with number of channels and sample rate
+ */
+- (instancetype)initWithNumberOfChannels:(UInt32)numberOfChannels sampleRate:(UInt32)sampleRate;
+
+/**
+ * Render jobs and wait until all are finished
+ *
+ * Returns NO if any job failed
+ */
+- (BOOL)renderJobs:(NSArray *)jobs;
+
+@end
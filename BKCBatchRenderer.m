@@ -0,0 +1,241 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import <stdatomic.h>
+#import "BKCBatchRenderer.h"
+#import "BKCCompiler.h"
+#import "BKCContext_internal.h"
+
+#define DEFAULT_NUM_CHANNELS 2
+#define DEFAULT_SAMPLE_RATE 44100
+#define DEFAULT_MEMORY_LIMIT (256 * 1024 * 1024)
+
+@interface BKCRenderJob ()
+
+@property (readwrite, nonatomic) NSData * source;
+@property (readwrite, nonatomic) NSURL * sourceURL;
+@property (readwrite, nonatomic) NSData * data;
+@property (readwrite, nonatomic) NSError * error;
+@property (readwrite, nonatomic) NSTimeInterval compileTime;
+@property (readwrite, nonatomic) NSTimeInterval renderTime;
+@property (readwrite, nonatomic) BKCRenderStatistics statistics;
+
+@end
+
+@implementation BKCRenderJob
+
+- (instancetype)initWithString:(NSString *)string
+{
+	if ((self = [super init])) {
+		self.source = [string dataUsingEncoding:NSUTF8StringEncoding];
+	}
+
+	return self;
+}
+
+- (instancetype)initWithContentsOfURL:(NSURL *)url
+{
+	if ((self = [super init])) {
+		self.sourceURL = url;
+	}
+
+	return self;
+}
+
+@end
+
+@interface BKCBatchRenderer ()
+{
+	atomic_ulong usedMemory;
+}
+
+@property (readwrite, nonatomic) NSTimeInterval totalTime;
+
+@end
+
+@implementation BKCBatchRenderer
+
+- (instancetype)init
+{
+	return [self initWithNumberOfChannels:DEFAULT_NUM_CHANNELS sampleRate:DEFAULT_SAMPLE_RATE];
+}
+
+- (instancetype)initWithNumberOfChannels:(UInt32)theNumberOfChannels sampleRate:(UInt32)theSampleRate
+{
+	if ((self = [super init])) {
+		self.numberOfChannels = theNumberOfChannels;
+		self.sampleRate       = theSampleRate;
+		self.numberOfWorkers  = [NSProcessInfo processInfo].activeProcessorCount;
+		self.memoryLimit      = DEFAULT_MEMORY_LIMIT;
+	}
+
+	return self;
+}
+
+- (BOOL)reserveMemory:(NSUInteger)size
+{
+	NSUInteger used = atomic_load (& usedMemory);
+
+	if (self.memoryLimit == 0) {
+		return YES;
+	}
+
+	do {
+		if (used + size > self.memoryLimit) {
+			return NO;
+		}
+	}
+	while (!atomic_compare_exchange_weak (& usedMemory, & used, used + size));
+
+	return YES;
+}
+
+- (void)renderJob:(BKCRenderJob *)job renderBuffer:(NSMutableData *)renderBuffer
+{
+	NSError * error = nil;
+	NSTimeInterval startTime;
+	BKCCompiler * compiler;
+	BKCContext * context;
+	BKCProgram * program;
+	BOOL rendered;
+	__block NSMutableData * data = nil;
+	__block BOOL exceedsLimit = NO;
+
+	job.data  = nil;
+	job.error = nil;
+	startTime = [NSProcessInfo processInfo].systemUptime;
+
+	if (job.source == nil && job.sourceURL) {
+		job.source = [NSData dataWithContentsOfURL:job.sourceURL options:0 error:& error];
+
+		if (job.source == nil) {
+			job.error = error;
+			return;
+		}
+	}
+
+	compiler = [[BKCCompiler alloc] init];
+
+	if ([compiler compileData:job.source error:& error] == NO) {
+		job.error = error;
+		return;
+	}
+
+	program = [compiler program];
+
+	job.compileTime = [NSProcessInfo processInfo].systemUptime - startTime;
+
+	context = [[BKCContext alloc] initWithNumberOfChannels:self.numberOfChannels sampleRate:self.sampleRate];
+	context.renderBuffer = renderBuffer;
+
+	if (program == nil || [context addTracksFromProgram:program] == NO) {
+		job.error = [NSError errorWithDomain:NSPOSIXErrorDomain code:-1 userInfo:@{
+			NSLocalizedDescriptionKey: @"Failed to add tracks"
+		}];
+		return;
+	}
+
+	startTime = [NSProcessInfo processInfo].systemUptime;
+
+	if (job.outputURL) {
+		if ([context renderToURL:job.outputURL duration:job.duration format:job.format error:& error] == NO) {
+			job.error = error;
+		}
+	}
+	else {
+		data = [[NSMutableData alloc] init];
+
+		rendered = [context renderWithChunkHandler:^BOOL (SInt16 const * frames, UInt32 numberFrames) {
+			NSUInteger size = numberFrames * self.numberOfChannels * sizeof (SInt16);
+
+			if ([self reserveMemory:size] == NO) {
+				exceedsLimit = YES;
+				return NO;
+			}
+
+			[data appendBytes:frames length:size];
+
+			return YES;
+		} duration:job.duration];
+
+		if (exceedsLimit || rendered == NO) {
+			atomic_fetch_sub (& usedMemory, data.length);
+			data = nil;
+		}
+
+		if (exceedsLimit) {
+			job.error = [NSError errorWithDomain:NSPOSIXErrorDomain code:ENOMEM userInfo:@{
+				NSLocalizedDescriptionKey: @"Rendered frames exceed memory limit"
+			}];
+		}
+		else if (rendered == NO) {
+			job.error = [NSError errorWithDomain:NSPOSIXErrorDomain code:-1 userInfo:@{
+				NSLocalizedDescriptionKey: @"Failed to render frames"
+			}];
+		}
+
+		job.data = data;
+	}
+
+	job.renderTime = [NSProcessInfo processInfo].systemUptime - startTime;
+	job.statistics = context.lastRenderStatistics;
+}
+
+- (BOOL)renderJobs:(NSArray *)jobs
+{
+	NSUInteger numWorkers;
+	atomic_ulong nextJob;
+	atomic_ulong * jobCursor = & nextJob;
+	NSTimeInterval startTime;
+	BOOL success = YES;
+
+	atomic_init (& nextJob, 0);
+	atomic_init (& usedMemory, 0);
+
+	numWorkers = MAX (1, MIN (self.numberOfWorkers, jobs.count));
+	startTime  = [NSProcessInfo processInfo].systemUptime;
+
+	// workers take the next unprocessed job until none is left
+	dispatch_apply (numWorkers, dispatch_get_global_queue (DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t worker) {
+		NSMutableData * renderBuffer = [[NSMutableData alloc] init];
+		NSUInteger index;
+
+		while ((index = atomic_fetch_add (jobCursor, 1)) < jobs.count) {
+			@autoreleasepool {
+				[self renderJob:jobs [index] renderBuffer:renderBuffer];
+			}
+		}
+	});
+
+	self.totalTime = [NSProcessInfo processInfo].systemUptime - startTime;
+
+	for (BKCRenderJob * job in jobs) {
+		if (job.error) {
+			success = NO;
+		}
+	}
+
+	return success;
+}
+
+@end
@@ -0,0 +1,84 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+#import "BKCContext.h"
+
+@interface BKCContext (BKCCheckpoints)
+
+/**
+ * Number of captured checkpoints
+ */
+@property (readonly, nonatomic) NSUInteger numberOfCheckpoints;
+
+/**
+ * Capture the state of the program periodically
+ *
+ * A checkpoint contains the frame time, the cursors of the parser tracks
+ * and the attributes and effects of their BlipKit tracks. It is captured
+ * on the render thread at the first beat tick `interval` seconds after the
+ * previous one into one of `capacity` preallocated slots. If all slots are
+ * used, every second checkpoint is dropped and the interval is doubled.
+ *
+ * Checkpoints refer to the tracks of the program; they are removed when the
+ * program is replaced or its tracks are updated and have to be enabled
+ * again. Returns NO if no program is attached. The audio unit should not be
+ * running.
+ */
+- (BOOL)enableCheckpointsWithInterval:(NSTimeInterval)interval capacity:(NSUInteger)capacity;
+
+/**
+ * Remove all checkpoints and stop capturing
+ *
+ * While rendering with a command queue, the render thread stops capturing
+ * with the next buffer.
+ */
+- (void)disableCheckpoints;
+
+/**
+ * Advance the sequencer without synthesizing audio
+ *
+ * Tracks are detached while the clock, dividers and scheduled events run,
+ * so tracks only receive the changes made by the program. Checkpoints are
+ * captured as usual. The audio unit should not be running.
+ */
+- (BOOL)advanceWithoutSynthesis:(UInt64)numberFrames;
+
+/**
+ * Capture checkpoints ahead up to frame `time` without synthesizing audio
+ * and return to the current frame time
+ */
+- (BOOL)scanCheckpointsUntilTime:(UInt64)time;
+
+/**
+ * Restore the nearest checkpoint before frame `time` and advance the
+ * remainder without synthesis
+ *
+ * Assumes the program is deterministic. Scheduled events are discarded and
+ * dividers which are not part of the program restart their counters. The
+ * current notes are triggered again, so envelopes restart. Fails while the
+ * audio unit or render pipeline renders with a command queue.
+ */
+- (BOOL)seekToTime:(UInt64)time;
+
+@end
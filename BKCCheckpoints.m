@@ -0,0 +1,475 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import <unistd.h>
+#import "BKCCheckpoints.h"
+#import "BKCContext_internal.h"
+#import "BKCTrack.h"
+#import "BKCTrack_internal.h"
+
+#define ADVANCE_CHUNK_SIZE 512
+#define NUM_CHECKPOINT_EFFECTS 5
+#define QUEUE_RETRY_INTERVAL 1000
+
+/**
+ * Attributes of a track which are restored
+ *
+ * BK_NOTE is restored separately after all others
+ */
+static BKEnum const checkpointAttributes [] = {
+	BK_MASTER_VOLUME,
+	BK_VOLUME,
+	BK_PANNING,
+	BK_PITCH,
+	BK_DUTY_CYCLE,
+	BK_PHASE_WRAP,
+	BK_MUTE,
+	BK_ARPEGGIO_DIVIDER,
+	BK_EFFECT_DIVIDER,
+	BK_INSTRUMENT_DIVIDER,
+};
+
+static BKEnum const checkpointEffects [NUM_CHECKPOINT_EFFECTS] = {
+	BK_EFFECT_VOLUME_SLIDE,
+	BK_EFFECT_PANNING_SLIDE,
+	BK_EFFECT_PORTAMENTO,
+	BK_EFFECT_TREMOLO,
+	BK_EFFECT_VIBRATO,
+};
+
+#define NUM_CHECKPOINT_ATTRIBUTES (sizeof (checkpointAttributes) / sizeof (BKEnum))
+
+/**
+ * State of a parser track
+ *
+ * The interpreter is restored into the same track, so pointers into its
+ * own stack stay valid.
+ */
+typedef struct
+{
+	__typeof__ (((BKTKTrack *) 0) -> interpreter) interpreter;
+	BKInt  attributes [NUM_CHECKPOINT_ATTRIBUTES];
+	BKInt  effects [NUM_CHECKPOINT_EFFECTS][3];
+	BKInt  arpeggio [BK_MAX_ARPEGGIO + 1];
+	BKInt  waveform;
+	BKInt  note;
+	void * waveformData;
+	void * instrument;
+	void * sample;
+} BKCTrackState;
+
+typedef struct
+{
+	UInt64        frameTime;
+	BKCTrackState tracks [];
+} BKCCheckpoint;
+
+/**
+ * Preallocated checkpoints and the divider which captures them
+ */
+@interface BKCCheckpointStore : NSObject
+{
+@public
+	BKContext       * renderContext;
+	UInt64 const    * frameTimeOffset;
+	BKDivider         divider;
+	BKTKTrack      ** parserTracks;
+	NSUInteger        numTracks;
+	char            * slots;
+	NSUInteger        slotSize;
+	NSUInteger        capacity;
+	atomic_ulong      count;
+	UInt64            intervalFrames;
+}
+
+@end
+
+@implementation BKCCheckpointStore
+
+- (void)dealloc
+{
+	BKDividerDetach (& divider);
+
+	if (parserTracks) {
+		free (parserTracks);
+	}
+
+	if (slots) {
+		free (slots);
+	}
+}
+
+static BKCCheckpoint * checkpointAtIndex (BKCCheckpointStore * store, NSUInteger index)
+{
+	return (BKCCheckpoint *) & store -> slots [index * store -> slotSize];
+}
+
+static void captureTrack (BKTKTrack * parserTrack, BKCTrackState * state)
+{
+	BKTrack * track = & parserTrack -> renderTrack;
+
+	memcpy (& state -> interpreter, & parserTrack -> interpreter, sizeof (state -> interpreter));
+
+	for (NSUInteger i = 0; i < NUM_CHECKPOINT_ATTRIBUTES; i ++) {
+		BKGetAttr (track, checkpointAttributes [i], & state -> attributes [i]);
+	}
+
+	for (NSUInteger i = 0; i < NUM_CHECKPOINT_EFFECTS; i ++) {
+		BKTrackGetEffect (track, checkpointEffects [i], state -> effects [i], sizeof (BKInt [3]));
+	}
+
+	BKGetPtr (track, BK_ARPEGGIO, state -> arpeggio, sizeof (state -> arpeggio));
+	BKGetAttr (track, BK_WAVEFORM, & state -> waveform);
+	BKGetAttr (track, BK_NOTE, & state -> note);
+
+	state -> waveformData = NULL;
+	state -> instrument   = NULL;
+	state -> sample       = NULL;
+
+	if (state -> waveform == BK_CUSTOM) {
+		BKGetPtr (track, BK_WAVEFORM, & state -> waveformData, sizeof (void *));
+	}
+
+	BKGetPtr (track, BK_INSTRUMENT, & state -> instrument, sizeof (void *));
+	BKGetPtr (track, BK_SAMPLE, & state -> sample, sizeof (void *));
+}
+
+static void restoreTrack (BKTKTrack * parserTrack, BKCTrackState const * state)
+{
+	BKTrack * track = & parserTrack -> renderTrack;
+
+	memcpy (& parserTrack -> interpreter, & state -> interpreter, sizeof (state -> interpreter));
+
+	if (state -> waveform == BK_CUSTOM) {
+		BKSetPtr (track, BK_WAVEFORM, state -> waveformData, 0);
+	}
+	else {
+		BKSetAttr (track, BK_WAVEFORM, state -> waveform);
+	}
+
+	BKSetPtr (track, BK_INSTRUMENT, state -> instrument, 0);
+	// clears a sample set after the checkpoint
+	BKSetPtr (track, BK_SAMPLE, state -> sample, 0);
+
+	for (NSUInteger i = 0; i < NUM_CHECKPOINT_ATTRIBUTES; i ++) {
+		BKSetAttr (track, checkpointAttributes [i], state -> attributes [i]);
+	}
+
+	for (NSUInteger i = 0; i < NUM_CHECKPOINT_EFFECTS; i ++) {
+		BKTrackSetEffect (track, checkpointEffects [i], state -> effects [i], sizeof (BKInt [3]));
+	}
+
+	BKSetPtr (track, BK_ARPEGGIO, (void *) state -> arpeggio, sizeof (state -> arpeggio));
+	BKSetAttr (track, BK_NOTE, state -> note >= 0 ? state -> note : BK_NOTE_MUTE);
+}
+
+/**
+ * Frame time of the context; is called on the render thread
+ */
+static UInt64 checkpointFrameTime (BKCCheckpointStore * store)
+{
+	BKTime time;
+
+	BKGetPtr (store -> renderContext, BK_TIME, & time, sizeof (time));
+
+	return BKTimeGetTime (time) + *store -> frameTimeOffset;
+}
+
+/**
+ * Drop every second checkpoint and double the interval
+ */
+static void thinCheckpoints (BKCCheckpointStore * store)
+{
+	NSUInteger count = atomic_load_explicit (& store -> count, memory_order_relaxed);
+
+	for (NSUInteger i = 1; i * 2 < count; i ++) {
+		memcpy (checkpointAtIndex (store, i), checkpointAtIndex (store, i * 2), store -> slotSize);
+	}
+
+	atomic_store_explicit (& store -> count, (count + 1) / 2, memory_order_release);
+	store -> intervalFrames *= 2;
+}
+
+/**
+ * Capture checkpoint on beat tick
+ *
+ * Is attached before the dividers of the program, so the state is that
+ * before the tick is processed.
+ */
+static BKEnum checkpointFunc (BKCallbackInfo * info, void * userInfo)
+{
+	BKCCheckpoint * checkpoint;
+	BKCCheckpointStore * store = (__bridge BKCCheckpointStore *) userInfo;
+	NSUInteger count = atomic_load_explicit (& store -> count, memory_order_relaxed);
+	UInt64 frameTime = checkpointFrameTime (store);
+
+	if (count && frameTime < checkpointAtIndex (store, count - 1) -> frameTime + store -> intervalFrames) {
+		return 0;
+	}
+
+	if (count == store -> capacity) {
+		thinCheckpoints (store);
+		count = atomic_load_explicit (& store -> count, memory_order_relaxed);
+
+		if (frameTime < checkpointAtIndex (store, count - 1) -> frameTime + store -> intervalFrames) {
+			return 0;
+		}
+	}
+
+	checkpoint = checkpointAtIndex (store, count);
+	checkpoint -> frameTime = frameTime;
+
+	for (NSUInteger i = 0; i < store -> numTracks; i ++) {
+		captureTrack (store -> parserTracks [i], & checkpoint -> tracks [i]);
+	}
+
+	atomic_store_explicit (& store -> count, count + 1, memory_order_release);
+
+	return 0;
+}
+
+@end
+
+@implementation BKCContext (BKCCheckpoints)
+
+- (NSUInteger)numberOfCheckpoints
+{
+	BKCCheckpointStore * store = checkpointStore;
+
+	return store ? atomic_load_explicit (& store -> count, memory_order_acquire) : 0;
+}
+
+- (BOOL)enableCheckpointsWithInterval:(NSTimeInterval)interval capacity:(NSUInteger)capacity
+{
+	BKInt res;
+	BKCallback callback;
+	BKCCheckpointStore * store;
+	NSUInteger index = 0;
+
+	if (programTracks.count == 0) {
+		NSLog (@"*** Checkpoints need a program");
+		return NO;
+	}
+
+	store = [[BKCCheckpointStore alloc] init];
+	store -> renderContext   = & renderCtx;
+	store -> frameTimeOffset = & frameTimeOffset;
+	store -> numTracks       = programTracks.count;
+	store -> capacity        = MAX (capacity, 2);
+	store -> slotSize        = sizeof (BKCCheckpoint) + store -> numTracks * sizeof (BKCTrackState);
+	store -> intervalFrames  = (UInt64) (MAX (interval, 0.0) * renderCtx.sampleRate);
+	store -> parserTracks    = malloc (store -> numTracks * sizeof (BKTKTrack *));
+	store -> slots           = malloc (store -> capacity * store -> slotSize);
+	atomic_init (& store -> count, 0);
+
+	if (store -> parserTracks == NULL || store -> slots == NULL) {
+		NSLog (@"*** Couldn't allocate checkpoints");
+		return NO;
+	}
+
+	for (BKCTrack * track in programTracks) {
+		store -> parserTracks [index ++] = (BKTKTrack *) ((char *) track.track - offsetof (BKTKTrack, renderTrack));
+	}
+
+	callback.func     = checkpointFunc;
+	callback.userInfo = (__bridge void *) store;
+
+	BKDividerInit (& store -> divider, 1, & callback);
+
+	[self lock];
+
+	[self disableCheckpoints];
+	[self endSynthesisSession];
+
+	if ((res = BKContextAttachDivider (& renderCtx, & store -> divider, BK_CLOCK_TYPE_BEAT)) < 0) {
+		NSLog (@"*** Couldn't attach checkpoint divider: %d", res);
+		[self unlock];
+		return NO;
+	}
+
+	// capture before dividers of program are called
+	for (BKCTrack * track in programTracks) {
+		BKDivider * divider = [self parserDividerOfTrack:track];
+
+		BKDividerDetach (divider);
+		BKContextAttachDivider (& renderCtx, divider, BK_CLOCK_TYPE_BEAT);
+	}
+
+	checkpointStore = store;
+
+	[self unlock];
+
+	return YES;
+}
+
+- (void)disableCheckpoints
+{
+	BKCCommand command;
+	BKCCheckpointStore * store;
+
+	[self lock];
+
+	store = checkpointStore;
+	checkpointStore = nil;
+
+	if (store == nil) {
+		[self unlock];
+		return;
+	}
+
+	BKCCommandInit (& command, BKCCommandTypeDetachDivider, & store -> divider, 0);
+
+	// store is used by the render thread until its divider is detached
+	while ([self rendersWithoutLock]) {
+		if ([commandQueue pushCommand:& command completion:^{
+			(void) store;
+		}]) {
+			[self unlock];
+			return;
+		}
+
+		// render thread frees space with the next buffer
+		usleep (QUEUE_RETRY_INTERVAL);
+	}
+
+	BKDividerDetach (& store -> divider);
+
+	[self unlock];
+}
+
+- (BOOL)advanceWithoutSynthesis:(UInt64)numberFrames
+{
+	BKInt res = 0;
+	UInt64 startTime, endTime;
+	SInt16 frames [ADVANCE_CHUNK_SIZE * renderCtx.numChannels];
+
+	[self lock];
+
+	for (BKCTrack * track in tracks) {
+		BKTrackDetach (track.track);
+	}
+
+	while (numberFrames > 0) {
+		startTime = [self renderFrameTime];
+		res = [self generateFrames:frames numberFrames:(UInt32) MIN (numberFrames, ADVANCE_CHUNK_SIZE)];
+		endTime = [self renderFrameTime];
+
+		if (res < 0) {
+			break;
+		}
+
+		// time doesn't advance
+		if (endTime == startTime) {
+			res = -1;
+			break;
+		}
+
+		numberFrames -= MIN (numberFrames, endTime - startTime);
+	}
+
+	// suspended tracks are reattached when they are changed
+	for (BKCTrack * track in tracks) {
+		if (!track.idle) {
+			BKTrackAttach (track.track, [self synthesisContextOfTrack:track]);
+		}
+	}
+
+	atomic_store_explicit (& silentFrames, 0, memory_order_relaxed);
+
+	[self unlock];
+
+	return res >= 0;
+}
+
+- (BOOL)scanCheckpointsUntilTime:(UInt64)time
+{
+	UInt64 frameTime = [self renderFrameTime];
+
+	if (checkpointStore == nil) {
+		NSLog (@"*** Checkpoints are not enabled");
+		return NO;
+	}
+
+	if (time > frameTime && ![self advanceWithoutSynthesis:time - frameTime]) {
+		return NO;
+	}
+
+	return [self seekToTime:frameTime];
+}
+
+- (BOOL)seekToTime:(UInt64)time
+{
+	BKTime bkTime;
+	UInt64 checkpointTime;
+	BKCCheckpoint * checkpoint = NULL;
+	BKCCheckpointStore * store = checkpointStore;
+	NSUInteger count = self.numberOfCheckpoints;
+
+	if (store == nil) {
+		NSLog (@"*** Checkpoints are not enabled");
+		return NO;
+	}
+
+	if ([self rendersWithoutLock]) {
+		NSLog (@"*** Can't seek while rendering with a command queue or render pipeline");
+		return NO;
+	}
+
+	// checkpoints are sorted by time
+	for (NSUInteger i = count; i > 0; i --) {
+		if (checkpointAtIndex (store, i - 1) -> frameTime <= time) {
+			checkpoint = checkpointAtIndex (store, i - 1);
+			break;
+		}
+	}
+
+	if (checkpoint == NULL) {
+		NSLog (@"*** No checkpoint before frame %llu", (unsigned long long) time);
+		return NO;
+	}
+
+	[self lock];
+
+	BKContextReset (& renderCtx);
+	[self resetSynthesisContexts];
+
+	for (NSUInteger i = 0; i < store -> numTracks; i ++) {
+		restoreTrack (store -> parserTracks [i], & checkpoint -> tracks [i]);
+	}
+
+	checkpointTime = checkpoint -> frameTime;
+
+	BKGetPtr (& renderCtx, BK_TIME, & bkTime, sizeof (bkTime));
+	frameTimeOffset = checkpointTime - BKTimeGetTime (bkTime);
+
+	[eventScheduler reset];
+	[eventScheduler publishFrameTime:[self renderFrameTime]];
+	[resampler reset];
+	[renderPipeline flush];
+
+	[self unlock];
+
+	return [self advanceWithoutSynthesis:time - checkpointTime];
+}
+
+@end
@@ -0,0 +1,198 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+#import <stdatomic.h>
+#import "BKCBase.h"
+
+/**
+ * Maximum number of bytes a command can copy from a pointer value
+ *
+ * Larger values can't be queued and have to be set with the lock held
+ */
+#define BKC_COMMAND_MAX_VALUE_SIZE (sizeof (BKInt) * 16)
+
+typedef NS_ENUM(NSInteger, BKCCommandType)
+{
+	BKCCommandTypeSetAttribute,
+	BKCCommandTypeSetPointer,
+	BKCCommandTypeSetEffect,
+	BKCCommandTypeAttachTrack,
+	BKCCommandTypeDetachTrack,
+	BKCCommandTypeResetTrack,
+	BKCCommandTypeAttachDivider,
+	BKCCommandTypeDetachDivider,
+	BKCCommandTypeReleaseNote,  // Released only if the `atomic_int` at `pointer` is equal to `value`
+	BKCCommandTypeSuspendTrack, // Detached only if the `atomic_int` at `pointer` is equal to `value`
+};
+
+/**
+ * A change which is applied on the render thread
+ */
+typedef struct
+{
+	BKCCommandType type;
+	void         * object;    // The BlipKit object to change (BKContext, BKTrack or BKDivider)
+	BKEnum         attribute;
+	BKInt          value;
+	void         * pointer;   // Passed as is if `size` is 0, otherwise the copied values are passed
+	NSUInteger     size;
+	UInt64         time;      // Frame time at which a scheduled command is executed
+	union {
+		BKInt ints [BKC_COMMAND_MAX_VALUE_SIZE / sizeof (BKInt)];
+		char  bytes [BKC_COMMAND_MAX_VALUE_SIZE];
+	} values;
+} BKCCommand;
+
+/**
+ * Initialize command with type, object and attribute
+ */
+extern void BKCCommandInit (BKCCommand * command, BKCCommandType type, void * object, BKEnum attribute);
+
+/**
+ * Copy pointer values into command
+ *
+ * Returns NO if `size` exceeds BKC_COMMAND_MAX_VALUE_SIZE
+ */
+extern BOOL BKCCommandSetValues (BKCCommand * command, void const * values, NSUInteger size);
+
+/**
+ * Apply command to its object
+ *
+ * Must only be called from the render thread or with the render lock held
+ */
+extern BKInt BKCCommandExecute (BKCCommand const * command);
+
+/**
+ * Bounded single-producer/single-consumer queue of commands
+ *
+ * Commands are pushed by other threads and executed by the render thread
+ * when it calls `drain`. The render thread never waits on a lock; pushing
+ * threads are serialized with a separate lock which is never taken by the
+ * render thread.
+ */
+@interface BKCCommandQueue : NSObject
+{
+	BKCCommand        * commands;
+	NSUInteger          capacity;
+	atomic_ulong        writeIndex;
+	atomic_ulong        readIndex;
+	atomic_ulong        overflowCount;
+	NSUInteger          maxDepth;
+	NSLock            * producerLock;
+	NSMutableArray    * completions;
+	dispatch_source_t   collectTimer;
+	BOOL                collectTimerRunning;
+	void             (^ pushHandler) (void);
+}
+
+/**
+ * Maximum number of pending commands
+ */
+@property (readonly, nonatomic) NSUInteger capacity;
+
+/**
+ * Number of pending commands
+ */
+@property (readonly, nonatomic) NSUInteger depth;
+
+/**
+ * Highest number of pending commands so far
+ */
+@property (readonly, nonatomic) NSUInteger maxDepth;
+
+/**
+ * Number of commands which were rejected because the queue was full
+ */
+@property (readonly, nonatomic) NSUInteger overflowCount;
+
+/**
+ * Number of commands executed by the render thread
+ */
+@property (readonly, nonatomic) NSUInteger numberOfExecutedCommands;
+
+/**
+ * Called on the pushing thread after commands were pushed
+ */
+@property (readwrite, copy) void (^ pushHandler) (void);
+
+/**
+ * Initialize with capacity
+ *
+ * Capacity is rounded up to the next power of 2
+ */
+- (instancetype)initWithCapacity:(NSUInteger)capacity;
+
+/**
+ * Push command
+ *
+ * Returns NO if the queue is full
+ */
+- (BOOL)pushCommand:(BKCCommand const *)command;
+
+/**
+ * Push command and call `completion` after it was executed
+ *
+ * The completion block is called on a pushing thread or on a background
+ * queue after the render thread has executed the command. It is used to
+ * keep objects alive which may still be used by the render thread until then.
+ * Pending completions are collected periodically also if no more commands
+ * are pushed.
+ */
+- (BOOL)pushCommand:(BKCCommand const *)command completion:(void (^)(void))completion;
+
+/**
+ * Push multiple commands which are executed in the same drain
+ *
+ * `completion` is called after the last command was executed. Returns NO
+ * and pushes none of the commands if not all of them fit.
+ */
+- (BOOL)pushCommands:(BKCCommand const *)commands count:(NSUInteger)count completion:(void (^)(void))completion;
+
+/**
+ * Execute all pending commands
+ *
+ * Must only be called from the render thread or with the render lock held.
+ * Returns the number of executed commands.
+ */
+- (NSUInteger)drain;
+
+/**
+ * Remove the next pending command without executing it
+ *
+ * Must only be called from the render thread or with the render lock held.
+ * Returns NO if no command is pending.
+ */
+- (BOOL)popCommand:(BKCCommand *)command;
+
+/**
+ * Call completion blocks of executed commands
+ */
+- (void)collect;
+
+/**
+ * Reset counters
+ */
+- (void)resetStatistics;
+
+@end
@@ -0,0 +1,325 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import "BKCCommandQueue.h"
+
+#define DEFAULT_CAPACITY 256
+#define COLLECT_INTERVAL (50 * NSEC_PER_MSEC)
+
+void BKCCommandInit (BKCCommand * command, BKCCommandType type, void * object, BKEnum attribute)
+{
+	memset (command, 0, sizeof (* command));
+
+	command -> type      = type;
+	command -> object    = object;
+	command -> attribute = attribute;
+}
+
+BOOL BKCCommandSetValues (BKCCommand * command, void const * values, NSUInteger size)
+{
+	if (size > BKC_COMMAND_MAX_VALUE_SIZE) {
+		return NO;
+	}
+
+	if (size) {
+		memcpy (command -> values.bytes, values, size);
+	}
+	else {
+		command -> pointer = (void *) values;
+	}
+
+	command -> size = size;
+
+	return YES;
+}
+
+BKInt BKCCommandExecute (BKCCommand const * command)
+{
+	void * pointer = command -> size ? (void *) command -> values.bytes : command -> pointer;
+
+	switch (command -> type) {
+		case BKCCommandTypeSetAttribute: {
+			return BKSetAttr (command -> object, command -> attribute, command -> value);
+		}
+		case BKCCommandTypeSetPointer: {
+			return BKSetPtr (command -> object, command -> attribute, pointer, command -> size);
+		}
+		case BKCCommandTypeSetEffect: {
+			return BKTrackSetEffect (command -> object, command -> attribute, pointer, (BKInt) command -> size);
+		}
+		case BKCCommandTypeAttachTrack: {
+			return BKTrackAttach (command -> object, command -> pointer);
+		}
+		case BKCCommandTypeDetachTrack: {
+			BKTrackDetach (command -> object);
+			break;
+		}
+		case BKCCommandTypeResetTrack: {
+			BKTrackReset (command -> object);
+			break;
+		}
+		case BKCCommandTypeAttachDivider: {
+			return BKContextAttachDivider (command -> pointer, command -> object, command -> value);
+		}
+		case BKCCommandTypeDetachDivider: {
+			BKDividerDetach (command -> object);
+			break;
+		}
+		case BKCCommandTypeReleaseNote: {
+			// note was replaced in the meantime
+			if (atomic_load_explicit ((atomic_int *) command -> pointer, memory_order_relaxed) != command -> value) {
+				break;
+			}
+
+			return BKSetAttr (command -> object, BK_NOTE, BK_NOTE_RELEASE);
+		}
+		case BKCCommandTypeSuspendTrack: {
+			// track was changed in the meantime
+			if (atomic_load_explicit ((atomic_int *) command -> pointer, memory_order_relaxed) != command -> value) {
+				break;
+			}
+
+			BKTrackDetach (command -> object);
+			break;
+		}
+	}
+
+	return 0;
+}
+
+@implementation BKCCommandQueue
+
+@synthesize capacity;
+@synthesize maxDepth;
+@synthesize pushHandler;
+
+- (instancetype)init
+{
+	return [self initWithCapacity:DEFAULT_CAPACITY];
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)theCapacity
+{
+	if ((self = [super init])) {
+		capacity = 1;
+
+		while (capacity < theCapacity) {
+			capacity <<= 1;
+		}
+
+		commands = malloc (capacity * sizeof (BKCCommand));
+
+		if (commands == NULL) {
+			NSLog (@"*** Couldn't allocate command queue");
+			return nil;
+		}
+
+		atomic_init (& writeIndex, 0);
+		atomic_init (& readIndex, 0);
+		atomic_init (& overflowCount, 0);
+
+		producerLock = [[NSLock alloc] init];
+		completions  = [[NSMutableArray alloc] init];
+
+		__weak BKCCommandQueue * weakSelf = self;
+
+		// collects completions if no more commands are pushed; resumed while completions are pending
+		collectTimer = dispatch_source_create (DISPATCH_SOURCE_TYPE_TIMER, 0, 0, dispatch_get_global_queue (QOS_CLASS_UTILITY, 0));
+		dispatch_source_set_timer (collectTimer, dispatch_time (DISPATCH_TIME_NOW, COLLECT_INTERVAL), COLLECT_INTERVAL, COLLECT_INTERVAL / 4);
+		dispatch_source_set_event_handler (collectTimer, ^{
+			[weakSelf collect];
+		});
+	}
+
+	return self;
+}
+
+- (void)dealloc
+{
+	if (collectTimer) {
+		// suspended sources must not be released
+		if (collectTimerRunning == NO) {
+			dispatch_resume (collectTimer);
+		}
+
+		dispatch_source_cancel (collectTimer);
+	}
+
+	if (commands) {
+		free (commands);
+	}
+}
+
+- (NSUInteger)depth
+{
+	return atomic_load (& writeIndex) - atomic_load (& readIndex);
+}
+
+- (NSUInteger)overflowCount
+{
+	return atomic_load (& overflowCount);
+}
+
+- (NSUInteger)numberOfExecutedCommands
+{
+	return atomic_load (& readIndex);
+}
+
+- (BOOL)pushCommand:(BKCCommand const *)command
+{
+	return [self pushCommand:command completion:nil];
+}
+
+- (BOOL)pushCommand:(BKCCommand const *)command completion:(void (^)(void))completion
+{
+	return [self pushCommands:command count:1 completion:completion];
+}
+
+- (BOOL)pushCommands:(BKCCommand const *)newCommands count:(NSUInteger)count completion:(void (^)(void))completion
+{
+	NSUInteger writeIdx, depth;
+	void (^ handler) (void) = self.pushHandler;
+
+	[producerLock lock];
+
+	writeIdx = atomic_load_explicit (& writeIndex, memory_order_relaxed);
+	depth    = writeIdx - atomic_load_explicit (& readIndex, memory_order_acquire);
+
+	if (depth + count > capacity) {
+		atomic_fetch_add_explicit (& overflowCount, 1, memory_order_relaxed);
+		[producerLock unlock];
+		[self collect];
+		return NO;
+	}
+
+	for (NSUInteger i = 0; i < count; i ++) {
+		commands [(writeIdx + i) & (capacity - 1)] = newCommands [i];
+	}
+
+	// all commands become visible at once
+	atomic_store_explicit (& writeIndex, writeIdx + count, memory_order_release);
+
+	if (depth + count > maxDepth) {
+		maxDepth = depth + count;
+	}
+
+	if (completion) {
+		// called when the read index has passed the last command
+		[completions addObject:@[@(writeIdx + count), [completion copy]]];
+
+		if (collectTimerRunning == NO) {
+			collectTimerRunning = YES;
+			dispatch_resume (collectTimer);
+		}
+	}
+
+	[producerLock unlock];
+	[self collect];
+
+	if (handler) {
+		handler ();
+	}
+
+	return YES;
+}
+
+- (NSUInteger)drain
+{
+	NSUInteger readIdx, writeIdx;
+
+	readIdx  = atomic_load_explicit (& readIndex, memory_order_relaxed);
+	writeIdx = atomic_load_explicit (& writeIndex, memory_order_acquire);
+
+	for (NSUInteger i = readIdx; i < writeIdx; i ++) {
+		BKCCommandExecute (& commands [i & (capacity - 1)]);
+	}
+
+	atomic_store_explicit (& readIndex, writeIdx, memory_order_release);
+
+	return writeIdx - readIdx;
+}
+
+- (BOOL)popCommand:(BKCCommand *)command
+{
+	NSUInteger readIdx, writeIdx;
+
+	readIdx  = atomic_load_explicit (& readIndex, memory_order_relaxed);
+	writeIdx = atomic_load_explicit (& writeIndex, memory_order_acquire);
+
+	if (readIdx == writeIdx) {
+		return NO;
+	}
+
+	*command = commands [readIdx & (capacity - 1)];
+	atomic_store_explicit (& readIndex, readIdx + 1, memory_order_release);
+
+	return YES;
+}
+
+- (void)collect
+{
+	NSUInteger readIdx;
+	NSMutableArray * executed = nil;
+
+	[producerLock lock];
+
+	readIdx = atomic_load_explicit (& readIndex, memory_order_acquire);
+
+	while (completions.count) {
+		NSArray * item = completions.firstObject;
+
+		if ([item [0] unsignedIntegerValue] > readIdx) {
+			break;
+		}
+
+		if (executed == nil) {
+			executed = [[NSMutableArray alloc] init];
+		}
+
+		[executed addObject:item [1]];
+		[completions removeObjectAtIndex:0];
+	}
+
+	// nothing left to collect
+	if (completions.count == 0 && collectTimerRunning) {
+		collectTimerRunning = NO;
+		dispatch_suspend (collectTimer);
+	}
+
+	[producerLock unlock];
+
+	// call outside of lock as blocks may push new commands
+	for (void (^ completion) (void) in executed) {
+		completion ();
+	}
+}
+
+- (void)resetStatistics
+{
+	[producerLock lock];
+	maxDepth = self.depth;
+	atomic_store (& overflowCount, 0);
+	[producerLock unlock];
+}
+
+@end
@@ -26,12 +26,25 @@
 #import "BKTKCompiler.h"
 #import "BKTKParser.h"
 #import "BKTKTokenizer.h"
+#import "BKCLoadStatistics.h"
+#import "BKCProgram.h"
+
+struct BKCTokenBatch;
 
 @interface BKCCompiler : NSObject
 {
-	BKTKCompiler  compiler;
-	BKTKTokenizer tokenizer;
-	BKTKParser    parser;
+	BKTKCompiler   * compiler;
+	BKTKTokenizer    tokenizer;
+	BKTKParser       parser;
+	NSMutableArray * blocks;
+	NSIndexSet     * changedTrackIndexes;
+	BOOL             hasCompiledBlocks;
+	BOOL             recordsCommandPointers;
+	NSArray        * commandPointers;
+	struct BKCTokenBatch * tokenBatch;
+	BKCLoadStatistics compileStatistics;
+	UInt64           compileStartTime;
+	NSUInteger       compileStartMemory;
 }
 
 /**
@@ -49,6 +62,24 @@
  */
 @property (readonly) BKTKCompiler * compiler;
 
+/**
+ * Record positions of object addresses in the compiled commands
+ *
+ * Required to archive the program. The positions are found by compiling the
+ * parse tree a second time and comparing both results, which doubles the
+ * compile time; incremental compilations always compile everything. Default
+ * is NO.
+ */
+@property (readwrite, nonatomic) BOOL recordsCommandPointers;
+
+/**
+ * Counts and phase times of the last compilation
+ *
+ * For incremental compilations, only re-parsed blocks are counted as
+ * bytes and tokens.
+ */
+@property (readonly, nonatomic) BKCLoadStatistics lastCompileStatistics;
+
 /**
  * Get named instruments
  */
@@ -69,6 +100,41 @@
  */
 - (BOOL)compileBytes:(void const *)bytes size:(NSUInteger)size error:(NSError **)error;
 
+/**
+ * Indexes of tracks changed by the last incremental compilation
+ *
+ * Is nil if all tracks have to be replaced; this is the case after a full
+ * compilation, or if global commands, groups, instruments, waveforms or
+ * samples have changed, or if tracks were added or removed.
+ */
+@property (readonly, nonatomic) NSIndexSet * changedTrackIndexes;
+
+/**
+ * Compile incrementally after an edit
+ *
+ * `bytes` is the complete new source; `editedRange` is the range in the new
+ * source which replaced the previous characters and `delta` the change in
+ * length, like with NSTextStorage. Only top-level blocks (tracks, groups,
+ * instruments, waveforms, samples) touching the edited range are
+ * re-tokenized and re-parsed; the parse trees of all other blocks are
+ * reused. Only changed instruments, waveforms, samples and tracks are
+ * compiled; other compiled objects are kept. All tracks are compiled again
+ * if a definition has changed, and everything is compiled if global commands
+ * or groups have changed, tracks were added or removed, `program` was
+ * called since the last compilation, or recordsCommandPointers is set. The first call parses all blocks. Use
+ * changedTrackIndexes to replace the changed tracks of a context with
+ * updateTracksFromProgram:changedTrackIndexes:.
+ */
+- (BOOL)compileBytes:(void const *)bytes size:(NSUInteger)size editedRange:(NSRange)editedRange changeInLength:(NSInteger)delta error:(NSError **)error;
+
+/**
+ * Hand over the last compiled result as an immutable program
+ *
+ * The compiler is empty afterwards and can be used to compile the next
+ * source. Returns nil on allocation failure.
+ */
+- (BKCProgram *)program;
+
 /**
  * Get instrument by name
  */
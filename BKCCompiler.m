@@ -24,9 +24,292 @@
 #import "BKCCompiler.h"
 #import "BKTKContext.h"
 #import "BKCInstrument.h"
+#import "BKCProgram_internal.h"
+#import "BKCRenderCounters.h"
+
+#define TOKEN_BATCH_SIZE 64
+#define TOKEN_BATCH_DATA_SIZE 4096
+
+/**
+ * Tokens passed to the parser at once
+ *
+ * Token values point into the tokenizer's buffer which is overwritten by
+ * the next token, so they are copied into `data`
+ */
+typedef struct BKCTokenBatch
+{
+	BKTKParser * parser;
+	NSUInteger   numTokens;
+	NSUInteger   dataSize;
+	NSUInteger   totalTokens;
+	NSUInteger   numBatches;
+	UInt64       parseTime;
+	BKTKToken    tokens [TOKEN_BATCH_SIZE];
+	uint8_t      data [TOKEN_BATCH_DATA_SIZE];
+} BKCTokenBatch;
+
+static BKTKCompiler * newCompiler (void)
+{
+	BKTKCompiler * compiler = malloc (sizeof (*compiler));
+
+	if (compiler == NULL) {
+		return NULL;
+	}
+
+	if (BKTKCompilerInit (compiler) != 0) {
+		free (compiler);
+		return NULL;
+	}
+
+	return compiler;
+}
+
+typedef enum : NSUInteger
+{
+	BKCSourceBlockTypeGlobal = 0,
+	BKCSourceBlockTypeTrack,
+	BKCSourceBlockTypeGroup,
+	BKCSourceBlockTypeInstrument,
+	BKCSourceBlockTypeWaveform,
+	BKCSourceBlockTypeSample,
+} BKCSourceBlockType;
+
+/**
+ * Top-level block of the source with its own parse tree
+ */
+@interface BKCSourceBlock : NSObject
+{
+@public
+	BKCSourceBlockType type;
+	NSString         * name;
+	NSRange            range;
+	NSUInteger         hash;
+	BKTKParser         parser;
+	BOOL               parsed;
+}
+
+@end
+
+@implementation BKCSourceBlock
+
+- (instancetype)init
+{
+	if ((self = [super init])) {
+		if (BKTKParserInit (& parser) != 0) {
+			return nil;
+		}
+	}
+
+	return self;
+}
+
+- (void)dealloc
+{
+	BKDispose (& parser);
+}
+
+@end
+
+static NSUInteger hashBytes (uint8_t const * bytes, NSUInteger size)
+{
+	NSUInteger hash = 2166136261u;
+
+	for (NSUInteger i = 0; i < size; i ++) {
+		hash = (hash ^ bytes [i]) * 16777619u;
+	}
+
+	return hash;
+}
+
+static BOOL commandIs (uint8_t const * name, NSUInteger length, char const * command)
+{
+	return length == strlen (command) && memcmp (name, command, length) == 0;
+}
+
+static BKCSourceBlockType blockTypeOfCommand (uint8_t const * name, NSUInteger length)
+{
+	if (commandIs (name, length, "track")) {
+		return BKCSourceBlockTypeTrack;
+	}
+	else if (commandIs (name, length, "grp")) {
+		return BKCSourceBlockTypeGroup;
+	}
+	else if (commandIs (name, length, "instr")) {
+		return BKCSourceBlockTypeInstrument;
+	}
+	else if (commandIs (name, length, "wave")) {
+		return BKCSourceBlockTypeWaveform;
+	}
+	else if (commandIs (name, length, "samp")) {
+		return BKCSourceBlockTypeSample;
+	}
+
+	return BKCSourceBlockTypeGlobal;
+}
+
+static void addBlock (NSMutableArray * blocks, uint8_t const * bytes, BKCSourceBlockType type, NSString * name, NSUInteger start, NSUInteger end)
+{
+	BKCSourceBlock * block = [[BKCSourceBlock alloc] init];
+
+	block -> type  = type;
+	block -> name  = name;
+	block -> range = NSMakeRange (start, end - start);
+	block -> hash  = hashBytes (& bytes [start], end - start);
+
+	[blocks addObject:block];
+}
+
+/**
+ * Split source into top-level blocks
+ *
+ * Scans commands from `offset` and stops at the first command at or after
+ * `limit` which is not nested in a block. Commands outside of blocks are
+ * grouped into global blocks; whitespace and comments between blocks don't
+ * belong to any block. Returns the offset where scanning stopped.
+ */
+static NSUInteger scanBlocks (uint8_t const * bytes, NSUInteger size, NSUInteger offset, NSUInteger limit, NSMutableArray * blocks)
+{
+	NSUInteger depth = 0;
+	NSUInteger blockStart = 0, globalStart = 0, globalEnd = 0;
+	BOOL hasGlobal = NO;
+	BKCSourceBlockType blockType = BKCSourceBlockTypeGlobal;
+	NSString * blockName = nil;
+
+	while (offset < size) {
+		NSUInteger start, nameEnd, argEnd, end;
+		BKCSourceBlockType type;
+		BOOL quoted = NO;
+
+		// skip separators and comments
+		if (isspace (bytes [offset]) || bytes [offset] == ';') {
+			offset ++;
+			continue;
+		}
+
+		if (bytes [offset] == '%') {
+			while (offset < size && bytes [offset] != '\n') {
+				offset ++;
+			}
+			continue;
+		}
+
+		if (offset >= limit && depth == 0) {
+			break;
+		}
+
+		start = offset;
+
+		while (offset < size) {
+			uint8_t c = bytes [offset];
+
+			if (c == '"') {
+				quoted = !quoted;
+			}
+			else if (!quoted && (c == ';' || c == '\n' || c == '%')) {
+				break;
+			}
+
+			offset ++;
+		}
+
+		end = offset;
+
+		for (nameEnd = start; nameEnd < end && bytes [nameEnd] != ':' && !isspace (bytes [nameEnd]); nameEnd ++);
+
+		type = blockTypeOfCommand (& bytes [start], nameEnd - start);
+
+		if (type != BKCSourceBlockTypeGlobal) {
+			if (depth ++ == 0) {
+				if (hasGlobal) {
+					addBlock (blocks, bytes, BKCSourceBlockTypeGlobal, nil, globalStart, globalEnd);
+					hasGlobal = NO;
+				}
+
+				for (argEnd = nameEnd + 1; argEnd < end && bytes [argEnd] != ':' && !isspace (bytes [argEnd]); argEnd ++);
+
+				blockStart = start;
+				blockType  = type;
+				blockName  = nameEnd < end && bytes [nameEnd] == ':' ? [[NSString alloc] initWithBytes:& bytes [nameEnd + 1] length:argEnd - nameEnd - 1 encoding:NSUTF8StringEncoding] : @"";
+			}
+		}
+		else if (depth > 0) {
+			if (commandIs (& bytes [start], nameEnd - start, "end") && -- depth == 0) {
+				addBlock (blocks, bytes, blockType, blockName, blockStart, end);
+			}
+		}
+		else {
+			if (!hasGlobal) {
+				globalStart = start;
+				hasGlobal = YES;
+			}
+
+			globalEnd = end;
+		}
+	}
+
+	// unterminated block is left to the parser to report
+	if (depth > 0) {
+		addBlock (blocks, bytes, blockType, blockName, blockStart, offset);
+	}
+	else if (hasGlobal) {
+		addBlock (blocks, bytes, BKCSourceBlockTypeGlobal, nil, globalStart, globalEnd);
+	}
+
+	return offset;
+}
+
+static BOOL isGlobalBlock (BKCSourceBlock * block)
+{
+	return block -> type == BKCSourceBlockTypeGlobal || block -> type == BKCSourceBlockTypeGroup;
+}
+
+static BOOL isDefinitionBlock (BKCSourceBlock * block)
+{
+	return block -> type == BKCSourceBlockTypeInstrument || block -> type == BKCSourceBlockTypeWaveform || block -> type == BKCSourceBlockTypeSample;
+}
+
+/**
+ * Remove the object defined by `block` from the compiled data
+ *
+ * Returns the object, which has to be disposed by the caller, or NULL
+ */
+static void * removeDefinition (BKTKCompiler * compiler, BKCSourceBlock * block)
+{
+	BKHashTable * table;
+	void * object = NULL;
+
+	switch (block -> type) {
+		case BKCSourceBlockTypeInstrument: {
+			table = & compiler -> instruments;
+			break;
+		}
+		case BKCSourceBlockTypeWaveform: {
+			table = & compiler -> waveforms;
+			break;
+		}
+		case BKCSourceBlockTypeSample: {
+			table = & compiler -> samples;
+			break;
+		}
+		default: {
+			return NULL;
+		}
+	}
+
+	BKHashTableLookup (table, block -> name.UTF8String, & object);
+
+	if (object) {
+		BKHashTableRemove (table, block -> name.UTF8String);
+	}
+
+	return object;
+}
 
 @implementation BKCCompiler
 
+@synthesize changedTrackIndexes;
+@synthesize recordsCommandPointers;
+
 - (instancetype)init
 {
 	if ((self = [super init])) {
@@ -38,7 +321,11 @@
 			return nil;
 		}
 
-		if (BKTKCompilerInit (& compiler) != 0) {
+		if ((compiler = newCompiler ()) == NULL) {
+			return nil;
+		}
+
+		if ((tokenBatch = malloc (sizeof (*tokenBatch))) == NULL) {
 			return nil;
 		}
 	}
@@ -50,7 +337,15 @@
 {
 	BKDispose (& tokenizer);
 	BKDispose (& parser);
-	BKDispose (& compiler);
+
+	if (tokenBatch) {
+		free (tokenBatch);
+	}
+
+	if (compiler) {
+		BKDispose (compiler);
+		free (compiler);
+	}
 }
 
 - (BKTKTokenizer *)tokenizer
@@ -65,7 +360,7 @@
 
 - (BKTKCompiler *)compiler
 {
-	return & compiler;
+	return compiler;
 }
 
 - (BOOL)compileString:(NSString *)string error:(NSError **)error
@@ -78,41 +373,176 @@
 	return [self compileBytes:data.bytes size:data.length error:error];
 }
 
-static BKInt putToken (BKTKToken const * token, BKCCompiler * self)
+- (BKCLoadStatistics)lastCompileStatistics
+{
+	return compileStatistics;
+}
+
+static BKInt putTokens (BKCTokenBatch * batch, BKTKToken const * tokens, NSUInteger count)
+{
+	BKInt res;
+	UInt64 startTime = BKCRenderClockNow ();
+
+	res = BKTKParserPutTokens (batch -> parser, tokens, count);
+
+	batch -> parseTime += BKCRenderClockNow () - startTime;
+	batch -> numBatches ++;
+
+	return res;
+}
+
+/**
+ * Pass collected tokens to the parser
+ */
+static BKInt flushTokens (BKCTokenBatch * batch)
+{
+	BKInt res = 0;
+
+	if (batch -> numTokens) {
+		res = putTokens (batch, batch -> tokens, batch -> numTokens);
+	}
+
+	batch -> numTokens = 0;
+	batch -> dataSize  = 0;
+
+	return res;
+}
+
+static BKInt putToken (BKTKToken const * token, BKCTokenBatch * batch)
 {
 	BKInt res;
+	BKTKToken * copy;
+	uint8_t * value;
+	NSUInteger size = token -> dataLen + 1;
+
+	batch -> totalTokens ++;
+
+	if (batch -> numTokens == TOKEN_BATCH_SIZE || batch -> dataSize + size > TOKEN_BATCH_DATA_SIZE) {
+		if ((res = flushTokens (batch)) != 0) {
+			return res;
+		}
+	}
 
-	if ((res = BKTKParserPutTokens (& self -> parser, token, 1)) != 0) {
-		return res;
+	// value is larger than the batch buffer
+	if (size > TOKEN_BATCH_DATA_SIZE) {
+		return putTokens (batch, token, 1);
 	}
 
+	value = & batch -> data [batch -> dataSize];
+	memcpy (value, token -> value, token -> dataLen);
+	value [token -> dataLen] = '\0';
+	batch -> dataSize += size;
+
+	copy = & batch -> tokens [batch -> numTokens ++];
+	*copy = *token;
+	copy -> value = value;
+
 	return 0;
 }
 
+/**
+ * Number of nodes in tree
+ */
+static NSUInteger countNodes (BKTKParserNode const * node)
+{
+	NSUInteger count = 0;
+
+	for (; node; node = node -> nextNode) {
+		count += 1 + countNodes (node -> subNode);
+	}
+
+	return count;
+}
+
+/**
+ * Reset statistics at the start of a compilation
+ */
+- (void)beginCompileStatistics
+{
+	memset (& compileStatistics, 0, sizeof (compileStatistics));
+	compileStartTime   = BKCRenderClockNow ();
+	compileStartMemory = BKCLoadMemoryInUse ();
+
+	if (compileStartMemory == NSNotFound) {
+		compileStatistics.memoryGrowth = NSNotFound;
+	}
+}
+
+/**
+ * Record memory growth at a phase boundary
+ */
+- (void)sampleCompileMemory
+{
+	NSUInteger memory = BKCLoadMemoryInUse ();
+
+	if (memory > compileStartMemory) {
+		compileStatistics.memoryGrowth = MAX (compileStatistics.memoryGrowth, memory - compileStartMemory);
+	}
+}
+
+- (void)endCompileStatistics
+{
+	compileStatistics.totalTime = (BKCRenderClockNow () - compileStartTime) * 1e-9;
+	[self sampleCompileMemory];
+}
+
 - (BOOL)compileBytes:(void const *)bytes size:(NSUInteger)size error:(NSError **)error
 {
-	BKInt res = 0;
-	BKTKParserNode * nodeTree;
-	NSMutableString * errorMsg = [[NSMutableString alloc] init];
+	BOOL success;
 
 	[self reset];
 	*error = nil;
 
-	res = BKTKTokenizerPutChars (& tokenizer, bytes, size, (BKTKPutTokenFunc) putToken, (__bridge void *) self);
+	blocks = nil;
+	changedTrackIndexes = nil;
+
+	[self beginCompileStatistics];
+
+	success = [self parseBytes:bytes size:size parser:& parser error:error] && [self compileNodeTree:BKTKParserGetNodeTree (&parser) error:error];
+
+	[self endCompileStatistics];
+
+	return success;
+}
+
+- (BOOL)parseBytes:(void const *)bytes size:(NSUInteger)size parser:(BKTKParser *)aParser error:(NSError **)error
+{
+	BKInt res = 0, flushRes;
+	UInt64 startTime = BKCRenderClockNow ();
+	NSMutableString * errorMsg = [[NSMutableString alloc] init];
+
+	memset (tokenBatch, 0, offsetof (BKCTokenBatch, tokens));
+	tokenBatch -> parser = aParser;
+
+	res = BKTKTokenizerPutChars (& tokenizer, bytes, size, (BKTKPutTokenFunc) putToken, tokenBatch);
 
 	// terminate parser
 	if (res == 0) {
-		res = BKTKTokenizerPutChars (& tokenizer, (void const *) "", 0, (BKTKPutTokenFunc) putToken, (__bridge void *) self);
+		res = BKTKTokenizerPutChars (& tokenizer, (void const *) "", 0, (BKTKPutTokenFunc) putToken, tokenBatch);
 	}
 
-	if (BKTKParserHasError (& parser)) {
-		[errorMsg appendFormat:@"%s\n", parser.buffer];
+	// also tokens before a tokenizer error
+	flushRes = flushTokens (tokenBatch);
+
+	if (res == 0) {
+		res = flushRes;
+	}
+
+	compileStatistics.numberOfBytes        += size;
+	compileStatistics.numberOfTokens       += tokenBatch -> totalTokens;
+	compileStatistics.numberOfTokenBatches += tokenBatch -> numBatches;
+	compileStatistics.parseTime            += tokenBatch -> parseTime * 1e-9;
+	compileStatistics.tokenizeTime         += (BKCRenderClockNow () - startTime - tokenBatch -> parseTime) * 1e-9;
+	[self sampleCompileMemory];
+
+	if (BKTKParserHasError (aParser)) {
+		[errorMsg appendFormat:@"%s\n", aParser -> buffer];
 	}
 	else if (BKTKTokenizerHasError (& tokenizer)) {
 		[errorMsg appendFormat:@"%s\n", tokenizer.buffer];
 	}
 
-	if (BKTKTokenizerHasError (& tokenizer) || BKTKParserHasError (& parser)) {
+	if (BKTKTokenizerHasError (& tokenizer) || BKTKParserHasError (aParser)) {
 		*error = [NSError errorWithDomain:NSPOSIXErrorDomain code:res userInfo:@{
 			NSLocalizedDescriptionKey: errorMsg
 		}];
@@ -120,13 +550,37 @@ static BKInt putToken (BKTKToken const * token, BKCCompiler * self)
 		return NO;
 	}
 
-	nodeTree = BKTKParserGetNodeTree (&parser);
+	return YES;
+}
+
+- (BOOL)compileNodeTree:(BKTKParserNode *)nodeTree error:(NSError **)error
+{
+	BKInt res;
+	UInt64 startTime = BKCRenderClockNow ();
 
-	if ((res = BKTKCompilerCompile (&compiler, nodeTree)) != 0) {
-		[errorMsg appendFormat:@"%s\n", compiler.error.str];
+	compileStatistics.numberOfNodes = countNodes (nodeTree);
+	commandPointers = nil;
 
+	res = BKTKCompilerCompile (compiler, nodeTree);
+
+	compileStatistics.compileTime         = (BKCRenderClockNow () - startTime) * 1e-9;
+	compileStatistics.numberOfInstruments = BKHashTableSize (& compiler -> instruments);
+	compileStatistics.numberOfWaveforms   = BKHashTableSize (& compiler -> waveforms);
+	compileStatistics.numberOfSamples     = BKHashTableSize (& compiler -> samples);
+	compileStatistics.numberOfTracks      = compiler -> tracks.len;
+	[self sampleCompileMemory];
+
+	if (res != 0) {
 		*error = [NSError errorWithDomain:NSPOSIXErrorDomain code:res userInfo:@{
-			NSLocalizedDescriptionKey: errorMsg
+			NSLocalizedDescriptionKey: [NSString stringWithFormat:@"%s\n", compiler -> error.str]
+		}];
+
+		return NO;
+	}
+
+	if (recordsCommandPointers && (commandPointers = [self commandPointersOfNodeTree:nodeTree]) == nil) {
+		*error = [NSError errorWithDomain:NSPOSIXErrorDomain code:EINVAL userInfo:@{
+			NSLocalizedDescriptionKey: @"Couldn't locate pointers in compiled commands\n"
 		}];
 
 		return NO;
@@ -135,11 +589,311 @@ static BKInt putToken (BKTKToken const * token, BKCCompiler * self)
 	return YES;
 }
 
+/**
+ * Compile `nodeTree` again and compare it with the compiled data
+ */
+- (NSArray *)commandPointersOfNodeTree:(BKTKParserNode *)nodeTree
+{
+	NSArray * pointers = nil;
+	BKTKCompiler * shadow = newCompiler ();
+
+	if (shadow == NULL) {
+		return nil;
+	}
+
+	if (BKTKCompilerCompile (shadow, nodeTree) == 0) {
+		pointers = BKCProgramFindCommandPointers (compiler, shadow);
+	}
+
+	BKDispose (shadow);
+	free (shadow);
+
+	return pointers;
+}
+
+- (BOOL)compileBytes:(void const *)bytes size:(NSUInteger)size editedRange:(NSRange)editedRange changeInLength:(NSInteger)delta error:(NSError **)error
+{
+	BOOL success;
+	uint8_t const * chars = bytes;
+	NSUInteger first, next, offset, limit, oldEnd;
+	NSUInteger numTracks = 0, numOldTracks = 0;
+	BOOL globalsChanged = NO, definitionsChanged = NO;
+	NSArray * oldBlocks, * compileBlocks;
+	NSMutableArray * scannedBlocks = [[NSMutableArray alloc] init];
+	NSMutableArray * removedBlocks = [[NSMutableArray alloc] init];
+	NSMutableIndexSet * changedTracks = [[NSMutableIndexSet alloc] init];
+	NSMutableIndexSet * recompiledTracks = nil;
+	NSMutableArray * parsedBlocks = [[NSMutableArray alloc] init];
+	NSMutableArray * removedObjects = [[NSMutableArray alloc] init];
+	NSMutableData * links;
+	BKTKParserNode * nodeTree = NULL, * node;
+	BKTKParserNode ** tail = & nodeTree;
+
+	*error = nil;
+	changedTrackIndexes = nil;
+	oldEnd = NSMaxRange (editedRange) - delta;
+
+	[self beginCompileStatistics];
+
+	// scan everything if there are no blocks yet or the range doesn't fit
+	if (blocks == nil || NSMaxRange (editedRange) > size || delta > (NSInteger) editedRange.length) {
+		blocks = [[NSMutableArray alloc] init];
+		hasCompiledBlocks = NO;
+		editedRange = NSMakeRange (0, size);
+		oldEnd = 0;
+		delta = 0;
+	}
+
+	oldBlocks = blocks;
+
+	for (BKCSourceBlock * block in oldBlocks) {
+		numOldTracks += block -> type == BKCSourceBlockTypeTrack;
+	}
+
+	// blocks touching the edited range
+	for (first = 0; first < oldBlocks.count && NSMaxRange (((BKCSourceBlock *) oldBlocks [first]) -> range) < editedRange.location; first ++);
+	for (next = first; next < oldBlocks.count && ((BKCSourceBlock *) oldBlocks [next]) -> range.location <= oldEnd; next ++);
+
+	offset = first > 0 ? NSMaxRange (((BKCSourceBlock *) oldBlocks [first - 1]) -> range) : 0;
+
+	for (;;) {
+		limit  = next < oldBlocks.count ? ((BKCSourceBlock *) oldBlocks [next]) -> range.location + delta : size;
+		offset = scanBlocks (chars, size, offset, limit, scannedBlocks);
+
+		if (next >= oldBlocks.count || offset <= ((BKCSourceBlock *) oldBlocks [next]) -> range.location + delta) {
+			break;
+		}
+
+		// a block end was removed; following blocks have to be rescanned
+		while (next < oldBlocks.count && ((BKCSourceBlock *) oldBlocks [next]) -> range.location + delta < offset) {
+			next ++;
+		}
+	}
+
+	// reuse parse trees of unchanged blocks
+	for (NSUInteger i = 0; i < scannedBlocks.count; i ++) {
+		BKCSourceBlock * block = scannedBlocks [i];
+
+		for (NSUInteger j = first; j < next; j ++) {
+			BKCSourceBlock * oldBlock = oldBlocks [j];
+
+			if (oldBlock -> parsed && oldBlock -> type == block -> type && oldBlock -> hash == block -> hash && oldBlock -> range.length == block -> range.length && (block -> name == oldBlock -> name || [block -> name isEqualToString:oldBlock -> name])) {
+				oldBlock -> range = block -> range;
+				scannedBlocks [i] = oldBlock;
+				break;
+			}
+		}
+	}
+
+	for (NSUInteger j = first; j < next; j ++) {
+		BKCSourceBlock * oldBlock = oldBlocks [j];
+
+		if ([scannedBlocks indexOfObjectIdenticalTo:oldBlock] == NSNotFound) {
+			[removedBlocks addObject:oldBlock];
+
+			globalsChanged     |= isGlobalBlock (oldBlock);
+			definitionsChanged |= isDefinitionBlock (oldBlock);
+		}
+	}
+
+	for (NSUInteger j = next; j < oldBlocks.count; j ++) {
+		BKCSourceBlock * oldBlock = oldBlocks [j];
+
+		oldBlock -> range.location += delta;
+	}
+
+	blocks = [[NSMutableArray alloc] initWithArray:[oldBlocks subarrayWithRange:NSMakeRange (0, first)]];
+	[blocks addObjectsFromArray:scannedBlocks];
+	[blocks addObjectsFromArray:[oldBlocks subarrayWithRange:NSMakeRange (next, oldBlocks.count - next)]];
+
+	for (BKCSourceBlock * block in blocks) {
+		if (!block -> parsed) {
+			BKTKTokenizerReset (& tokenizer);
+			BKTKParserReset (& block -> parser);
+
+			[parsedBlocks addObject:block];
+
+			if (![self parseBytes:& chars [block -> range.location] size:block -> range.length parser:& block -> parser error:error]) {
+				break;
+			}
+
+			block -> parsed = YES;
+
+			if (block -> type == BKCSourceBlockTypeTrack) {
+				[changedTracks addIndex:numTracks];
+			}
+
+			globalsChanged     |= isGlobalBlock (block);
+			definitionsChanged |= isDefinitionBlock (block);
+		}
+
+		numTracks += block -> type == BKCSourceBlockTypeTrack;
+	}
+
+	if (*error) {
+		[self invalidateBlocks:parsedBlocks];
+		[self endCompileStatistics];
+		return NO;
+	}
+
+	// tracks are replaced by index
+	if (!hasCompiledBlocks || globalsChanged || numTracks != numOldTracks || recordsCommandPointers) {
+		changedTrackIndexes = nil;
+		compileBlocks = blocks;
+		BKTKCompilerReset (compiler);
+	}
+	else {
+		// tracks refer to the objects they use
+		changedTrackIndexes = definitionsChanged ? nil : changedTracks;
+		recompiledTracks = [[NSMutableIndexSet alloc] init];
+		compileBlocks = [self blocksToRecompile:parsedBlocks changedTracks:changedTracks allTracks:definitionsChanged recompiledTracks:recompiledTracks];
+
+		// objects are disposed after the tracks referring to them
+		for (BKCSourceBlock * block in removedBlocks) {
+			void * object = removeDefinition (compiler, block);
+
+			if (object) {
+				[removedObjects addObject:[NSValue valueWithPointer:object]];
+			}
+		}
+	}
+
+	links = [[NSMutableData alloc] initWithLength:compileBlocks.count * sizeof (BKTKParserNode **)];
+
+	// link parse trees of compiled blocks temporarily
+	for (NSUInteger i = 0; i < compileBlocks.count; i ++) {
+		BKCSourceBlock * block = compileBlocks [i];
+
+		if ((node = BKTKParserGetNodeTree (& block -> parser))) {
+			((BKTKParserNode ***) links.mutableBytes) [i] = tail;
+			*tail = node;
+
+			while (node -> nextNode) {
+				node = node -> nextNode;
+			}
+
+			tail = & node -> nextNode;
+		}
+	}
+
+	success = [self compileNodeTree:nodeTree error:error];
+
+	for (NSUInteger i = 0; i < compileBlocks.count; i ++) {
+		if ((tail = ((BKTKParserNode ***) links.bytes) [i])) {
+			*tail = NULL;
+		}
+	}
+
+	if (success && recompiledTracks) {
+		[self replaceTracksAtIndexes:recompiledTracks];
+	}
+
+	for (NSValue * object in removedObjects) {
+		BKDispose (object.pointerValue);
+	}
+
+	hasCompiledBlocks = success;
+
+	// report changes again with the next compilation
+	if (!success) {
+		changedTrackIndexes = nil;
+		[self invalidateBlocks:parsedBlocks];
+	}
+
+	[self endCompileStatistics];
+
+	return success;
+}
+
+/**
+ * Blocks which have to be compiled into the existing compiled data
+ *
+ * These are the re-parsed definitions and the changed tracks, or all tracks
+ * if `allTracks` is set. Indexes of these tracks are added to
+ * `recompiledTracks`.
+ */
+- (NSArray *)blocksToRecompile:(NSArray *)parsedBlocks changedTracks:(NSIndexSet *)changedTracks allTracks:(BOOL)allTracks recompiledTracks:(NSMutableIndexSet *)recompiledTracks
+{
+	NSUInteger trackIndex = 0;
+	NSMutableArray * compileBlocks = [[NSMutableArray alloc] init];
+
+	for (BKCSourceBlock * block in blocks) {
+		if (block -> type == BKCSourceBlockTypeTrack) {
+			if (allTracks || [changedTracks containsIndex:trackIndex]) {
+				[compileBlocks addObject:block];
+				[recompiledTracks addIndex:trackIndex];
+			}
+
+			trackIndex ++;
+		}
+		else if ([parsedBlocks indexOfObjectIdenticalTo:block] != NSNotFound) {
+			[compileBlocks addObject:block];
+		}
+	}
+
+	return compileBlocks;
+}
+
+/**
+ * Move tracks appended by the last compilation to `indexes`
+ *
+ * The previous tracks at these indexes are disposed
+ */
+- (void)replaceTracksAtIndexes:(NSIndexSet *)indexes
+{
+	NSUInteger newIndex = compiler -> tracks.len - indexes.count;
+
+	for (NSUInteger index = indexes.firstIndex; index != NSNotFound; index = [indexes indexGreaterThanIndex:index]) {
+		BKTKCompilerTrack ** slot = BKArrayItemAt (& compiler -> tracks, index);
+		BKTKCompilerTrack ** newSlot = BKArrayItemAt (& compiler -> tracks, newIndex ++);
+		BKTKCompilerTrack * oldTrack = *slot;
+
+		*slot    = *newSlot;
+		*newSlot = oldTrack;
+	}
+
+	// previous tracks are at the end now
+	for (NSUInteger i = 0; i < indexes.count; i ++) {
+		BKTKCompilerTrack * oldTrack = NULL;
+
+		BKArrayPop (& compiler -> tracks, & oldTrack);
+		BKDispose (oldTrack);
+	}
+
+	compileStatistics.numberOfTracks = compiler -> tracks.len;
+}
+
+- (void)invalidateBlocks:(NSArray *)invalidBlocks
+{
+	for (BKCSourceBlock * block in invalidBlocks) {
+		block -> parsed = NO;
+	}
+}
+
+- (BKCProgram *)program
+{
+	BKCProgram * program;
+	BKTKCompiler * emptyCompiler = newCompiler ();
+
+	if (emptyCompiler == NULL) {
+		NSLog (@"*** Couldn't allocate compiler");
+		return nil;
+	}
+
+	// program takes over compiled state
+	program  = [[BKCProgram alloc] initWithCompiler:compiler commandPointers:commandPointers];
+	compiler = emptyCompiler;
+
+	[self reset];
+
+	return program;
+}
+
 - (BKInstrument *)instrumentByName:(NSString *)name
 {
 	BKTKInstrument* instrument = NULL;
 
-	BKHashTableLookup(&compiler.instruments, name.UTF8String, (void **) &instrument);
+	BKHashTableLookup(&compiler -> instruments, name.UTF8String, (void **) &instrument);
 
 	return instrument ? &instrument->instr : NULL;
 }
@@ -148,7 +902,7 @@ static BKInt putToken (BKTKToken const * token, BKCCompiler * self)
 {
 	BKTKWaveform* waveform = NULL;
 
-	BKHashTableLookup(&compiler.waveforms, name.UTF8String, (void **) &waveform);
+	BKHashTableLookup(&compiler -> waveforms, name.UTF8String, (void **) &waveform);
 
 	return waveform ? &waveform->data : NULL;
 }
@@ -157,7 +911,7 @@ static BKInt putToken (BKTKToken const * token, BKCCompiler * self)
 {
 	BKTKSample* sample = NULL;
 
-	BKHashTableLookup(&compiler.samples, name.UTF8String, (void**) &sample);
+	BKHashTableLookup(&compiler -> samples, name.UTF8String, (void**) &sample);
 
 	return sample ? &sample->data : NULL;
 }
@@ -167,9 +921,9 @@ static BKInt putToken (BKTKToken const * token, BKCCompiler * self)
 	BKHashTableIterator itor;
 	char const * key;
 	BKTKInstrument * instr;
-	NSMutableDictionary * instruments = [[NSMutableDictionary alloc] initWithCapacity:BKHashTableSize (&compiler.instruments)];
+	NSMutableDictionary * instruments = [[NSMutableDictionary alloc] initWithCapacity:BKHashTableSize (&compiler -> instruments)];
 
-	BKHashTableIteratorInit (&itor, &compiler.instruments);
+	BKHashTableIteratorInit (&itor, &compiler -> instruments);
 
 	while (BKHashTableIteratorNext (&itor, &key, (void **) &instr)) {
 		BKCInstrument * instrument = [[BKCInstrument alloc] initWithInstrument: &instr -> instr];
@@ -182,7 +936,10 @@ static BKInt putToken (BKTKToken const * token, BKCCompiler * self)
 
 - (void)reset
 {
-	BKTKCompilerReset (& compiler);
+	hasCompiledBlocks = NO;
+	commandPointers   = nil;
+
+	BKTKCompilerReset (compiler);
 	BKTKParserReset (& parser);
 	BKTKTokenizerReset (& tokenizer);
 }
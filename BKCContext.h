@@ -23,17 +23,85 @@
 
 #import <Foundation/Foundation.h>
 #import "BlipKit.h"
-#import "BKCAudioUnit.h"
 #import "BKCBase.h"
+#if BKC_AUDIO_UNIT
+#import "BKCAudioUnit.h"
+#endif
+#import "BKCCommandQueue.h"
+#import "BKCEventScheduler.h"
+#import "BKCLoadStatistics.h"
+#import "BKCRenderCounters.h"
+#import "BKCRenderPipeline.h"
+#import "BKCResampler.h"
 #import "BKCCompiler.h"
 #import "BKTKContext.h"
 
-@interface BKCContext : NSObject <BKCAttributes, BKCAudioUnitDelegate>
+/**
+ * Output format of offline rendering
+ */
+typedef NS_ENUM(NSInteger, BKCRenderFormat)
+{
+	BKCRenderFormatWAVE,
+	BKCRenderFormatRaw,
+};
+
+/**
+ * Statistics of the last offline rendering
+ */
+typedef struct
+{
+	UInt64         numberOfFrames;
+	NSTimeInterval renderTime;
+	double         framesPerSecond;
+	BOOL           stoppedOnSilence;
+} BKCRenderStatistics;
+
+/**
+ * Block which receives rendered chunks
+ *
+ * Return NO to stop rendering
+ */
+typedef BOOL (^ BKCRenderChunkHandler) (SInt16 const * frames, UInt32 numberFrames);
+
+@interface BKCContext : NSObject <BKCAttributes>
 {
-	BKContext        renderCtx;
-	BKTKContext      parserCtx;
-	NSMutableArray * tracks;
-	NSMutableArray * dividers;
+	BKContext           renderCtx;
+	BKTKContext         parserCtx;
+	BKCProgram        * program;
+	NSMutableArray    * tracks;
+	NSMutableArray    * programTracks;
+	NSMutableArray    * parserGenerations;
+	NSMutableArray    * dividers;
+	BKCCommandQueue   * commandQueue;
+	BKCEventScheduler * eventScheduler;
+	NSMutableData     * renderBuffer;
+	SInt16            * outputBuffer;
+	BKCRenderStatistics renderStatistics;
+	BKCRenderCounters   renderCounters;
+	id                  stemSession;
+	id                  checkpointStore;
+	id                  synthesisSession;
+	NSUInteger          numberOfSynthesisThreads;
+	NSUInteger          parallelSynthesisThreshold;
+	BKCRenderPipeline * renderPipeline;
+	UInt32              outputSampleRate;
+	BKCResamplerQuality resamplerQuality;
+	BKCResampler      * resampler;
+	SInt16            * resampleBuffer;
+	NSTimeInterval      idleTrackTimeout;
+	NSTimeInterval      idleContextTimeout;
+	NSTimeInterval      autoSuspendTimeout;
+	UInt64              frameTimeOffset;
+	atomic_ullong       silentFrames;
+	atomic_ulong        activityCount;
+	atomic_ulong        clockUserCount;
+	atomic_bool         suspended;
+	BOOL                suspendRequested;
+	NSUInteger          lastActivityCount;
+	dispatch_source_t   suspendSource;
+	BKCLoadStatistics   attachStatistics;
+	UInt64              attachStartTime;
+	NSUInteger          attachStartMemory;
 }
 
 /**
@@ -46,17 +114,24 @@
  */
 @property (readonly, nonatomic)  BKTKContext * parserContext;
 
+/**
+ * The program instantiated with addTracksFromProgram:
+ */
+@property (readonly, nonatomic)  BKCProgram * program;
+
 /**
  * An array of attached tracks
  */
 @property (readonly, nonatomic)  NSArray * tracks;
 
+#if BKC_AUDIO_UNIT
 /**
  * An audio unit which can be used to output audio
  *
  * If no one is assigned one is created
  */
 @property (readwrite, nonatomic)  BKCAudioUnit * audioUnit;
+#endif
 
 /**
  * The lock which is used to protect BlipKit calls
@@ -65,6 +140,36 @@
  */
 @property (readonly, nonatomic) NSRecursiveLock * unitLock;
 
+/**
+ * Queue which passes changes to the render thread
+ *
+ * If assigned, changes made through the BKCAttributes protocol and by
+ * attaching tracks and dividers are pushed to this queue instead of taking
+ * `unitLock`. The queue is drained at the beginning of
+ * generateFrames:numberFrames: and the audio unit's render callback doesn't
+ * take the lock anymore.
+ *
+ * `reset` and addTracksFromCompiler: still use the lock and must not be
+ * called while the audio unit is started. Should only be assigned while
+ * the audio unit is stopped.
+ */
+@property (readwrite, nonatomic) BKCCommandQueue * commandQueue;
+
+/**
+ * Commands which are executed at an exact frame time
+ *
+ * generateFrames:numberFrames: splits the generated frames at event times
+ */
+@property (readonly, nonatomic) BKCEventScheduler * eventScheduler;
+
+/**
+ * Current frame time of the render thread
+ *
+ * This is BK_TIME of the render context after the last generated buffer.
+ * Events are scheduled relative to it.
+ */
+@property (readonly, nonatomic) UInt64 frameTime;
+
 /**
  * The sample rate
  */
@@ -75,11 +180,131 @@
  */
 @property (readonly, nonatomic) UInt32 numberOfChannels;
 
+/**
+ * Sample rate of the audio unit
+ *
+ * Tracks are synthesized at `sampleRate` and resampled to this rate by
+ * generateOutputFrames:numberFrames: and the audio unit's render callback.
+ * Chiptune content has nothing audible above the Nyquist frequency of
+ * a low internal rate, so synthesizing at e.g. 22050 Hz and upsampling
+ * once to the device rate saves CPU time. Frame times of events and
+ * offline rendering stay in `sampleRate`. Setting 0 or `sampleRate`
+ * disables resampling. Should only be changed while the audio unit is
+ * stopped.
+ */
+@property (readwrite, nonatomic) UInt32 outputSampleRate;
+
+/**
+ * Quality of the resampler used for `outputSampleRate`
+ *
+ * Default is BKCResamplerQualityMedium
+ */
+@property (readwrite, nonatomic) BKCResamplerQuality resamplerQuality;
+
 /**
  * Number of ticks per second
  */
 @property (readwrite, nonatomic) UInt32 clockPeriod;
 
+/**
+ * Number of frames rendered at once by offline rendering
+ *
+ * Default is 8192
+ */
+@property (readwrite, nonatomic) UInt32 renderChunkSize;
+
+/**
+ * Stop offline rendering after this duration of silence
+ *
+ * Only stops after all program tracks have stopped or repeated; quiet
+ * passages before are rendered. Trailing silence is not passed to the
+ * chunk handler. Default is 2 seconds. Set to 0 to disable.
+ */
+@property (readwrite, nonatomic) NSTimeInterval renderSilenceTimeout;
+
+/**
+ * Skip synthesis of tracks which were silent for this duration
+ *
+ * A track is silent if it is muted or its volume or master volume is 0, and
+ * no volume slide is active. Only changes made through BKCTrack are
+ * observed; tracks of the program are never skipped. A skipped track is
+ * detached from the BlipKit context and reattached when it's changed
+ * again. Default is 0, which disables it.
+ */
+@property (readwrite, nonatomic) NSTimeInterval idleTrackTimeout;
+
+/**
+ * Emit silence without synthesis after the output was silent for this
+ * duration
+ *
+ * Is only used when no dividers and no program are attached. Synthesis
+ * continues when a command is drained, the lock was taken or an event is
+ * due. Default is 0, which disables it.
+ */
+@property (readwrite, nonatomic) NSTimeInterval idleContextTimeout;
+
+/**
+ * Stop the audio unit after the output was silent for this duration
+ *
+ * Saves battery on devices where audio is idle most of the time. The unit
+ * is started again by `resume`, which is called automatically when the lock
+ * is taken, a command is pushed to `commandQueue` or a command is
+ * scheduled. Default is 0 which disables suspending.
+ */
+@property (readwrite, nonatomic) NSTimeInterval autoSuspendTimeout;
+
+/**
+ * Number of frames generated ahead on a dedicated thread
+ *
+ * If not 0, frames are generated by `renderPipeline` and the audio unit's
+ * render callback only copies them, which makes playback robust against
+ * spikes in synthesis cost in exchange for this much latency. Changes are
+ * applied when frames are generated. Default is 0 which generates frames
+ * in the render callback. Should only be changed while the audio unit is
+ * stopped.
+ */
+@property (readwrite, nonatomic) NSUInteger lookaheadDepth;
+
+/**
+ * The pipeline used by `lookaheadDepth`
+ *
+ * Reports fill level and underruns of the lookahead
+ */
+@property (readonly, nonatomic) BKCRenderPipeline * renderPipeline;
+
+/**
+ * Counts and phase times of the last attached program
+ *
+ * Is updated by addTracksFromProgram:, addTracksFromCompiler: and
+ * updateTracksFromProgram:changedTrackIndexes:
+ */
+@property (readonly, nonatomic) BKCLoadStatistics lastAttachStatistics;
+
+/**
+ * Check if the audio unit was stopped by `autoSuspendTimeout`
+ */
+@property (readonly, nonatomic, getter=isSuspended) BOOL suspended;
+
+/**
+ * Statistics of the last offline rendering
+ */
+@property (readonly, nonatomic) BKCRenderStatistics lastRenderStatistics;
+
+/**
+ * Counters of frame generation and divider callbacks
+ */
+@property (readonly, nonatomic) BKCRenderCounters * renderCounters;
+
+/**
+ * Snapshot of render thread counters
+ *
+ * Contains frames requested and produced by generateFrames:numberFrames:,
+ * frames filled with silence, divider callback times and the counters of
+ * `audioUnit`, if one is assigned. Can be read from any thread without
+ * locking.
+ */
+@property (readonly, nonatomic) BKCRenderThreadStatistics renderThreadStatistics;
+
 /**
  * Initialize with number of channels and sample rate
  *
@@ -94,28 +319,125 @@
  */
 - (BKInt)generateFrames:(SInt16 *)outBuffer numberFrames:(UInt32)inNumberFrames;
 
+/**
+ * Generate frames at `outputSampleRate` and copy to `outBuffer`
+ *
+ * Is the same as generateFrames:numberFrames: if no resampling is needed.
+ * Missing frames are filled with silence.
+ */
+- (BKInt)generateOutputFrames:(SInt16 *)outBuffer numberFrames:(UInt32)inNumberFrames;
+
+/**
+ * Render faster than realtime and pass chunks to `handler`
+ *
+ * Renders until `duration` is reached or the output was silent for
+ * `renderSilenceTimeout` after the song has ended. Silence before reaching
+ * `duration` is passed to the handler. A `duration` of 0 renders until
+ * silent.
+ * No lock is taken; the audio unit must not be started.
+ */
+- (BOOL)renderWithChunkHandler:(BKCRenderChunkHandler)handler duration:(NSTimeInterval)duration;
+
+/**
+ * Render faster than realtime into file
+ *
+ * Stops as described in renderWithChunkHandler:duration:
+ */
+- (BOOL)renderToURL:(NSURL *)url duration:(NSTimeInterval)duration format:(BKCRenderFormat)format error:(NSError **)error;
+
+/**
+ * Generate frames in the given format and copy to `outBuffers`
+ *
+ * `outBuffers` contains one buffer per channel if not interleaved, otherwise
+ * a single buffer. Each buffer must have space for `inNumberFrames` frames
+ * of all channels it contains. Frames are converted in a single pass and
+ * generated at `outputSampleRate`.
+ */
+- (BKInt)generateFrames:(void * const *)outBuffers numberFrames:(UInt32)inNumberFrames sampleFormat:(BKCSampleFormat)sampleFormat interleaved:(BOOL)interleaved;
+
 /**
  * Add tracks from compiler
+ *
+ * Instantiates the last compiled result of `compiler` and attaches its
+ * tracks. The tracks refer to the compiler's data; the compiler is retained
+ * and must not compile again while they are used. Use addTracksFromProgram:
+ * to share compiled data between contexts.
  */
 - (BOOL)addTracksFromCompiler:(BKCCompiler *)compiler;
 
 /**
- * Calls audioUnit's start method
+ * Instantiate a shared program
+ *
+ * Creates the parser context from the program's compiled data without
+ * copying it and attaches its tracks. The program is retained by the
+ * context. Any number of contexts can instantiate the same program from any
+ * thread.
+ */
+- (BOOL)addTracksFromProgram:(BKCProgram *)program;
+
+/**
+ * Replace tracks with those of a recompiled program without resetting
+ *
+ * Only tracks in `indexes` are replaced and start playing from the new
+ * program; the other tracks keep playing. If `indexes` is nil all tracks
+ * are replaced. The program must have the same number of tracks. If a
+ * commandQueue is assigned, the swap is pushed as a single batch which is
+ * applied in one drain; fails if the batch doesn't fit into the queue.
+ * Checkpoints are removed.
+ */
+- (BOOL)updateTracksFromProgram:(BKCProgram *)program changedTrackIndexes:(NSIndexSet *)indexes;
+
+/**
+ * Set attribute of context at frame time
+ */
+- (BOOL)setAttribute:(BKCAttr)attribute value:(BKInt)value atTime:(UInt64)time;
+
+/**
+ * Schedule command at frame time
+ *
+ * `object` is kept alive until the command was executed
+ */
+- (BOOL)scheduleCommand:(BKCCommand *)command atTime:(UInt64)time retainingObject:(id)object;
+
+/**
+ * Set render thread counters of context and audioUnit to 0
+ */
+- (void)resetRenderThreadStatistics;
+
+/**
+ * Calls audioUnit's start method and starts `renderPipeline`
  */
 - (BOOL)start;
 
 /**
- * Calls audioUnit's stop method
+ * Calls audioUnit's stop method and stops `renderPipeline`
  */
 - (BOOL)stop;
 
+/**
+ * Start the audio unit if it was suspended
+ */
+- (void)resume;
+
 /**
  * Reset underlaying BlipKit context
+ *
+ * Does nothing while the audio unit or render pipeline renders with a
+ * command queue; stop them before.
  */
 - (void)reset;
 
 @end
 
+#if BKC_AUDIO_UNIT
+/**
+ * Renders the output of the audio unit
+ */
+@interface BKCContext (AudioUnit) <BKCAudioUnitDelegate>
+
+@end
+#endif
+
 /**
  * Locking methods
  */
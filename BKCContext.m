@@ -22,15 +22,89 @@
  */
 
 #import "BKCContext.h"
+#import "BKCContext_internal.h"
+#import "BKCCheckpoints.h"
+#import "BKCOutputKernels.h"
+#import "BKCParallelSynthesis.h"
+#import "BKCProgram_internal.h"
+#import "BKCRealtimeChecker.h"
+#import "BKCStems.h"
 #import "BKCTrack.h"
+#import "BKWaveFileWriter.h"
 
 #define DEFAULT_NUM_CHANNELS 2
 #define DEFAULT_SAMPLE_RATE 44100
+#define DEFAULT_RENDER_CHUNK_SIZE 8192
+#define DEFAULT_RENDER_SILENCE_TIMEOUT 2.0
+#define OUTPUT_BUFFER_SIZE 1024
+#define DEFAULT_RESAMPLER_QUALITY BKCResamplerQualityMedium
+#define DEFAULT_IDLE_TRACK_TIMEOUT 0.0
+#define DEFAULT_IDLE_CONTEXT_TIMEOUT 0.0
+#define DEFAULT_PARALLEL_SYNTHESIS_THRESHOLD 32
+#define LOOKAHEAD_CHUNK_SIZE 256
+
+/**
+ * Parser context created from a program
+ *
+ * Is kept as long as one of its tracks is playing
+ */
+@interface BKCParserGeneration : NSObject
+{
+@public
+	BKTKContext * parserCtx;
+	BKCProgram  * program;
+	BKCCompiler * compiler;
+	BOOL          ownsContext;
+}
+
+@end
+
+@implementation BKCParserGeneration
+
+- (void)dealloc
+{
+	if (ownsContext) {
+		BKDispose (parserCtx);
+		free (parserCtx);
+	}
+}
+
+- (BOOL)containsTrack:(BKTrack *)track
+{
+	for (BKUSize i = 0; i < parserCtx -> tracks.len; i ++) {
+		BKTKTrack * parserTrack = *(BKTKTrack **) BKArrayItemAt (&parserCtx -> tracks, i);
+
+		if (parserTrack && &parserTrack -> renderTrack == track) {
+			return YES;
+		}
+	}
+
+	return NO;
+}
+
+@end
+
+static BKTKTrack * parserTrackOfTrack (BKTrack * track)
+{
+	return (BKTKTrack *) ((char *) track - offsetof (BKTKTrack, renderTrack));
+}
 
 @implementation BKCContext
 
+#if BKC_AUDIO_UNIT
 @synthesize audioUnit;
+#endif
 @synthesize unitLock;
+@synthesize commandQueue;
+@synthesize eventScheduler;
+@synthesize renderChunkSize;
+@synthesize renderSilenceTimeout;
+@synthesize idleTrackTimeout;
+@synthesize idleContextTimeout;
+@synthesize autoSuspendTimeout;
+@synthesize renderPipeline;
+@synthesize renderBuffer;
+@synthesize program;
 
 - (instancetype)init
 {
@@ -56,9 +130,49 @@
 			return nil;
 		}
 
-		tracks   = [[NSMutableArray alloc] init];
-		dividers = [[NSMutableArray alloc] init];
+		eventScheduler = [[BKCEventScheduler alloc] init];
+
+		if (eventScheduler == nil) {
+			return nil;
+		}
+
+		tracks        = [[NSMutableArray alloc] init];
+		programTracks = [[NSMutableArray alloc] init];
+		dividers      = [[NSMutableArray alloc] init];
 		unitLock = [[NSRecursiveLock alloc] init];
+
+		BKCRenderCountersReset (& renderCounters);
+
+		renderChunkSize      = DEFAULT_RENDER_CHUNK_SIZE;
+		renderSilenceTimeout = DEFAULT_RENDER_SILENCE_TIMEOUT;
+		outputSampleRate     = sampleRate;
+		resamplerQuality     = DEFAULT_RESAMPLER_QUALITY;
+		idleTrackTimeout     = DEFAULT_IDLE_TRACK_TIMEOUT;
+		idleContextTimeout   = DEFAULT_IDLE_CONTEXT_TIMEOUT;
+
+		numberOfSynthesisThreads   = 1;
+		parallelSynthesisThreshold = DEFAULT_PARALLEL_SYNTHESIS_THRESHOLD;
+
+		atomic_init (& silentFrames, 0);
+		atomic_init (& activityCount, 0);
+		atomic_init (& clockUserCount, 0);
+		atomic_init (& suspended, NO);
+
+		__weak BKCContext * weakSelf = self;
+
+		// suspending is requested by the render thread
+		suspendSource = dispatch_source_create (DISPATCH_SOURCE_TYPE_DATA_ADD, 0, 0, dispatch_get_global_queue (QOS_CLASS_UTILITY, 0));
+		dispatch_source_set_event_handler (suspendSource, ^{
+			[weakSelf suspendIfSilent];
+		});
+		dispatch_resume (suspendSource);
+
+		outputBuffer = malloc (OUTPUT_BUFFER_SIZE * numberOfChannels * sizeof (SInt16));
+
+		if (outputBuffer == NULL) {
+			NSLog (@"*** Couldn't allocate output buffer");
+			return nil;
+		}
 	}
 
 	return self;
@@ -66,8 +180,23 @@
 
 - (void)dealloc
 {
+	[renderPipeline stop];
+	[self endStems];
+	[self endSynthesisSession];
 	BKDispose (& renderCtx);
 	BKDispose (& parserCtx);
+
+	if (outputBuffer) {
+		free (outputBuffer);
+	}
+
+	if (resampleBuffer) {
+		free (resampleBuffer);
+	}
+
+	if (suspendSource) {
+		dispatch_source_cancel (suspendSource);
+	}
 }
 
 - (BKContext *)renderContext
@@ -95,6 +224,74 @@
 	return renderCtx.numChannels;
 }
 
+- (UInt32)outputSampleRate
+{
+	return outputSampleRate;
+}
+
+- (void)setOutputSampleRate:(UInt32)newOutputSampleRate
+{
+	if (newOutputSampleRate == 0) {
+		newOutputSampleRate = renderCtx.sampleRate;
+	}
+
+	if ([self updateResamplerWithSampleRate:newOutputSampleRate quality:resamplerQuality]) {
+		outputSampleRate = newOutputSampleRate;
+#if BKC_AUDIO_UNIT
+		audioUnit.sampleRate = outputSampleRate;
+#endif
+	}
+}
+
+- (BKCResamplerQuality)resamplerQuality
+{
+	return resamplerQuality;
+}
+
+- (void)setResamplerQuality:(BKCResamplerQuality)newResamplerQuality
+{
+	if ([self updateResamplerWithSampleRate:outputSampleRate quality:newResamplerQuality]) {
+		resamplerQuality = newResamplerQuality;
+	}
+}
+
+/**
+ * Replace resampler and its input buffer
+ */
+- (BOOL)updateResamplerWithSampleRate:(UInt32)newSampleRate quality:(BKCResamplerQuality)quality
+{
+	BKCResampler * newResampler = nil;
+	SInt16 * newBuffer = NULL;
+	SInt16 * oldBuffer;
+
+	if (newSampleRate != renderCtx.sampleRate) {
+		newResampler = [[BKCResampler alloc] initWithInputSampleRate:renderCtx.sampleRate outputSampleRate:newSampleRate numberOfChannels:renderCtx.numChannels quality:quality capacity:OUTPUT_BUFFER_SIZE];
+
+		if (newResampler == nil) {
+			return NO;
+		}
+
+		newBuffer = malloc (newResampler.maximumNumberOfInputFrames * renderCtx.numChannels * sizeof (SInt16));
+
+		if (newBuffer == NULL) {
+			NSLog (@"*** Couldn't allocate resample buffer");
+			return NO;
+		}
+	}
+
+	[self lock];
+	resampler = newResampler;
+	oldBuffer = resampleBuffer;
+	resampleBuffer = newBuffer;
+	[self unlock];
+
+	if (oldBuffer) {
+		free (oldBuffer);
+	}
+
+	return YES;
+}
+
 - (UInt32)clockPeriod
 {
 	BKTime time;
@@ -113,23 +310,164 @@
 
 - (BOOL)start
 {
+	atomic_store_explicit (& suspended, NO, memory_order_release);
+	[renderPipeline start];
+
+#if BKC_AUDIO_UNIT
 	return [self.audioUnit start];
+#else
+	return YES;
+#endif
 }
 
 - (BOOL)stop
 {
-	return [self.audioUnit stop];
+	BOOL res = YES;
+
+#if BKC_AUDIO_UNIT
+	res = [self.audioUnit stop];
+#endif
+
+	[renderPipeline stop];
+
+	return res;
+}
+
+/**
+ * The audio unit only takes the lock if nothing else synchronizes rendering
+ */
+- (void)updateRenderCallbackLocking
+{
+#if BKC_AUDIO_UNIT
+	audioUnit.locksRenderCallback = (commandQueue == nil && renderPipeline == nil);
+#endif
+}
+
+- (NSUInteger)lookaheadDepth
+{
+	return renderPipeline.depth;
+}
+
+- (void)setLookaheadDepth:(NSUInteger)newDepth
+{
+	BKCRenderPipeline * newPipeline = nil;
+	BOOL running = renderPipeline.running;
+
+	if (newDepth == renderPipeline.depth) {
+		return;
+	}
+
+	if (newDepth) {
+		newPipeline = [[BKCRenderPipeline alloc] initWithContext:self depth:newDepth chunkSize:LOOKAHEAD_CHUNK_SIZE];
+
+		if (newPipeline == nil) {
+			return;
+		}
+	}
+
+	[renderPipeline stop];
+
+	[unitLock lock];
+	renderPipeline = newPipeline;
+	[self updateRenderCallbackLocking];
+	[unitLock unlock];
+
+	if (running) {
+		[renderPipeline start];
+	}
+}
+
+- (BOOL)isSuspended
+{
+	return atomic_load_explicit (& suspended, memory_order_acquire);
+}
+
+- (void)resume
+{
+	if (atomic_exchange_explicit (& suspended, NO, memory_order_acq_rel)) {
+		// render thread is not running
+		atomic_store_explicit (& silentFrames, 0, memory_order_relaxed);
+#if BKC_AUDIO_UNIT
+		[audioUnit start];
+#endif
+	}
+}
+
+/**
+ * Record a change which may end silence
+ */
+- (void)noteActivity
+{
+	atomic_fetch_add_explicit (& activityCount, 1, memory_order_relaxed);
+
+	if (atomic_load_explicit (& suspended, memory_order_acquire)) {
+		[self resume];
+	}
+}
+
+/**
+ * Stop the audio unit if the output is still silent
+ *
+ * Is called on a background queue when requested by the render thread
+ */
+- (void)suspendIfSilent
+{
+	NSUInteger activity = atomic_load_explicit (& activityCount, memory_order_relaxed);
+	UInt64 suspendFrames = (UInt64) (autoSuspendTimeout * renderCtx.sampleRate);
+
+	if (suspendFrames == 0 || atomic_load_explicit (& silentFrames, memory_order_relaxed) < suspendFrames) {
+		return;
+	}
+
+	if (atomic_load_explicit (& suspended, memory_order_acquire)) {
+		return;
+	}
+
+#if BKC_AUDIO_UNIT
+	[audioUnit stop];
+#endif
+	atomic_store_explicit (& suspended, YES, memory_order_release);
+
+	// changed while stopping
+	if (atomic_load_explicit (& activityCount, memory_order_relaxed) != activity) {
+		[self resume];
+	}
 }
 
 - (void)reset
 {
+	// render thread pops scheduled events and generates frames
+	if ([self rendersWithoutLock]) {
+		NSLog (@"*** Context can't be reset while rendering with a command queue or render pipeline");
+		return;
+	}
+
+	[self lock];
+
+	[self endStems];
+	[eventScheduler reset];
+	[resampler reset];
+	[renderPipeline flush];
+	frameTimeOffset = 0;
+	atomic_store_explicit (& silentFrames, 0, memory_order_relaxed);
 	BKContextReset (& renderCtx);
+	[self resetSynthesisContexts];
 	BKTKContextReset (& parserCtx);
+
+	[self unlock];
 }
 
 - (BOOL)setAttribute:(BKCAttr)attribute value:(BKInt)value
 {
 	BKInt res;
+	BKCCommand command;
+
+	if (commandQueue) {
+		BKCCommandInit (& command, BKCCommandTypeSetAttribute, & renderCtx, attribute);
+		command.value = value;
+
+		return [commandQueue pushCommand:& command];
+	}
 
 	[self lock];
 	res = BKSetAttr (& renderCtx, attribute, value);
@@ -152,6 +490,19 @@
 - (BOOL)setPointer:(BKCAttr)attribute value:(void *)value size:(NSUInteger)size
 {
 	BKInt res;
+	BKCCommand command;
+
+	if (commandQueue) {
+		BKCCommandInit (& command, BKCCommandTypeSetPointer, & renderCtx, attribute);
+
+		if (BKCCommandSetValues (& command, value, size)) {
+			return [commandQueue pushCommand:& command];
+		}
+
+		NSLog (@"*** Value of size %lu is too large to be queued", (unsigned long) size);
+
+		return NO;
+	}
 
 	[self lock];
 	res = BKSetPtr (& renderCtx, attribute, value, size);
@@ -181,10 +532,12 @@
 	return [self getPointer:attribute value:value size:sizeof (BKInt) * count];
 }
 
+#if BKC_AUDIO_UNIT
+
 - (BKCAudioUnit *)audioUnit
 {
 	if (audioUnit == nil) {
-		self.audioUnit = [[BKCAudioUnit alloc] initWithNumberOfChannels:self.numberOfChannels sampleRate:self.sampleRate];
+		self.audioUnit = [[BKCAudioUnit alloc] initWithNumberOfChannels:self.numberOfChannels sampleRate:self.outputSampleRate];
 	}
 
 	return audioUnit;
@@ -198,55 +551,1051 @@
 	audioUnit = newAudioUnit;
 	unitLock  = audioUnit.unitLock;
 
-	audioUnit.sampleRate = self.sampleRate;
+	[self updateRenderCallbackLocking];
+
+	audioUnit.sampleRate = self.outputSampleRate;
 	audioUnit.delegate   = self;
 }
 
-- (void)audioOutputUnitRender:(BKCAudioUnit *)unit outFrames:(SInt16 *)outBuffer numberFrames:(UInt32)inNumberFrames
+#endif
+
+- (BKCCommandQueue *)commandQueue
 {
-	BKInt numFrames = [self generateFrames:outBuffer numberFrames:inNumberFrames];
+	return commandQueue;
+}
 
-	// less frames generated; there may be no tracks attached
-	if (numFrames < inNumberFrames) {
-		memset (outBuffer, 0, (inNumberFrames - numFrames) * renderCtx.numChannels * sizeof (SInt16));
+- (void)setCommandQueue:(BKCCommandQueue *)newCommandQueue
+{
+	BKCCommandQueue * oldCommandQueue = commandQueue;
+
+	[self lock];
+
+	// apply remaining changes of previous queue
+	[oldCommandQueue drain];
+	commandQueue = newCommandQueue;
+	[self updateRenderCallbackLocking];
+
+	[self unlock];
+
+	__weak BKCContext * weakSelf = self;
+
+	oldCommandQueue.pushHandler = nil;
+	newCommandQueue.pushHandler = ^{
+		[weakSelf noteActivity];
+	};
+
+	[oldCommandQueue collect];
+}
+
+/**
+ * Convert interleaved frames into output buffers at `offset`
+ */
+static void convertFrames (void * const * outBuffers, UInt32 offset, SInt16 const * restrict frames, UInt32 numFrames, UInt32 numChannels, BKCSampleFormat sampleFormat, BOOL interleaved)
+{
+	if (sampleFormat == BKCSampleFormatFloat32) {
+		if (interleaved) {
+			BKCOutputInt16ToFloat ((float *) outBuffers [0] + offset * numChannels, frames, numFrames * numChannels);
+		}
+		else {
+			BKCOutputDeinterleaveFloat ((float * const *) outBuffers, offset, frames, numFrames, numChannels);
+		}
+	}
+	else {
+		if (interleaved) {
+			memcpy ((SInt16 *) outBuffers [0] + offset * numChannels, frames, numFrames * numChannels * sizeof (SInt16));
+		}
+		else {
+			BKCOutputDeinterleaveInt16 ((SInt16 * const *) outBuffers, offset, frames, numFrames, numChannels);
+		}
 	}
 }
 
-- (BKInt)generateFrames:(SInt16 *)outBuffer numberFrames:(UInt32)inNumberFrames
+/**
+ * Fill output buffers with silence from `offset`
+ */
+static void clearFrames (void * const * outBuffers, UInt32 offset, UInt32 numFrames, UInt32 numChannels, BKCSampleFormat sampleFormat, BOOL interleaved)
 {
-	return BKContextGenerate (& renderCtx, outBuffer, inNumberFrames);
+	size_t sampleSize = sampleFormat == BKCSampleFormatFloat32 ? sizeof (float) : sizeof (SInt16);
+
+	if (interleaved) {
+		memset ((char *) outBuffers [0] + offset * numChannels * sampleSize, 0, numFrames * numChannels * sampleSize);
+	}
+	else {
+		for (UInt32 c = 0; c < numChannels; c ++) {
+			memset ((char *) outBuffers [c] + offset * sampleSize, 0, numFrames * sampleSize);
+		}
+	}
 }
 
-- (BOOL)addTracksFromCompiler:(BKCCompiler *)compiler
+- (BKInt)generateFrames:(void * const *)outBuffers numberFrames:(UInt32)inNumberFrames sampleFormat:(BKCSampleFormat)sampleFormat interleaved:(BOOL)interleaved
 {
-	BKInt res;
-	BKTKTrack * parserTrack;
-	BKCTrack * track;
+	BKInt  numFrames;
+	UInt32 offset = 0;
+	UInt32 numChannels = renderCtx.numChannels;
 
-	if ((res = BKTKContextAttach (& parserCtx, & renderCtx)) != 0) {
-		return NO;
+	// no conversion needed
+	if (sampleFormat == BKCSampleFormatInt16 && interleaved) {
+		numFrames = [self pullOutputFrames:outBuffers [0] numberFrames:inNumberFrames];
+
+		if (numFrames >= 0 && numFrames < inNumberFrames) {
+			clearFrames (outBuffers, numFrames, inNumberFrames - numFrames, numChannels, sampleFormat, interleaved);
+			BKCRenderCountersAddZeroFilledFrames (& renderCounters, inNumberFrames - numFrames);
+		}
+
+		return numFrames;
 	}
 
-	for (BKUSize i = 0; i < parserCtx.tracks.len; i ++) {
-		parserTrack = *(BKTKTrack **) BKArrayItemAt (&parserCtx.tracks, i);
+	while (offset < inNumberFrames) {
+		UInt32 size = MIN (inNumberFrames - offset, OUTPUT_BUFFER_SIZE);
 
-		if (parserTrack) {
-			track = [[BKCTrack alloc] init];
-			track.track = &parserTrack -> renderTrack;
-			[tracks addObject:track];
-			[track attachToContext:self];
+		numFrames = [self pullOutputFrames:outputBuffer numberFrames:size];
+
+		if (numFrames < 0) {
+			return numFrames;
+		}
+
+		convertFrames (outBuffers, offset, outputBuffer, numFrames, numChannels, sampleFormat, interleaved);
+		offset += numFrames;
+
+		// less frames generated; there may be no tracks attached
+		if (numFrames < size) {
+			break;
+		}
+	}
+
+	if (offset < inNumberFrames) {
+		clearFrames (outBuffers, offset, inNumberFrames - offset, numChannels, sampleFormat, interleaved);
+		BKCRenderCountersAddZeroFilledFrames (& renderCounters, inNumberFrames - offset);
+	}
+
+	return offset;
+}
+
+/**
+ * Check if all samples are 0
+ */
+static BOOL framesAreSilent (SInt16 const * frames, NSUInteger numSamples)
+{
+	for (NSUInteger i = 0; i < numSamples; i ++) {
+		if (frames [i]) {
+			return NO;
 		}
 	}
 
 	return YES;
 }
 
-@end
+- (UInt64)renderFrameTime
+{
+	BKTime time;
+
+	BKGetPtr (& renderCtx, BK_TIME, & time, sizeof (time));
+
+	return BKTimeGetTime (time) + frameTimeOffset;
+}
+
+- (BKTime)nextRenderStepTime:(BKTime)endTime
+{
+	BKTime time;
+	BKTime tickTime = renderCtx.masterClock.nextTime;
+
+	BKGetPtr (& renderCtx, BK_TIME, & time, sizeof (time));
+
+	// clock hasn't started yet; steps have to advance
+	if (!BKTimeIsGreater (tickTime, time)) {
+		tickTime = BKTimeAdd (time, renderCtx.masterClock.period);
+	}
+
+	return BKTimeIsLess (tickTime, endTime) ? tickTime : endTime;
+}
+
+/**
+ * Check if frames can be filled with silence without synthesis
+ *
+ * Is called on the render thread after draining commands
+ */
+- (BOOL)canSkipFrames:(UInt32)numFrames numberOfCommands:(NSUInteger)numCommands
+{
+	NSUInteger activity = atomic_load_explicit (& activityCount, memory_order_relaxed);
+	UInt64 idleFrames = (UInt64) (idleContextTimeout * renderCtx.sampleRate);
+	BOOL changed = numCommands > 0 || activity != lastActivityCount;
+
+	lastActivityCount = activity;
+
+	if (changed || idleFrames == 0 || stemSession) {
+		return NO;
+	}
+
+	if (atomic_load_explicit (& silentFrames, memory_order_relaxed) < idleFrames) {
+		return NO;
+	}
+
+	// dividers may change tracks at any time
+	if (atomic_load_explicit (& clockUserCount, memory_order_relaxed) > 0) {
+		return NO;
+	}
+
+	return [eventScheduler nextEventTime] >= [self renderFrameTime] + numFrames;
+}
+
+/**
+ * Count silent frames and request suspending the audio unit
+ */
+- (void)updateSilentFrames:(SInt16 const *)frames numberFrames:(UInt32)numFrames requestedFrames:(UInt32)inNumberFrames
+{
+	UInt64 silent = atomic_load_explicit (& silentFrames, memory_order_relaxed);
+	UInt64 suspendFrames = (UInt64) (autoSuspendTimeout * renderCtx.sampleRate);
+
+	// missing frames are filled with silence
+	silent = framesAreSilent (frames, numFrames * renderCtx.numChannels) ? silent + inNumberFrames : 0;
+	atomic_store_explicit (& silentFrames, silent, memory_order_relaxed);
+
+	if (suspendFrames && silent >= suspendFrames) {
+		if (!suspendRequested) {
+			suspendRequested = YES;
+			dispatch_source_merge_data (suspendSource, 1);
+		}
+	}
+	else {
+		suspendRequested = NO;
+	}
+}
+
+- (BKInt)generateFrames:(SInt16 *)outBuffer numberFrames:(UInt32)inNumberFrames
+{
+	BKInt  res;
+	UInt32 size;
+	UInt64 frameTime, nextTime;
+	UInt32 numFrames = 0;
+	NSUInteger numCommands;
+
+	BKC_REALTIME_SECTION_BEGIN ();
+
+	numCommands = [commandQueue drain];
+	[eventScheduler collectEvents];
+
+	// context is silent and nothing has changed
+	if ([self canSkipFrames:inNumberFrames numberOfCommands:numCommands]) {
+		memset (outBuffer, 0, inNumberFrames * renderCtx.numChannels * sizeof (SInt16));
+		frameTimeOffset += inNumberFrames;
+		numFrames = inNumberFrames;
+	}
+
+	// split frames at event times
+	while (numFrames < inNumberFrames) {
+		frameTime = [self renderFrameTime];
+
+		[eventScheduler executeEventsUntilTime:frameTime];
+		nextTime = [eventScheduler nextEventTime];
+
+		size = (UInt32) MIN (inNumberFrames - numFrames, nextTime - frameTime);
+
+		if (synthesisSession) {
+			res = [self generateSynthesisFrames:& outBuffer [numFrames * renderCtx.numChannels] numberFrames:size];
+		}
+		else {
+			res = BKContextGenerate (& renderCtx, & outBuffer [numFrames * renderCtx.numChannels], size);
+		}
+
+		if (res < 0) {
+			BKC_REALTIME_SECTION_END ();
+			return res;
+		}
+
+		numFrames += res;
+
+		// less frames generated; there may be no tracks attached
+		if (res < size) {
+			break;
+		}
+	}
+
+	[eventScheduler publishFrameTime:[self renderFrameTime]];
+	[self updateSilentFrames:outBuffer numberFrames:numFrames requestedFrames:inNumberFrames];
+
+	BKCRenderCountersAddFrames (& renderCounters, inNumberFrames, numFrames);
+
+	BKC_REALTIME_SECTION_END ();
+
+	return numFrames;
+}
+
+- (BKInt)generateOutputFrames:(SInt16 *)outBuffer numberFrames:(UInt32)inNumberFrames
+{
+	BKInt  res;
+	UInt32 size, inputSize;
+	UInt32 offset = 0;
+	UInt32 numChannels = renderCtx.numChannels;
+
+	if (resampler == nil) {
+		return [self generateFrames:outBuffer numberFrames:inNumberFrames];
+	}
+
+	while (offset < inNumberFrames) {
+		size      = MIN (inNumberFrames - offset, OUTPUT_BUFFER_SIZE);
+		inputSize = (UInt32) [resampler numberOfInputFramesForOutputFrames:size];
+		res       = [self generateFrames:resampleBuffer numberFrames:inputSize];
+
+		if (res < 0) {
+			return res;
+		}
+
+		// less frames generated; there may be no tracks attached
+		if (res < inputSize) {
+			memset (& resampleBuffer [res * numChannels], 0, (inputSize - res) * numChannels * sizeof (SInt16));
+		}
+
+		offset += [resampler resampleFrames:resampleBuffer numberFrames:inputSize outFrames:& outBuffer [offset * numChannels] numberFrames:size];
+	}
+
+	return offset;
+}
+
+- (BKInt)generateLookaheadFrames:(SInt16 *)outBuffer numberFrames:(UInt32)inNumberFrames
+{
+	BKInt res;
+	BOOL locks = (commandQueue == nil);
+
+	if (locks) {
+		[unitLock lock];
+	}
+
+	res = [self generateOutputFrames:outBuffer numberFrames:inNumberFrames];
+
+	if (res >= 0 && res < inNumberFrames) {
+		memset (& outBuffer [res * renderCtx.numChannels], 0, (inNumberFrames - res) * renderCtx.numChannels * sizeof (SInt16));
+		res = inNumberFrames;
+	}
+
+	if (locks) {
+		[unitLock unlock];
+	}
+
+	return res;
+}
+
+/**
+ * Copy frames generated ahead or generate them now
+ */
+- (BKInt)pullOutputFrames:(SInt16 *)outBuffer numberFrames:(UInt32)inNumberFrames
+{
+	BKCRenderPipeline * pipeline = renderPipeline;
+
+	if (pipeline) {
+		[pipeline readFrames:outBuffer numberFrames:inNumberFrames];
+
+		// missing frames are filled with silence
+		return inNumberFrames;
+	}
+
+	return [self generateOutputFrames:outBuffer numberFrames:inNumberFrames];
+}
+
+- (UInt64)frameTime
+{
+	return eventScheduler.frameTime;
+}
+
+- (BOOL)setAttribute:(BKCAttr)attribute value:(BKInt)value atTime:(UInt64)time
+{
+	BKCCommand command;
+
+	BKCCommandInit (& command, BKCCommandTypeSetAttribute, & renderCtx, attribute);
+	command.value = value;
+
+	return [self scheduleCommand:& command atTime:time retainingObject:nil];
+}
+
+- (BOOL)scheduleCommand:(BKCCommand *)command atTime:(UInt64)time retainingObject:(id)object
+{
+	[self noteActivity];
+
+	command -> time = time;
+
+	if (![eventScheduler scheduleCommand:command retainingObject:object]) {
+		NSLog (@"*** Event scheduler is full");
+		return NO;
+	}
+
+	return YES;
+}
+
+- (BKCRenderCounters *)renderCounters
+{
+	return & renderCounters;
+}
+
+- (BKCRenderThreadStatistics)renderThreadStatistics
+{
+	BKCRenderThreadStatistics statistics;
+
+	memset (& statistics, 0, sizeof (statistics));
+	BKCRenderCountersGetStatistics (& renderCounters, & statistics);
+
+#if BKC_AUDIO_UNIT
+	if (audioUnit) {
+		BKCRenderCountersGetStatistics (audioUnit.renderCounters, & statistics);
+	}
+#endif
+
+	return statistics;
+}
+
+- (void)resetRenderThreadStatistics
+{
+	BKCRenderCountersReset (& renderCounters);
+#if BKC_AUDIO_UNIT
+	[audioUnit resetRenderThreadStatistics];
+#endif
+}
+
+- (BKCRenderStatistics)lastRenderStatistics
+{
+	return renderStatistics;
+}
+
+/**
+ * Get buffer for offline rendering
+ *
+ * The buffer has space for 2 chunks; the second one is used for silence.
+ */
+- (SInt16 *)renderBufferWithNumberFrames:(UInt32)numberFrames
+{
+	NSUInteger size = 2 * numberFrames * renderCtx.numChannels * sizeof (SInt16);
+
+	if (renderBuffer == nil) {
+		renderBuffer = [[NSMutableData alloc] initWithLength:size];
+	}
+	else if (renderBuffer.length < size) {
+		renderBuffer.length = size;
+	}
+
+	return renderBuffer.mutableBytes;
+}
+
+/**
+ * Check if all program tracks have stopped or repeated
+ *
+ * Is YES without a program, so silence always ends rendering
+ */
+- (BOOL)programHasEnded
+{
+	for (BKUSize i = 0; i < parserCtx.tracks.len; i ++) {
+		BKTKTrack * parserTrack = *(BKTKTrack **) BKArrayItemAt (& parserCtx.tracks, i);
+
+		if (!(parserTrack -> interpreter.object.flags & (BKTKInterpreterFlagHasStopped | BKTKInterpreterFlagHasRepeated))) {
+			return NO;
+		}
+	}
+
+	return YES;
+}
+
+/**
+ * Pass pending silent frames to `handler`
+ *
+ * Returns NO if the handler stopped rendering
+ */
+- (BOOL)flushSilence:(SInt16 *)silence pendingFrames:(UInt64 *)pendingFrames chunkSize:(UInt32)chunkSize handler:(BKCRenderChunkHandler)handler
+{
+	if (*pendingFrames) {
+		memset (silence, 0, MIN (*pendingFrames, chunkSize) * renderCtx.numChannels * sizeof (SInt16));
+	}
+
+	while (*pendingFrames) {
+		UInt32 silenceSize = (UInt32) MIN (*pendingFrames, chunkSize);
+
+		*pendingFrames -= silenceSize;
+		renderStatistics.numberOfFrames += silenceSize;
+
+		if (handler (silence, silenceSize) == NO) {
+			*pendingFrames = 0;
+			return NO;
+		}
+	}
+
+	return YES;
+}
+
+- (BOOL)renderWithChunkHandler:(BKCRenderChunkHandler)handler duration:(NSTimeInterval)duration
+{
+	BKInt    numFrames;
+	UInt32   chunkSize, numChannels;
+	UInt64   maxFrames, silenceFrames, pendingFrames = 0;
+	SInt16 * frames, * silence;
+	NSTimeInterval startTime;
+
+	memset (& renderStatistics, 0, sizeof (renderStatistics));
+
+	numChannels   = renderCtx.numChannels;
+	chunkSize     = MAX (renderChunkSize, 1);
+	maxFrames     = duration > 0 ? (UInt64) (duration * renderCtx.sampleRate) : UINT64_MAX;
+	silenceFrames = (UInt64) (renderSilenceTimeout * renderCtx.sampleRate);
+
+	if (maxFrames == UINT64_MAX && silenceFrames == 0) {
+		NSLog (@"*** Rendering needs a duration or a silence timeout");
+		return NO;
+	}
+
+	frames = [self renderBufferWithNumberFrames:chunkSize];
+
+	if (frames == NULL) {
+		NSLog (@"*** Couldn't allocate render buffer");
+		return NO;
+	}
+
+	silence   = & frames [chunkSize * numChannels];
+	startTime = [NSProcessInfo processInfo].systemUptime;
+
+	while (renderStatistics.numberOfFrames + pendingFrames < maxFrames) {
+		UInt32 size = (UInt32) MIN (chunkSize, maxFrames - renderStatistics.numberOfFrames - pendingFrames);
+
+		numFrames = [self generateFrames:frames numberFrames:size];
+
+		if (numFrames < 0) {
+			NSLog (@"*** Couldn't generate frames: %d", numFrames);
+			return NO;
+		}
+
+		// less frames generated; there may be no tracks attached
+		if (numFrames < size) {
+			memset (& frames [numFrames * numChannels], 0, (size - numFrames) * numChannels * sizeof (SInt16));
+		}
+
+		if (silenceFrames) {
+			if (framesAreSilent (frames, size * numChannels)) {
+				pendingFrames += size;
+
+				if (pendingFrames < silenceFrames) {
+					continue;
+				}
+
+				if ([self programHasEnded]) {
+					renderStatistics.stoppedOnSilence = YES;
+					break;
+				}
+
+				// quiet passage while the song is still playing
+				if (![self flushSilence:silence pendingFrames:& pendingFrames chunkSize:chunkSize handler:handler]) {
+					goto done;
+				}
+
+				continue;
+			}
+
+			// silence was not trailing
+			if (![self flushSilence:silence pendingFrames:& pendingFrames chunkSize:chunkSize handler:handler]) {
+				goto done;
+			}
+		}
+
+		renderStatistics.numberOfFrames += size;
+
+		if (handler (frames, size) == NO) {
+			goto done;
+		}
+	}
+
+	// duration was reached during silence
+	if (!renderStatistics.stoppedOnSilence) {
+		[self flushSilence:silence pendingFrames:& pendingFrames chunkSize:chunkSize handler:handler];
+	}
+
+done:
+	renderStatistics.renderTime = [NSProcessInfo processInfo].systemUptime - startTime;
+
+	if (renderStatistics.renderTime > 0) {
+		renderStatistics.framesPerSecond = renderStatistics.numberOfFrames / renderStatistics.renderTime;
+	}
+
+	return YES;
+}
+
+- (BOOL)renderToURL:(NSURL *)url duration:(NSTimeInterval)duration format:(BKCRenderFormat)format error:(NSError **)error
+{
+	BKInt res = 0;
+	BOOL success;
+	FILE * file;
+	__block BOOL writeFailed = NO;
+	__block BKWaveFileWriter writer;
+	UInt32 numChannels = renderCtx.numChannels;
+
+	file = fopen (url.fileSystemRepresentation, "wb");
+
+	if (file == NULL) {
+		if (error) {
+			*error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{
+				NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Failed to open file: %@", url.path]
+			}];
+		}
+
+		return NO;
+	}
+
+	if (format == BKCRenderFormatWAVE) {
+		res = BKWaveFileWriterInit (& writer, file, numChannels, renderCtx.sampleRate, 16);
+
+		if (res < 0) {
+			fclose (file);
+
+			if (error) {
+				*error = [NSError errorWithDomain:NSPOSIXErrorDomain code:res userInfo:@{
+					NSLocalizedDescriptionKey: @"Failed to initialize WAVE writer"
+				}];
+			}
+
+			return NO;
+		}
+	}
+
+	success = [self renderWithChunkHandler:^BOOL (SInt16 const * frames, UInt32 numberFrames) {
+		if (format == BKCRenderFormatWAVE) {
+			writeFailed = BKWaveFileWriterAppendFrames (& writer, (BKFrame *) frames, numberFrames) < 0;
+		}
+		else {
+			writeFailed = fwrite (frames, sizeof (SInt16) * numChannels, numberFrames, file) != numberFrames;
+		}
+
+		return !writeFailed;
+	} duration:duration];
+
+	if (writeFailed) {
+		success = NO;
+	}
+
+	if (format == BKCRenderFormatWAVE) {
+		if (BKWaveFileWriterTerminate (& writer) < 0) {
+			success = NO;
+		}
+
+		BKDispose (& writer);
+	}
+
+	if (ferror (file)) {
+		success = NO;
+	}
+
+	if (fclose (file) != 0) {
+		success = NO;
+	}
+
+	if (success == NO && error) {
+		*error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{
+			NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Failed to render to file: %@", url.path]
+		}];
+	}
+
+	return success;
+}
+
+- (BKCLoadStatistics)lastAttachStatistics
+{
+	return attachStatistics;
+}
+
+/**
+ * Reset statistics at the start of attaching a program
+ */
+- (void)beginAttachStatistics
+{
+	memset (& attachStatistics, 0, sizeof (attachStatistics));
+	attachStartTime   = BKCRenderClockNow ();
+	attachStartMemory = BKCLoadMemoryInUse ();
+
+	if (attachStartMemory == NSNotFound) {
+		attachStatistics.memoryGrowth = NSNotFound;
+	}
+}
+
+/**
+ * Record memory growth at a phase boundary
+ */
+- (void)sampleAttachMemory
+{
+	NSUInteger memory = BKCLoadMemoryInUse ();
+
+	if (memory > attachStartMemory) {
+		attachStatistics.memoryGrowth = MAX (attachStatistics.memoryGrowth, memory - attachStartMemory);
+	}
+}
+
+/**
+ * Set total time at the end of attaching a program
+ */
+- (void)endAttachStatistics
+{
+	attachStatistics.totalTime = (BKCRenderClockNow () - attachStartTime) * 1e-9;
+	[self sampleAttachMemory];
+}
+
+- (BOOL)addTracksFromCompiler:(BKCCompiler *)compiler
+{
+	BKInt res;
+	BOOL success;
+	UInt64 startTime;
+	BKCParserGeneration * generation;
+
+	// checkpoints refer to the previous tracks
+	[self disableCheckpoints];
+
+	[self beginAttachStatistics];
+	startTime = BKCRenderClockNow ();
+
+	// tracks refer to the compiler's data which is not copied
+	res = BKTKContextCreate (& parserCtx, compiler.compiler);
+
+	attachStatistics.instantiateTime = (BKCRenderClockNow () - startTime) * 1e-9;
+	[self sampleAttachMemory];
+
+	if (res != 0) {
+		NSLog (@"*** Couldn't instantiate compiler: %d", res);
+		[self endAttachStatistics];
+		return NO;
+	}
+
+	program = nil;
+
+	generation = [[BKCParserGeneration alloc] init];
+	generation -> parserCtx = & parserCtx;
+	generation -> compiler  = compiler;
+	parserGenerations = [[NSMutableArray alloc] initWithObjects:generation, nil];
+
+	success = [self addParserTracks];
+	[self endAttachStatistics];
+
+	return success;
+}
+
+- (BOOL)addTracksFromProgram:(BKCProgram *)newProgram
+{
+	BOOL success;
+	UInt64 startTime;
+	BKCProgram * instance;
+	BKCParserGeneration * generation;
+
+	// checkpoints refer to the previous tracks
+	[self disableCheckpoints];
+
+	[self beginAttachStatistics];
+	startTime = BKCRenderClockNow ();
+
+	// shares the compiled data
+	instance = [newProgram instantiateParserContext:& parserCtx];
+
+	attachStatistics.instantiateTime = (BKCRenderClockNow () - startTime) * 1e-9;
+	[self sampleAttachMemory];
+
+	if (instance == nil) {
+		[self endAttachStatistics];
+		return NO;
+	}
+
+	program = newProgram;
+
+	// keep compiled data alive
+	generation = [[BKCParserGeneration alloc] init];
+	generation -> parserCtx = & parserCtx;
+	generation -> program   = instance;
+	parserGenerations = [[NSMutableArray alloc] initWithObjects:generation, nil];
+
+	success = [self addParserTracks];
+	[self endAttachStatistics];
+
+	return success;
+}
+
+/**
+ * Push swap of tracks as a single batch
+ *
+ * Attaches the changed tracks of `newTracks` and detaches the tracks they
+ * replace. Tracks which are not changed are never attached.
+ */
+- (BOOL)pushSwapOfTracks:(NSArray *)newTracks changedTrackIndexes:(NSIndexSet *)indexes retaining:(NSArray *)retiredGenerations
+{
+	NSUInteger count = 0;
+	NSMutableData * data = [[NSMutableData alloc] initWithLength:newTracks.count * 4 * sizeof (BKCCommand)];
+	BKCCommand * commands = data.mutableBytes;
+
+	for (NSUInteger i = 0; i < newTracks.count; i ++) {
+		BKTKTrack * newTrack = [newTracks [i] pointerValue];
+		BKCTrack * track = programTracks [i];
+		BKTKTrack * oldTrack = parserTrackOfTrack (track.track);
+
+		if (indexes && [indexes containsIndex:i] == NO) {
+			continue;
+		}
+
+		BKCCommandInit (& commands [count ++], BKCCommandTypeDetachTrack, & oldTrack -> renderTrack, 0);
+		BKCCommandInit (& commands [count ++], BKCCommandTypeDetachDivider, & oldTrack -> divider, 0);
+
+		BKCCommandInit (& commands [count], BKCCommandTypeAttachTrack, & newTrack -> renderTrack, 0);
+		commands [count ++].pointer = & renderCtx;
+
+		BKCCommandInit (& commands [count], BKCCommandTypeAttachDivider, & newTrack -> divider, 0);
+		commands [count].pointer = & renderCtx;
+		commands [count ++].value = BK_CLOCK_TYPE_BEAT;
+	}
+
+	// previous tracks may be used until the batch is executed
+	if ([commandQueue pushCommands:commands count:count completion:^{
+		(void) retiredGenerations;
+	}] == NO) {
+		NSLog (@"*** Changed tracks don't fit into the command queue");
+		return NO;
+	}
+
+	return YES;
+}
+
+- (BOOL)updateTracksFromProgram:(BKCProgram *)newProgram changedTrackIndexes:(NSIndexSet *)indexes
+{
+	BKInt res;
+	BKTKTrack * parserTrack;
+	UInt64 startTime;
+	BKCParserGeneration * generation;
+	NSMutableArray * newTracks = [[NSMutableArray alloc] init];
+	NSMutableArray * nextTracks = [[NSMutableArray alloc] init];
+	NSMutableArray * retiredGenerations = [[NSMutableArray alloc] init];
+
+	if (program == nil) {
+		return [self addTracksFromProgram:newProgram];
+	}
+
+	// checkpoints refer to the tracks which are replaced
+	[self disableCheckpoints];
+	[self beginAttachStatistics];
+
+	generation = [[BKCParserGeneration alloc] init];
+	generation -> parserCtx = malloc (sizeof (BKTKContext));
+
+	if (generation -> parserCtx == NULL || BKTKContextInit (generation -> parserCtx, 0) != 0) {
+		NSLog (@"*** Couldn't initialize BKTKContext");
+		free (generation -> parserCtx);
+		[self endAttachStatistics];
+		return NO;
+	}
+
+	generation -> ownsContext = YES;
+
+	startTime = BKCRenderClockNow ();
+	generation -> program = [newProgram instantiateParserContext:generation -> parserCtx];
+	attachStatistics.instantiateTime = (BKCRenderClockNow () - startTime) * 1e-9;
+	[self sampleAttachMemory];
+
+	if (generation -> program == nil) {
+		[self endAttachStatistics];
+		return NO;
+	}
+
+	for (BKUSize i = 0; i < generation -> parserCtx -> tracks.len; i ++) {
+		parserTrack = *(BKTKTrack **) BKArrayItemAt (&generation -> parserCtx -> tracks, i);
+
+		if (parserTrack) {
+			[newTracks addObject:[NSValue valueWithPointer:parserTrack]];
+		}
+	}
+
+	if (newTracks.count != programTracks.count) {
+		NSLog (@"*** Number of tracks has changed; use reset and addTracksFromProgram:");
+		[self endAttachStatistics];
+		return NO;
+	}
+
+	// tracks of each generation after swapping
+	for (NSUInteger i = 0; i < newTracks.count; i ++) {
+		BKTKTrack * newTrack = [newTracks [i] pointerValue];
+		BKCTrack * track = programTracks [i];
+
+		// other tracks keep playing from the previous program
+		if (indexes == nil || [indexes containsIndex:i]) {
+			[nextTracks addObject:[NSValue valueWithPointer:& newTrack -> renderTrack]];
+		}
+		else {
+			[nextTracks addObject:[NSValue valueWithPointer:track.track]];
+		}
+	}
+
+	// generations which have no playing tracks anymore
+	for (BKCParserGeneration * oldGeneration in parserGenerations) {
+		BOOL used = NO;
+
+		for (NSValue * value in nextTracks) {
+			if ((used = [oldGeneration containsTrack:value.pointerValue])) {
+				break;
+			}
+		}
+
+		if (!used && oldGeneration -> ownsContext) {
+			[retiredGenerations addObject:oldGeneration];
+		}
+	}
+
+	startTime = BKCRenderClockNow ();
+
+	[self lock];
+
+	if (commandQueue) {
+		if ([self pushSwapOfTracks:newTracks changedTrackIndexes:indexes retaining:retiredGenerations] == NO) {
+			[self unlock];
+			[self endAttachStatistics];
+			return NO;
+		}
+	}
+	else {
+		if ((res = BKTKContextAttach (generation -> parserCtx, & renderCtx)) != 0) {
+			[self unlock];
+			[self endAttachStatistics];
+			return NO;
+		}
+
+		for (NSUInteger i = 0; i < newTracks.count; i ++) {
+			BKTKTrack * newTrack = [newTracks [i] pointerValue];
+			BKTrack * nextTrack = [nextTracks [i] pointerValue];
+			BKCTrack * track = programTracks [i];
+
+			// detach replaced track or unchanged new track
+			if (nextTrack == & newTrack -> renderTrack) {
+				parserTrack = parserTrackOfTrack (track.track);
+			}
+			else {
+				parserTrack = newTrack;
+			}
+
+			BKTrackDetach (& parserTrack -> renderTrack);
+			BKDividerDetach (& parserTrack -> divider);
+		}
+	}
+
+	attachStatistics.attachTime = (BKCRenderClockNow () - startTime) * 1e-9;
+	startTime = BKCRenderClockNow ();
+
+	for (NSUInteger i = 0; i < newTracks.count; i ++) {
+		BKCTrack * track = programTracks [i];
+		BKTrack * nextTrack = [nextTracks [i] pointerValue];
+
+		if (track.track != nextTrack) {
+			track.track = nextTrack;
+			attachStatistics.numberOfTracks ++;
+		}
+	}
+
+	[parserGenerations addObject:generation];
+	[parserGenerations removeObjectsInArray:retiredGenerations];
+	program = newProgram;
+
+	[self unlock];
+
+	attachStatistics.wrapTime = (BKCRenderClockNow () - startTime) * 1e-9;
+	[self endAttachStatistics];
+
+	return YES;
+}
+
+- (BOOL)addParserTracks
+{
+	BKInt res;
+	BKTKTrack * parserTrack;
+	BKCTrack * track;
+	UInt64 startTime = BKCRenderClockNow ();
+
+	[self lock];
+	res = BKTKContextAttach (& parserCtx, & renderCtx);
+	[self unlock];
+
+	attachStatistics.attachTime = (BKCRenderClockNow () - startTime) * 1e-9;
+
+	if (res != 0) {
+		return NO;
+	}
+
+	startTime = BKCRenderClockNow ();
+
+	// lock once for all tracks
+	[self lock];
+
+	for (BKUSize i = 0; i < parserCtx.tracks.len; i ++) {
+		parserTrack = *(BKTKTrack **) BKArrayItemAt (&parserCtx.tracks, i);
+
+		if (parserTrack) {
+			track = [[BKCTrack alloc] init];
+			track.track = &parserTrack -> renderTrack;
+			[programTracks addObject:track];
+
+			// already attached by the parser context
+			[self attachTrack:track];
+			attachStatistics.numberOfTracks ++;
+		}
+	}
+
+	[self unlock];
+
+	attachStatistics.wrapTime = (BKCRenderClockNow () - startTime) * 1e-9;
+	[self updateClockUserCount];
+
+	return YES;
+}
+
+- (void)updateClockUserCount
+{
+	atomic_store_explicit (& clockUserCount, dividers.count + programTracks.count, memory_order_relaxed);
+}
+
+- (void)moveTracks:(NSArray *)groupTracks toContext:(BKContext *)ctx
+{
+	for (BKCTrack * track in groupTracks) {
+		BKDivider * divider = [self parserDividerOfTrack:track];
+
+		BKTrackAttach (track.track, ctx);
+
+		if (divider) {
+			BKDividerDetach (divider);
+			BKContextAttachDivider (ctx, divider, BK_CLOCK_TYPE_BEAT);
+		}
+	}
+}
+
+- (BKDivider *)parserDividerOfTrack:(BKCTrack *)track
+{
+	if ([programTracks indexOfObjectIdenticalTo:track] == NSNotFound) {
+		return NULL;
+	}
+
+	return & parserTrackOfTrack (track.track) -> divider;
+}
+
+@end
+
+#if BKC_AUDIO_UNIT
+
+@implementation BKCContext (AudioUnit)
+
+- (void)audioOutputUnitRender:(BKCAudioUnit *)unit outFrames:(SInt16 *)outBuffer numberFrames:(UInt32)inNumberFrames
+{
+	BKInt numFrames = [self pullOutputFrames:outBuffer numberFrames:inNumberFrames];
+
+	numFrames = MAX (numFrames, 0);
+
+	// less frames generated; there may be no tracks attached
+	if (numFrames < inNumberFrames) {
+		memset (& outBuffer [numFrames * renderCtx.numChannels], 0, (inNumberFrames - numFrames) * renderCtx.numChannels * sizeof (SInt16));
+		BKCRenderCountersAddZeroFilledFrames (& renderCounters, inNumberFrames - numFrames);
+	}
+}
+
+- (void)audioOutputUnitRender:(BKCAudioUnit *)unit outBuffers:(void * const *)outBuffers numberFrames:(UInt32)inNumberFrames
+{
+	[self generateFrames:outBuffers numberFrames:inNumberFrames sampleFormat:unit.sampleFormat interleaved:unit.interleaved];
+}
+
+@end
+
+#endif
 
 @implementation BKCContext (Lock)
 
 - (void)lock
 {
+	[self noteActivity];
 	[unitLock lock];
 }
 
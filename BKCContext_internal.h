@@ -0,0 +1,134 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import "BKCContext.h"
+
+@class BKCTrack;
+
+@interface BKCContext ()
+
+/**
+ * Buffer used by offline rendering
+ *
+ * Can be shared by contexts which don't render at the same time
+ */
+@property (readwrite, nonatomic) NSMutableData * renderBuffer;
+
+/**
+ * The divider which runs the program of a track
+ *
+ * Returns NULL if the track is not created by the program.
+ */
+- (BKDivider *)parserDividerOfTrack:(BKCTrack *)track;
+
+/**
+ * Move tracks and the dividers of program tracks to another BlipKit context
+ *
+ * Must be called with the lock held
+ */
+- (void)moveTracks:(NSArray *)tracks toContext:(BKContext *)ctx;
+
+/**
+ * Frame time of the render thread
+ *
+ * Is BK_TIME of the render context plus frames skipped while silent or by
+ * seeking
+ */
+- (UInt64)renderFrameTime;
+
+/**
+ * End of the next step when generating the render context up to `endTime`
+ *
+ * Is the time of the next tick of the render context's clock, but at most
+ * `endTime`. Contexts clocked in step with the render context are advanced
+ * to this time before the render context itself, so changes made by
+ * dividers and programs on this tick apply to them at the same time as to
+ * tracks of the render context.
+ */
+- (BKTime)nextRenderStepTime:(BKTime)endTime;
+
+/**
+ * Generate output frames on the producer thread of `renderPipeline`
+ *
+ * Takes the lock if no command queue is assigned
+ */
+- (BKInt)generateLookaheadFrames:(SInt16 *)outBuffer numberFrames:(UInt32)numberFrames;
+
+/**
+ * Update the number of dividers and programs which use the clock
+ */
+- (void)updateClockUserCount;
+
+@end
+
+@interface BKCContext (BKCSynthesisContexts)
+
+/**
+ * Generate frames of the render context and all synthesis partitions
+ *
+ * Is used by generateFrames:numberFrames: if tracks are partitioned
+ */
+- (BKInt)generateSynthesisFrames:(SInt16 *)outBuffer numberFrames:(UInt32)numberFrames;
+
+/**
+ * Reset the contexts of the synthesis partitions
+ */
+- (void)resetSynthesisContexts;
+
+/**
+ * The BlipKit context which synthesizes track
+ *
+ * Returns the render context if the track is not partitioned.
+ */
+- (BKContext *)synthesisContextOfTrack:(BKCTrack *)track;
+
+/**
+ * Move partitioned tracks back to the render context
+ */
+- (void)endSynthesisSession;
+
+/**
+ * Check if a render thread may generate frames without taking the lock
+ *
+ * Render state can't be reset then
+ */
+- (BOOL)rendersWithoutLock;
+
+@end
+
+@interface BKCContext (BKTrackContext)
+
+/**
+ * Add track to `tracks` and set its context
+ *
+ * Must be called with the lock held. Returns NO if the track is already
+ * attached to this context.
+ */
+- (BOOL)attachTrack:(BKCTrack *)track;
+
+/**
+ * Remove track from `tracks` and reset its context
+ */
+- (BOOL)detachTrack:(BKCTrack *)track;
+
+@end
@@ -22,12 +22,59 @@
  */
 
 #import <Foundation/Foundation.h>
+#import <stdatomic.h>
 #import "BKCContext.h"
 
+/**
+ * Number of ticks which can be pending in asynchronous mode
+ */
+#define BKC_DIVIDER_TICK_CAPACITY 64
+
+typedef NS_ENUM(NSInteger, BKCDividerMode)
+{
+	BKCDividerModeSynchronous,   // Block is called on the render thread with the lock held
+	BKCDividerModeAsynchronous,  // Block is called on `callbackQueue`
+};
+
+/**
+ * A tick passed from the render thread to `callbackQueue`
+ */
+typedef struct
+{
+	UInt64 tickCount;  // Number of ticks since the divider was created
+	UInt64 frameTime;  // Frame time of the context at the tick
+	UInt64 clockTime;  // BKCRenderClockNow at the tick
+} BKCDividerTick;
+
+/**
+ * Latencies between ticks and calls of the block in asynchronous mode
+ */
+typedef struct
+{
+	NSUInteger numberOfTicks;         // Ticks passed to the block
+	NSUInteger numberOfDroppedTicks;  // Ticks dropped because too many were pending
+	UInt64     totalLatency;          // Sum of latencies in nanoseconds
+	UInt64     maxLatency;            // Highest latency in nanoseconds
+} BKCDividerLatencyStatistics;
+
 @interface BKCDivider : NSObject
 {
-	BKDivider divider;
-	NSInteger ticks;
+	BKDivider           divider;
+	NSInteger           ticks;
+	BKContext         * renderContext;
+	UInt64 const      * frameTimeOffset;
+	atomic_long         mode;
+	dispatch_queue_t    callbackQueue;
+	dispatch_source_t   tickSource;
+	BKCDividerTick      tickRing [BKC_DIVIDER_TICK_CAPACITY];
+	atomic_ulong        tickWriteIndex;
+	atomic_ulong        tickReadIndex;
+	UInt64              tickCount;
+	BKCDividerTick      currentTick;
+	atomic_ulong        numDeliveredTicks;
+	atomic_ulong        numDroppedTicks;
+	atomic_ullong       totalLatency;
+	atomic_ullong       maxLatency;
 }
 
 /**
@@ -45,6 +92,34 @@
  */
 @property (readwrite, nonatomic) NSInteger ticks;
 
+/**
+ * Where the block is called
+ *
+ * In asynchronous mode the render thread only records the tick and the
+ * block is called on `callbackQueue` without holding the lock. Its return
+ * value is ignored. Default is BKCDividerModeSynchronous.
+ */
+@property (readwrite, nonatomic) BKCDividerMode mode;
+
+/**
+ * Queue on which the block is called in asynchronous mode
+ *
+ * Default is the main queue
+ */
+@property (readwrite, nonatomic) dispatch_queue_t callbackQueue;
+
+/**
+ * Tick which is passed to the block in asynchronous mode
+ *
+ * Is only valid while the block is called
+ */
+@property (readonly, nonatomic) BKCDividerTick currentTick;
+
+/**
+ * Latencies of asynchronous mode
+ */
+@property (readonly, nonatomic) BKCDividerLatencyStatistics latencyStatistics;
+
 /**
  * Initialize with number of ticks
  */
@@ -60,4 +135,9 @@
  */
 - (void)detach;
 
+/**
+ * Reset latency statistics
+ */
+- (void)resetLatencyStatistics;
+
 @end
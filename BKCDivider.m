@@ -22,11 +22,29 @@
  */
 
 #import "BKCDivider.h"
+#import "BKCContext_internal.h"
+
+#define DEFAULT_TICKS 24
 
 @interface BKCDivider ()
 
 @property (readwrite, weak) BKCContext * context;
 
+/**
+ * Counters of the context; is accessed on the render thread
+ */
+@property (readwrite, assign) BKCRenderCounters * renderCounters;
+
+/**
+ * Render context which is read by the render thread in asynchronous mode
+ */
+@property (readwrite, assign) BKContext * renderContext;
+
+/**
+ * Offset of the frame time of the context to BK_TIME
+ */
+@property (readwrite, assign) UInt64 const * frameTimeOffset;
+
 @end
 
 @implementation BKCContext (BKTrackContext)
@@ -37,7 +55,11 @@
 		return NO;
 
 	[dividers addObject:divider];
+	[self updateClockUserCount];
 	divider.context = self;
+	divider.renderCounters  = self.renderCounters;
+	divider.renderContext   = self.renderContext;
+	divider.frameTimeOffset = & frameTimeOffset;
 
 	return YES;
 }
@@ -51,7 +73,11 @@
 		return NO;
 	}
 
+	divider.renderCounters  = NULL;
+	divider.renderContext   = NULL;
+	divider.frameTimeOffset = NULL;
 	[dividers removeObject:divider];
+	[self updateClockUserCount];
 
 	[self unlock];
 
@@ -66,14 +92,66 @@ static IMP dividerMethod;
 
 @synthesize context = context;
 @synthesize block;
+@synthesize renderCounters;
+@synthesize renderContext;
+@synthesize frameTimeOffset;
+@synthesize currentTick;
+
+/**
+ * Record tick for the callback queue
+ *
+ * Doesn't lock or allocate. Drops the tick if the ring is full. Is only
+ * called after the asynchronous mode has been loaded, so the tick source
+ * exists.
+ */
+static void pushTick (BKCDivider * self)
+{
+	BKTime time;
+	BKCDividerTick * tick;
+	NSUInteger writeIdx = atomic_load_explicit (& self -> tickWriteIndex, memory_order_relaxed);
+	NSUInteger readIdx  = atomic_load_explicit (& self -> tickReadIndex, memory_order_acquire);
+
+	if (writeIdx - readIdx >= BKC_DIVIDER_TICK_CAPACITY) {
+		atomic_fetch_add_explicit (& self -> numDroppedTicks, 1, memory_order_relaxed);
+		return;
+	}
+
+	tick = & self -> tickRing [writeIdx & (BKC_DIVIDER_TICK_CAPACITY - 1)];
+	tick -> tickCount = self -> tickCount;
+	tick -> clockTime = BKCRenderClockNow ();
+	tick -> frameTime = 0;
+
+	if (self -> renderContext) {
+		BKGetPtr (self -> renderContext, BK_TIME, & time, sizeof (time));
+		tick -> frameTime = BKTimeGetTime (time) + (self -> frameTimeOffset ? *self -> frameTimeOffset : 0);
+	}
+
+	atomic_store_explicit (& self -> tickWriteIndex, writeIdx + 1, memory_order_release);
+	dispatch_source_merge_data (self -> tickSource, 1);
+}
 
 static BKEnum dividerFunc (BKCallbackInfo * info, void * userInfo)
 {
+	BKEnum res = 0;
 	BKCDivider * self = (__bridge BKCDivider *) userInfo;
+	BKCRenderCounters * counters = self -> renderCounters;
+	UInt64 startTime = counters ? BKCRenderClockNow () : 0;
 
 	info -> divider = (BKInt)self -> ticks;
+	self -> tickCount ++;
+
+	if (atomic_load_explicit (& self -> mode, memory_order_acquire) == BKCDividerModeAsynchronous) {
+		pushTick (self);
+	}
+	else {
+		res = ((BKEnum (*) (id, SEL, BKCallbackInfo *, void *)) dividerMethod) (self, @selector(invokeBlockWithInfo:userInfo:), info, userInfo);
+	}
 
-	return ((BKEnum (*) (id, SEL, BKCallbackInfo *, void *)) dividerMethod) (self, @selector(invokeBlockWithInfo:userInfo:), info, userInfo);
+	if (counters) {
+		BKCRenderCountersAddDivider (counters, BKCRenderClockNow () - startTime);
+	}
+
+	return res;
 }
 
 + (void)initialize
@@ -83,7 +161,7 @@ static BKEnum dividerFunc (BKCallbackInfo * info, void * userInfo)
 
 - (instancetype)init
 {
-	return [self initWithTicks:24];
+	return [self initWithTicks:DEFAULT_TICKS];
 }
 
 - (instancetype)initWithTicks:(NSInteger)theTicks
@@ -96,6 +174,16 @@ static BKEnum dividerFunc (BKCallbackInfo * info, void * userInfo)
 
 		ticks = theTicks;
 		BKDividerInit (& divider, (BKInt)ticks, & callback);
+
+		atomic_init (& mode, BKCDividerModeSynchronous);
+		atomic_init (& tickWriteIndex, 0);
+		atomic_init (& tickReadIndex, 0);
+		atomic_init (& numDeliveredTicks, 0);
+		atomic_init (& numDroppedTicks, 0);
+		atomic_init (& totalLatency, 0);
+		atomic_init (& maxLatency, 0);
+
+		callbackQueue = dispatch_get_main_queue ();
 	}
 
 	return self;
@@ -106,6 +194,10 @@ static BKEnum dividerFunc (BKCallbackInfo * info, void * userInfo)
 	[context lock];
 	BKDividerDetach (& divider);
 	[context unlock];
+
+	if (tickSource) {
+		dispatch_source_cancel (tickSource);
+	}
 }
 
 - (void)setTicks:(NSInteger)newTicks
@@ -119,9 +211,99 @@ static BKEnum dividerFunc (BKCallbackInfo * info, void * userInfo)
 	return ticks;
 }
 
+- (BKCDividerMode)mode
+{
+	return atomic_load_explicit (& mode, memory_order_relaxed);
+}
+
+- (void)setMode:(BKCDividerMode)newMode
+{
+	// source has to exist before the render thread sees the mode
+	if (newMode == BKCDividerModeAsynchronous && tickSource == nil) {
+		__weak BKCDivider * weakSelf = self;
+
+		tickSource = dispatch_source_create (DISPATCH_SOURCE_TYPE_DATA_ADD, 0, 0, callbackQueue);
+		dispatch_source_set_event_handler (tickSource, ^{
+			[weakSelf deliverTicks];
+		});
+		dispatch_resume (tickSource);
+	}
+
+	atomic_store_explicit (& mode, newMode, memory_order_release);
+}
+
+- (dispatch_queue_t)callbackQueue
+{
+	return callbackQueue;
+}
+
+- (void)setCallbackQueue:(dispatch_queue_t)newQueue
+{
+	callbackQueue = newQueue ?: dispatch_get_main_queue ();
+
+	if (tickSource) {
+		dispatch_set_target_queue (tickSource, callbackQueue);
+	}
+}
+
+- (BKCDividerLatencyStatistics)latencyStatistics
+{
+	BKCDividerLatencyStatistics statistics;
+
+	statistics.numberOfTicks        = atomic_load_explicit (& numDeliveredTicks, memory_order_relaxed);
+	statistics.numberOfDroppedTicks = atomic_load_explicit (& numDroppedTicks, memory_order_relaxed);
+	statistics.totalLatency         = atomic_load_explicit (& totalLatency, memory_order_relaxed);
+	statistics.maxLatency           = atomic_load_explicit (& maxLatency, memory_order_relaxed);
+
+	return statistics;
+}
+
+- (void)resetLatencyStatistics
+{
+	atomic_store_explicit (& numDeliveredTicks, 0, memory_order_relaxed);
+	atomic_store_explicit (& numDroppedTicks, 0, memory_order_relaxed);
+	atomic_store_explicit (& totalLatency, 0, memory_order_relaxed);
+	atomic_store_explicit (& maxLatency, 0, memory_order_relaxed);
+}
+
+/**
+ * Call block with pending ticks
+ *
+ * Is called on `callbackQueue`
+ */
+- (void)deliverTicks
+{
+	UInt64 latency;
+	BKCallbackInfo info;
+	NSUInteger readIdx  = atomic_load_explicit (& tickReadIndex, memory_order_relaxed);
+	NSUInteger writeIdx = atomic_load_explicit (& tickWriteIndex, memory_order_acquire);
+
+	for (; readIdx != writeIdx; readIdx ++) {
+		currentTick = tickRing [readIdx & (BKC_DIVIDER_TICK_CAPACITY - 1)];
+		atomic_store_explicit (& tickReadIndex, readIdx + 1, memory_order_release);
+
+		latency = BKCRenderClockNow () - currentTick.clockTime;
+
+		atomic_fetch_add_explicit (& numDeliveredTicks, 1, memory_order_relaxed);
+		atomic_fetch_add_explicit (& totalLatency, latency, memory_order_relaxed);
+
+		if (latency > atomic_load_explicit (& maxLatency, memory_order_relaxed)) {
+			atomic_store_explicit (& maxLatency, latency, memory_order_relaxed);
+		}
+
+		memset (& info, 0, sizeof (info));
+		info.divider = (BKInt) ticks;
+
+		if (block) {
+			block (context, & info);
+		}
+	}
+}
+
 - (BOOL)attachToContext:(BKCContext *)newContext
 {
 	BKInt res;
+	BKCCommand command;
 
 	if (!newContext)
 		return NO;
@@ -131,10 +313,26 @@ static BKEnum dividerFunc (BKCallbackInfo * info, void * userInfo)
 	[newContext lock];
 
 	if (![newContext attachDivider:self]) {
-		[context unlock];
+		[newContext unlock];
 		return NO;
 	}
 
+	if (newContext.commandQueue) {
+		BKCCommandInit (& command, BKCCommandTypeAttachDivider, & divider, 0);
+		command.pointer = newContext.renderContext;
+		command.value   = BK_CLOCK_TYPE_BEAT;
+
+		res = [newContext.commandQueue pushCommand:& command] ? 0 : -1;
+
+		if (res != 0) {
+			[newContext detachDivider:self];
+		}
+
+		[newContext unlock];
+
+		return res >= 0;
+	}
+
 	res = BKContextAttachDivider (context.renderContext, & divider, BK_CLOCK_TYPE_BEAT);
 
 	if (res != 0) {
@@ -148,10 +346,24 @@ static BKEnum dividerFunc (BKCallbackInfo * info, void * userInfo)
 
 - (void)detach
 {
+	BKCCommand command;
+	BKCCommandQueue * queue = context.commandQueue;
+
 	[context lock];
 
-	if ([context detachDivider:self])
-		BKDividerDetach (& divider);
+	if ([context detachDivider:self]) {
+		if (queue) {
+			BKCCommandInit (& command, BKCCommandTypeDetachDivider, & divider, 0);
+
+			// divider may be used until command is executed
+			[queue pushCommand:& command completion:^{
+				(void) self;
+			}];
+		}
+		else {
+			BKDividerDetach (& divider);
+		}
+	}
 
 	[context unlock];
 	context = nil;
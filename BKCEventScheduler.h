@@ -0,0 +1,127 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+#import <stdatomic.h>
+#import "BKCCommandQueue.h"
+
+/**
+ * Commands which are executed at an exact frame time
+ *
+ * Commands are scheduled by other threads and collected by the render
+ * thread into a list sorted by time. The render thread splits the frames it
+ * generates at event times, so every command is applied at its exact frame.
+ * Commands scheduled for a time which has already passed are executed at
+ * the beginning of the next generated buffer. Neither side waits on a lock
+ * which is taken by the other.
+ */
+@interface BKCEventScheduler : NSObject
+{
+	BKCCommandQueue * inbox;
+	BKCCommand      * events;
+	NSUInteger        capacity;
+	NSUInteger        numEvents;
+	NSUInteger        numScheduled;
+	atomic_ullong     frameTime;
+	atomic_ulong      numCollected;
+	atomic_ulong      numLateEvents;
+	NSLock          * producerLock;
+	NSMutableArray  * retainedObjects;
+}
+
+/**
+ * Maximum number of pending events
+ */
+@property (readonly, nonatomic) NSUInteger capacity;
+
+/**
+ * Frame time of the render thread
+ *
+ * Is updated after each generated buffer
+ */
+@property (readonly, nonatomic) UInt64 frameTime;
+
+/**
+ * Number of events which were executed after their time
+ */
+@property (readonly, nonatomic) NSUInteger numberOfLateEvents;
+
+/**
+ * Initialize with capacity
+ */
+- (instancetype)initWithCapacity:(NSUInteger)capacity;
+
+/**
+ * Schedule command at `command -> time`
+ *
+ * `object` is kept alive until the command was executed. Returns NO if too
+ * many events are pending.
+ */
+- (BOOL)scheduleCommand:(BKCCommand const *)command retainingObject:(id)object;
+
+/**
+ * Keep `object` alive until all commands scheduled so far up to `time` were
+ * executed
+ *
+ * Used for objects which are referenced by commands scheduled without
+ * retaining them.
+ */
+- (void)retainObject:(id)object untilTime:(UInt64)time;
+
+/**
+ * Collect scheduled commands
+ *
+ * Must only be called from the render thread or with the render lock held
+ */
+- (void)collectEvents;
+
+/**
+ * Time of the next pending event or UINT64_MAX
+ *
+ * Must only be called from the render thread or with the render lock held
+ */
+- (UInt64)nextEventTime;
+
+/**
+ * Execute all pending events up to and including `time`
+ *
+ * Must only be called from the render thread or with the render lock held
+ */
+- (void)executeEventsUntilTime:(UInt64)time;
+
+/**
+ * Publish frame time after a buffer was generated
+ *
+ * Must only be called from the render thread or with the render lock held
+ */
+- (void)publishFrameTime:(UInt64)time;
+
+/**
+ * Remove all pending events
+ *
+ * Must only be called while the render thread isn't running or with the
+ * render lock held
+ */
+- (void)reset;
+
+@end
@@ -0,0 +1,197 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import "BKCEventScheduler.h"
+
+#define DEFAULT_CAPACITY 1024
+
+@implementation BKCEventScheduler
+
+@synthesize capacity;
+
+- (instancetype)init
+{
+	return [self initWithCapacity:DEFAULT_CAPACITY];
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)theCapacity
+{
+	if ((self = [super init])) {
+		inbox = [[BKCCommandQueue alloc] initWithCapacity:theCapacity];
+
+		if (inbox == nil) {
+			return nil;
+		}
+
+		capacity = inbox.capacity;
+		events   = malloc (capacity * sizeof (BKCCommand));
+
+		if (events == NULL) {
+			NSLog (@"*** Couldn't allocate event list");
+			return nil;
+		}
+
+		atomic_init (& frameTime, 0);
+		atomic_init (& numCollected, 0);
+		atomic_init (& numLateEvents, 0);
+
+		producerLock    = [[NSLock alloc] init];
+		retainedObjects = [[NSMutableArray alloc] init];
+	}
+
+	return self;
+}
+
+- (void)dealloc
+{
+	if (events) {
+		free (events);
+	}
+}
+
+- (UInt64)frameTime
+{
+	return atomic_load_explicit (& frameTime, memory_order_acquire);
+}
+
+- (NSUInteger)numberOfLateEvents
+{
+	return atomic_load_explicit (& numLateEvents, memory_order_relaxed);
+}
+
+/**
+ * Release objects of executed events
+ *
+ * An event was executed if it was collected by a buffer which has ended
+ * after its time. Events collected before `numCollected` was published are
+ * executed before the render thread publishes a later `frameTime`.
+ */
+- (void)releaseExecutedObjects
+{
+	UInt64 time = atomic_load_explicit (& frameTime, memory_order_acquire);
+	NSUInteger collected = atomic_load_explicit (& numCollected, memory_order_acquire);
+
+	for (NSInteger i = retainedObjects.count - 1; i >= 0; i --) {
+		NSArray * item = retainedObjects [i];
+
+		if ([item [0] unsignedLongLongValue] < time && [item [1] unsignedIntegerValue] < collected) {
+			[retainedObjects removeObjectAtIndex:i];
+		}
+	}
+}
+
+- (BOOL)scheduleCommand:(BKCCommand const *)command retainingObject:(id)object
+{
+	BOOL success;
+
+	[producerLock lock];
+
+	[self releaseExecutedObjects];
+
+	if ((success = [inbox pushCommand:command])) {
+		if (object) {
+			[retainedObjects addObject:@[@(command -> time), @(numScheduled), object]];
+		}
+
+		numScheduled ++;
+	}
+
+	[producerLock unlock];
+
+	return success;
+}
+
+- (void)retainObject:(id)object untilTime:(UInt64)time
+{
+	[producerLock lock];
+
+	[self releaseExecutedObjects];
+
+	// wait for the last command scheduled so far
+	if (numScheduled) {
+		[retainedObjects addObject:@[@(time), @(numScheduled - 1), object]];
+	}
+
+	[producerLock unlock];
+}
+
+- (void)collectEvents
+{
+	BKCCommand command;
+	NSUInteger index;
+
+	while (numEvents < capacity && [inbox popCommand:& command]) {
+		// insert after events with the same time to keep order
+		for (index = numEvents; index > 0 && events [index - 1].time > command.time; index --);
+
+		memmove (& events [index + 1], & events [index], (numEvents - index) * sizeof (BKCCommand));
+		events [index] = command;
+		numEvents ++;
+	}
+}
+
+- (UInt64)nextEventTime
+{
+	return numEvents ? events [0].time : UINT64_MAX;
+}
+
+- (void)executeEventsUntilTime:(UInt64)time
+{
+	NSUInteger count = 0;
+
+	while (count < numEvents && events [count].time <= time) {
+		if (events [count].time < time) {
+			atomic_fetch_add_explicit (& numLateEvents, 1, memory_order_relaxed);
+		}
+
+		BKCCommandExecute (& events [count]);
+		count ++;
+	}
+
+	if (count) {
+		numEvents -= count;
+		memmove (events, & events [count], numEvents * sizeof (BKCCommand));
+	}
+}
+
+- (void)publishFrameTime:(UInt64)time
+{
+	atomic_store_explicit (& frameTime, time, memory_order_release);
+	atomic_store_explicit (& numCollected, inbox.numberOfExecutedCommands, memory_order_release);
+}
+
+- (void)reset
+{
+	BKCCommand command;
+
+	while ([inbox popCommand:& command]);
+
+	numEvents = 0;
+	[self publishFrameTime:0];
+
+	[producerLock lock];
+	[retainedObjects removeAllObjects];
+	[producerLock unlock];
+}
+
+@end
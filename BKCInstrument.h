@@ -56,6 +56,8 @@ typedef enum: NSUInteger
 
 /**
  * Sustain repeat range
+ *
+ * Is set by the setters below
  */
 @property (assign, nonatomic) NSRange sustainRange;
 
@@ -76,12 +78,18 @@ typedef enum: NSUInteger
 
 @interface BKCInstrument : NSObject
 {
-	BKInstrument * instrument;
+	BKInstrument   * instrument;
+	BKInstrument   * editInstrument;
 	NSMutableArray * sequences;
+	NSMutableSet   * editedSequences;
+	NSHashTable    * tracks;
+	NSInteger        editCount;
 }
 
 /**
  * Get BlipKit Instrument
+ *
+ * Is replaced by commitEditing
  */
 @property (readonly, nonatomic) BKInstrument * instrument;
 
@@ -100,6 +108,23 @@ typedef enum: NSUInteger
  */
 - (BOOL)setEnvelopeADSR:(NSInteger)attack decay:(NSInteger)decay sustain:(NSInteger)sustain release:(NSInteger)release;
 
+/**
+ * Begin a batch of edits
+ *
+ * Until the matching commitEditing, sequences are changed on a copy of the
+ * instrument and tracks keep playing the previous one. Calls can be nested.
+ */
+- (void)beginEditing;
+
+/**
+ * Apply edits made since beginEditing
+ *
+ * Updates the values of changed sequences once and replaces the instrument
+ * of all tracks using it at the next buffer boundary. The previous
+ * instrument is disposed after no track uses it anymore.
+ */
+- (BOOL)commitEditing;
+
 /**
  * For subclasses
  *
@@ -23,6 +23,7 @@
 
 #import "BKCInstrument.h"
 #import "BKCTrack.h"
+#import "BKCTrack_internal.h"
 
 @interface BKCInstrument ()
 
@@ -30,8 +31,59 @@
 
 - (void)updateSequence:(BKCInstrumentSequence *)sequence;
 
+/**
+ * Instrument which is changed by sequences
+ *
+ * This is the copy while editing
+ */
+- (BKInstrument *)editedInstrument;
+
+/**
+ * Remember sequence to be updated by commitEditing
+ *
+ * Returns NO if not editing
+ */
+- (BOOL)addEditedSequence:(BKCInstrumentSequence *)sequence;
+
+@end
+
+@interface BKCInstrumentSequence ()
+
+/**
+ * Copy sequence from instrument and replace values
+ */
+- (void)updateValues;
+
 @end
 
+/**
+ * Allocate copy of instrument
+ */
+static BKInstrument * copyInstrument (BKInstrument const * instrument)
+{
+	BKInt res;
+	BKObject object;
+	BKInstrument * copy;
+
+	if ((res = BKInstrumentAlloc (& copy)) < 0) {
+		NSLog (@"*** Couldn't initialize BKInstrument: %d", res);
+		return NULL;
+	}
+
+	// keep allocation flags
+	memcpy (&object, &copy->object, sizeof(object));
+	res = BKInstrumentInitCopy (copy, instrument);
+	memcpy (&copy->object, &object, sizeof(object));
+
+	if (res < 0) {
+		NSLog (@"*** Couldn't copy BKInstrument: %d", res);
+		BKDispose (copy);
+		return NULL;
+	}
+
+	return copy;
+}
+
 @implementation BKCInstrumentSequence
 
 @synthesize type;
@@ -75,43 +127,66 @@
 - (void)updateSequence
 {
 	BKInstrument * instr = instrument.instrument;
+	BKSequence * source = (void *) BKInstrumentGetSequence (instr, type);
 
-	sequence = (void *) BKInstrumentGetSequence (instr, type);
+	if (sequence) {
+		free (sequence);
+		sequence = NULL;
+	}
 
-	if (sequence)
-		sequence -> funcs -> copy (& sequence, sequence);
+	if (source)
+		source -> funcs -> copy (& sequence, source);
 
 	[instrument updateSequence:self];
 }
 
+- (void)updateValues
+{
+	[self updateSequence];
+
+	if (sequence) {
+		self.numberOfComponents = self.format == BKCSequenceFormatEnvelope ? 2 : 1;
+		[self replaceValues:sequence -> values length:sequence -> length];
+	}
+	else {
+		[self replaceValues:NULL length:0];
+	}
+}
+
+/**
+ * Update values now or when editing is committed
+ */
+- (void)sequenceChanged
+{
+	if (![instrument addEditedSequence:self]) {
+		[self updateValues];
+	}
+}
+
 - (BOOL)setSequencePhases:(BKInt const *)newPhases length:(NSUInteger)newLength sustainRange:(NSRange)sustainRange
 {
-	BKInstrument * instr = instrument.instrument;
+	BKInstrument * instr = [instrument editedInstrument];
 
 	if (BKInstrumentSetSequence (instr, type, newPhases, (BKInt)newLength, (BKInt)sustainRange.location, (BKInt)sustainRange.length) < 0) {
 		return NO;
 	}
 
-	[self updateSequence];
-
-	self.numberOfComponents = 1;
-	[self replaceValues:sequence -> values length:sequence -> length];
+	self.sustainRange = sustainRange;
+	[self sequenceChanged];
 
 	return YES;
 }
 
 - (BOOL)setEnvelopePhases:(BKSequencePhase const *)newPhases length:(NSUInteger)newLength sustainRange:(NSRange)sustainRange
 {
-	BKInstrument * instr = instrument.instrument;
+	BKInstrument * instr = [instrument editedInstrument];
 
 	if (BKInstrumentSetEnvelope (instr, type, newPhases, (BKInt)newLength, (BKInt)sustainRange.location, (BKInt)sustainRange.length) < 0) {
 		return NO;
 	}
 
-	[self updateSequence];
-
-	self.numberOfComponents = 2;
-	[self replaceValues:sequence -> values length:sequence -> length];
+	self.sustainRange = sustainRange;
+	[self sequenceChanged];
 
 	return YES;
 }
@@ -123,16 +198,15 @@
 	if (type != BK_SEQUENCE_VOLUME)
 		return NO;
 
-	instr = instrument.instrument;
+	instr = [instrument editedInstrument];
 
 	if (BKInstrumentSetEnvelopeADSR (instr, (BKInt)attack, (BKInt)decay, (BKInt)sustain, (BKInt)release)) {
 		return NO;
 	}
 
-	[self updateSequence];
-
-	self.numberOfComponents = 2;
-	[self replaceValues:sequence -> values length:sequence -> length];
+	// attack, decay, sustain, release
+	self.sustainRange = NSMakeRange (2, 1);
+	[self sequenceChanged];
 
 	return YES;
 }
@@ -200,20 +274,22 @@
 
 - (void)initSequence
 {
-	BKCInstrumentSequence * sequence;
-	Class sequenceClass;
-
 	sequences = [[NSMutableArray alloc] initWithCapacity:BK_MAX_SEQUENCES];
-	sequenceClass = [[self class] sequenceClass];
+	editedSequences = [[NSMutableSet alloc] init];
+	tracks = [NSHashTable weakObjectsHashTable];
 
+	// sequences are created when accessed
 	for (NSInteger i = 0; i < BK_MAX_SEQUENCES; i ++) {
-		sequence = [[sequenceClass alloc] initWithType:(BKEnum)i instrument:self];
-		[sequences addObject:sequence];
+		[sequences addObject:[NSNull null]];
 	}
 }
 
 - (void)dealloc
 {
+	if (editInstrument) {
+		BKDispose (editInstrument);
+	}
+
 	BKDispose (instrument);
 }
 
@@ -224,10 +300,19 @@
 
 - (BKCInstrumentSequence *)sequenceWithType:(BKEnum)type
 {
+	BKCInstrumentSequence * sequence;
+
 	if (type >= BK_MAX_SEQUENCES)
 		return nil;
 
-	return [sequences objectAtIndex:type];
+	sequence = [sequences objectAtIndex:type];
+
+	if (sequence == (id) [NSNull null]) {
+		sequence = [[[[self class] sequenceClass] alloc] initWithType:type instrument:self];
+		[sequences replaceObjectAtIndex:type withObject:sequence];
+	}
+
+	return sequence;
 }
 
 - (void)updateSequence:(BKCInstrumentSequence *)sequence
@@ -239,6 +324,94 @@
 	return [[self sequenceWithType:BK_SEQUENCE_VOLUME] setEnvelopeADSR:attack decay:decay sustain:sustain release:release];
 }
 
+- (BKInstrument *)editedInstrument
+{
+	return editInstrument ? editInstrument : instrument;
+}
+
+- (BOOL)addEditedSequence:(BKCInstrumentSequence *)sequence
+{
+	if (editCount == 0) {
+		return NO;
+	}
+
+	[editedSequences addObject:sequence];
+
+	return YES;
+}
+
+- (void)beginEditing
+{
+	if (editCount == 0) {
+		editInstrument = copyInstrument (instrument);
+	}
+
+	editCount ++;
+}
+
+- (BOOL)commitEditing
+{
+	BKInstrument * oldInstrument;
+
+	if (editCount == 0) {
+		NSLog (@"*** commitEditing called without beginEditing");
+		return NO;
+	}
+
+	if (-- editCount > 0) {
+		return YES;
+	}
+
+	if (editedSequences.count == 0) {
+		if (editInstrument) {
+			BKDispose (editInstrument);
+			editInstrument = NULL;
+		}
+
+		return YES;
+	}
+
+	// sequences were changed on the playing instrument if copying has failed
+	oldInstrument = NULL;
+
+	if (editInstrument) {
+		oldInstrument  = instrument;
+		instrument     = editInstrument;
+		editInstrument = NULL;
+	}
+
+	for (BKCInstrumentSequence * sequence in editedSequences) {
+		[sequence updateValues];
+	}
+
+	[editedSequences removeAllObjects];
+
+	if (oldInstrument == NULL) {
+		return YES;
+	}
+
+	BKCTrackSetPointerOfTracks (tracks.allObjects, BK_INSTRUMENT, instrument, ^{
+		BKDispose (oldInstrument);
+	});
+
+	return YES;
+}
+
+- (NSArray *)tracks
+{
+	return tracks.allObjects;
+}
+
+- (void)addTrack:(BKCTrack *)track
+{
+	[tracks addObject:track];
+}
+
+- (void)removeTrack:(BKCTrack *)track
+{
+	[tracks removeObject:track];
+}
+
 + (Class)sequenceClass
 {
 	return [BKCInstrumentSequence class];
@@ -0,0 +1,67 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Counts and phase times of loading a song
+ *
+ * Is filled by BKCCompiler for compiling and by BKCContext for attaching a
+ * program; fields of the other side are 0. memoryGrowth is the largest
+ * growth of allocated memory since the start, sampled only at phase
+ * boundaries, so short peaks within a phase are missed; it is NSNotFound
+ * where allocated memory can't be measured.
+ */
+typedef struct
+{
+	NSUInteger     numberOfBytes;
+	NSUInteger     numberOfTokens;
+	NSUInteger     numberOfTokenBatches;
+	NSUInteger     numberOfNodes;
+	NSUInteger     numberOfInstruments;
+	NSUInteger     numberOfWaveforms;
+	NSUInteger     numberOfSamples;
+	NSUInteger     numberOfTracks;
+	NSTimeInterval tokenizeTime;    // Time in the tokenizer without parsing
+	NSTimeInterval parseTime;       // Time in BKTKParserPutTokens
+	NSTimeInterval compileTime;     // Time in BKTKCompilerCompile
+	NSTimeInterval instantiateTime; // Time in BKTKContextCreate
+	NSTimeInterval attachTime;      // Time in BKTKContextAttach
+	NSTimeInterval wrapTime;        // Time creating BKCTrack objects
+	NSTimeInterval totalTime;
+	NSUInteger     memoryGrowth;    // Sampled at phase boundaries
+} BKCLoadStatistics;
+
+/**
+ * Bytes of allocated memory of the process
+ *
+ * Returns NSNotFound if not available
+ */
+extern NSUInteger BKCLoadMemoryInUse (void);
+
+/**
+ * Statistics as dictionary with the field names as keys
+ *
+ * Can be serialized as JSON. Unavailable values are NSNull.
+ */
+extern NSDictionary * BKCLoadStatisticsDictionary (BKCLoadStatistics const * statistics);
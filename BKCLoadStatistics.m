@@ -0,0 +1,63 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import "BKCLoadStatistics.h"
+
+#ifdef __APPLE__
+#import <malloc/malloc.h>
+#endif
+
+NSUInteger BKCLoadMemoryInUse (void)
+{
+#ifdef __APPLE__
+	malloc_statistics_t stats;
+
+	malloc_zone_statistics (NULL, & stats);
+
+	return stats.size_in_use;
+#else
+	return NSNotFound;
+#endif
+}
+
+NSDictionary * BKCLoadStatisticsDictionary (BKCLoadStatistics const * statistics)
+{
+	return @{
+		@"bytes":           @(statistics -> numberOfBytes),
+		@"tokens":          @(statistics -> numberOfTokens),
+		@"tokenBatches":    @(statistics -> numberOfTokenBatches),
+		@"nodes":           @(statistics -> numberOfNodes),
+		@"instruments":     @(statistics -> numberOfInstruments),
+		@"waveforms":       @(statistics -> numberOfWaveforms),
+		@"samples":         @(statistics -> numberOfSamples),
+		@"tracks":          @(statistics -> numberOfTracks),
+		@"tokenizeTime":    @(statistics -> tokenizeTime),
+		@"parseTime":       @(statistics -> parseTime),
+		@"compileTime":     @(statistics -> compileTime),
+		@"instantiateTime": @(statistics -> instantiateTime),
+		@"attachTime":      @(statistics -> attachTime),
+		@"wrapTime":        @(statistics -> wrapTime),
+		@"totalTime":       @(statistics -> totalTime),
+		@"memoryGrowth":    statistics -> memoryGrowth == NSNotFound ? (id) [NSNull null] : @(statistics -> memoryGrowth),
+	};
+}
@@ -0,0 +1,83 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+#import "BlipKit.h"
+
+/**
+ * Implementations of the output kernels
+ */
+typedef NS_ENUM(NSInteger, BKCOutputKernelType)
+{
+	BKCOutputKernelTypeScalar,
+	BKCOutputKernelTypeSSE2,
+	BKCOutputKernelTypeAVX2,
+	BKCOutputKernelTypeNEON,
+	BKCOutputKernelTypeCount,
+};
+
+/**
+ * Kernels which are currently used
+ *
+ * The best implementation supported by the CPU is selected on first use.
+ * All implementations produce bit-identical output.
+ */
+extern BKCOutputKernelType BKCOutputGetKernelType (void);
+
+/**
+ * Select kernels
+ *
+ * Returns NO if the CPU doesn't support them. Must not be called while
+ * rendering.
+ */
+extern BOOL BKCOutputSetKernelType (BKCOutputKernelType type);
+
+/**
+ * Check if the CPU supports kernels
+ */
+extern BOOL BKCOutputKernelTypeIsSupported (BKCOutputKernelType type);
+
+/**
+ * Name of kernels
+ */
+extern char const * BKCOutputKernelTypeName (BKCOutputKernelType type);
+
+/**
+ * Convert samples to float in the range [-1, 1)
+ */
+extern void BKCOutputInt16ToFloat (float * out, SInt16 const * frames, NSUInteger numSamples);
+
+/**
+ * Split interleaved frames into a buffer per channel at `offset`
+ */
+extern void BKCOutputDeinterleaveInt16 (SInt16 * const * outBuffers, NSUInteger offset, SInt16 const * frames, NSUInteger numFrames, NSUInteger numChannels);
+
+/**
+ * Split interleaved frames into a float buffer per channel at `offset`
+ */
+extern void BKCOutputDeinterleaveFloat (float * const * outBuffers, NSUInteger offset, SInt16 const * frames, NSUInteger numFrames, NSUInteger numChannels);
+
+/**
+ * Add samples to `out` and clip the sum
+ */
+extern void BKCOutputMixInt16 (SInt16 * out, SInt16 const * frames, NSUInteger numSamples);
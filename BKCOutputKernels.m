@@ -0,0 +1,459 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import "BKCOutputKernels.h"
+
+#if defined (__x86_64__) || defined (__i386__)
+#	import <immintrin.h>
+#	define BKC_OUTPUT_X86 1
+#elif defined (__ARM_NEON)
+#	import <arm_neon.h>
+#	define BKC_OUTPUT_NEON 1
+#endif
+
+#define INT16_SCALE (1.0f / 32768.0f)
+
+typedef struct
+{
+	void (* int16ToFloat) (float * restrict out, SInt16 const * restrict in, NSUInteger count);
+	void (* deinterleaveStereoInt16) (SInt16 * restrict left, SInt16 * restrict right, SInt16 const * restrict in, NSUInteger numFrames);
+	void (* deinterleaveStereoFloat) (float * restrict left, float * restrict right, SInt16 const * restrict in, NSUInteger numFrames);
+	void (* mixInt16) (SInt16 * restrict out, SInt16 const * restrict in, NSUInteger count);
+} BKCOutputKernels;
+
+static BKCOutputKernelType kernelType;
+static BKCOutputKernels const * kernels;
+
+static char const * const kernelNames [BKCOutputKernelTypeCount] = {
+	"scalar", "sse2", "avx2", "neon",
+};
+
+/**
+ * Scalar kernels
+ *
+ * Define the output of all other implementations
+ */
+static void int16ToFloatScalar (float * restrict out, SInt16 const * restrict in, NSUInteger count)
+{
+	for (NSUInteger i = 0; i < count; i ++) {
+		out [i] = in [i] * INT16_SCALE;
+	}
+}
+
+static void deinterleaveStereoInt16Scalar (SInt16 * restrict left, SInt16 * restrict right, SInt16 const * restrict in, NSUInteger numFrames)
+{
+	for (NSUInteger i = 0; i < numFrames; i ++) {
+		left [i]  = in [i * 2];
+		right [i] = in [i * 2 + 1];
+	}
+}
+
+static void deinterleaveStereoFloatScalar (float * restrict left, float * restrict right, SInt16 const * restrict in, NSUInteger numFrames)
+{
+	for (NSUInteger i = 0; i < numFrames; i ++) {
+		left [i]  = in [i * 2] * INT16_SCALE;
+		right [i] = in [i * 2 + 1] * INT16_SCALE;
+	}
+}
+
+static void mixInt16Scalar (SInt16 * restrict out, SInt16 const * restrict in, NSUInteger count)
+{
+	for (NSUInteger i = 0; i < count; i ++) {
+		SInt32 value = (SInt32) out [i] + in [i];
+
+		out [i] = (SInt16) MAX (MIN (value, INT16_MAX), INT16_MIN);
+	}
+}
+
+static BKCOutputKernels const scalarKernels = {
+	.int16ToFloat            = int16ToFloatScalar,
+	.deinterleaveStereoInt16 = deinterleaveStereoInt16Scalar,
+	.deinterleaveStereoFloat = deinterleaveStereoFloatScalar,
+	.mixInt16                = mixInt16Scalar,
+};
+
+#if BKC_OUTPUT_X86
+
+/**
+ * SSE2 kernels
+ *
+ * Samples are sign-extended to 32 bit by shifting; remaining samples are
+ * passed to the scalar kernels
+ */
+__attribute__ ((target ("sse2")))
+static void int16ToFloatSSE2 (float * restrict out, SInt16 const * restrict in, NSUInteger count)
+{
+	NSUInteger i = 0;
+	__m128 const scale = _mm_set1_ps (INT16_SCALE);
+
+	for (; i + 8 <= count; i += 8) {
+		__m128i value = _mm_loadu_si128 ((__m128i const *) & in [i]);
+		__m128i lo    = _mm_srai_epi32 (_mm_unpacklo_epi16 (value, value), 16);
+		__m128i hi    = _mm_srai_epi32 (_mm_unpackhi_epi16 (value, value), 16);
+
+		_mm_storeu_ps (& out [i], _mm_mul_ps (_mm_cvtepi32_ps (lo), scale));
+		_mm_storeu_ps (& out [i + 4], _mm_mul_ps (_mm_cvtepi32_ps (hi), scale));
+	}
+
+	int16ToFloatScalar (& out [i], & in [i], count - i);
+}
+
+__attribute__ ((target ("sse2")))
+static void deinterleaveStereoInt16SSE2 (SInt16 * restrict left, SInt16 * restrict right, SInt16 const * restrict in, NSUInteger numFrames)
+{
+	NSUInteger i = 0;
+
+	for (; i + 8 <= numFrames; i += 8) {
+		__m128i a = _mm_loadu_si128 ((__m128i const *) & in [i * 2]);
+		__m128i b = _mm_loadu_si128 ((__m128i const *) & in [i * 2 + 8]);
+		__m128i l = _mm_packs_epi32 (_mm_srai_epi32 (_mm_slli_epi32 (a, 16), 16), _mm_srai_epi32 (_mm_slli_epi32 (b, 16), 16));
+		__m128i r = _mm_packs_epi32 (_mm_srai_epi32 (a, 16), _mm_srai_epi32 (b, 16));
+
+		_mm_storeu_si128 ((__m128i *) & left [i], l);
+		_mm_storeu_si128 ((__m128i *) & right [i], r);
+	}
+
+	deinterleaveStereoInt16Scalar (& left [i], & right [i], & in [i * 2], numFrames - i);
+}
+
+__attribute__ ((target ("sse2")))
+static void deinterleaveStereoFloatSSE2 (float * restrict left, float * restrict right, SInt16 const * restrict in, NSUInteger numFrames)
+{
+	NSUInteger i = 0;
+	__m128 const scale = _mm_set1_ps (INT16_SCALE);
+
+	for (; i + 4 <= numFrames; i += 4) {
+		__m128i value = _mm_loadu_si128 ((__m128i const *) & in [i * 2]);
+		__m128i l     = _mm_srai_epi32 (_mm_slli_epi32 (value, 16), 16);
+		__m128i r     = _mm_srai_epi32 (value, 16);
+
+		_mm_storeu_ps (& left [i], _mm_mul_ps (_mm_cvtepi32_ps (l), scale));
+		_mm_storeu_ps (& right [i], _mm_mul_ps (_mm_cvtepi32_ps (r), scale));
+	}
+
+	deinterleaveStereoFloatScalar (& left [i], & right [i], & in [i * 2], numFrames - i);
+}
+
+__attribute__ ((target ("sse2")))
+static void mixInt16SSE2 (SInt16 * restrict out, SInt16 const * restrict in, NSUInteger count)
+{
+	NSUInteger i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128i a = _mm_loadu_si128 ((__m128i const *) & out [i]);
+		__m128i b = _mm_loadu_si128 ((__m128i const *) & in [i]);
+
+		_mm_storeu_si128 ((__m128i *) & out [i], _mm_adds_epi16 (a, b));
+	}
+
+	mixInt16Scalar (& out [i], & in [i], count - i);
+}
+
+static BKCOutputKernels const sse2Kernels = {
+	.int16ToFloat            = int16ToFloatSSE2,
+	.deinterleaveStereoInt16 = deinterleaveStereoInt16SSE2,
+	.deinterleaveStereoFloat = deinterleaveStereoFloatSSE2,
+	.mixInt16                = mixInt16SSE2,
+};
+
+/**
+ * AVX2 kernels
+ *
+ * Packing works per 128 bit lane; the 64 bit blocks are reordered afterwards
+ */
+__attribute__ ((target ("avx2")))
+static void int16ToFloatAVX2 (float * restrict out, SInt16 const * restrict in, NSUInteger count)
+{
+	NSUInteger i = 0;
+	__m256 const scale = _mm256_set1_ps (INT16_SCALE);
+
+	for (; i + 8 <= count; i += 8) {
+		__m256i value = _mm256_cvtepi16_epi32 (_mm_loadu_si128 ((__m128i const *) & in [i]));
+
+		_mm256_storeu_ps (& out [i], _mm256_mul_ps (_mm256_cvtepi32_ps (value), scale));
+	}
+
+	int16ToFloatScalar (& out [i], & in [i], count - i);
+}
+
+__attribute__ ((target ("avx2")))
+static void deinterleaveStereoInt16AVX2 (SInt16 * restrict left, SInt16 * restrict right, SInt16 const * restrict in, NSUInteger numFrames)
+{
+	NSUInteger i = 0;
+
+	for (; i + 16 <= numFrames; i += 16) {
+		__m256i a = _mm256_loadu_si256 ((__m256i const *) & in [i * 2]);
+		__m256i b = _mm256_loadu_si256 ((__m256i const *) & in [i * 2 + 16]);
+		__m256i l = _mm256_packs_epi32 (_mm256_srai_epi32 (_mm256_slli_epi32 (a, 16), 16), _mm256_srai_epi32 (_mm256_slli_epi32 (b, 16), 16));
+		__m256i r = _mm256_packs_epi32 (_mm256_srai_epi32 (a, 16), _mm256_srai_epi32 (b, 16));
+
+		_mm256_storeu_si256 ((__m256i *) & left [i], _mm256_permute4x64_epi64 (l, 0xD8));
+		_mm256_storeu_si256 ((__m256i *) & right [i], _mm256_permute4x64_epi64 (r, 0xD8));
+	}
+
+	deinterleaveStereoInt16Scalar (& left [i], & right [i], & in [i * 2], numFrames - i);
+}
+
+__attribute__ ((target ("avx2")))
+static void deinterleaveStereoFloatAVX2 (float * restrict left, float * restrict right, SInt16 const * restrict in, NSUInteger numFrames)
+{
+	NSUInteger i = 0;
+	__m256 const scale = _mm256_set1_ps (INT16_SCALE);
+
+	for (; i + 8 <= numFrames; i += 8) {
+		__m256i value = _mm256_loadu_si256 ((__m256i const *) & in [i * 2]);
+		__m256i l     = _mm256_srai_epi32 (_mm256_slli_epi32 (value, 16), 16);
+		__m256i r     = _mm256_srai_epi32 (value, 16);
+
+		_mm256_storeu_ps (& left [i], _mm256_mul_ps (_mm256_cvtepi32_ps (l), scale));
+		_mm256_storeu_ps (& right [i], _mm256_mul_ps (_mm256_cvtepi32_ps (r), scale));
+	}
+
+	deinterleaveStereoFloatScalar (& left [i], & right [i], & in [i * 2], numFrames - i);
+}
+
+__attribute__ ((target ("avx2")))
+static void mixInt16AVX2 (SInt16 * restrict out, SInt16 const * restrict in, NSUInteger count)
+{
+	NSUInteger i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		__m256i a = _mm256_loadu_si256 ((__m256i const *) & out [i]);
+		__m256i b = _mm256_loadu_si256 ((__m256i const *) & in [i]);
+
+		_mm256_storeu_si256 ((__m256i *) & out [i], _mm256_adds_epi16 (a, b));
+	}
+
+	mixInt16Scalar (& out [i], & in [i], count - i);
+}
+
+static BKCOutputKernels const avx2Kernels = {
+	.int16ToFloat            = int16ToFloatAVX2,
+	.deinterleaveStereoInt16 = deinterleaveStereoInt16AVX2,
+	.deinterleaveStereoFloat = deinterleaveStereoFloatAVX2,
+	.mixInt16                = mixInt16AVX2,
+};
+
+#endif
+
+#if BKC_OUTPUT_NEON
+
+/**
+ * NEON kernels
+ */
+static void int16ToFloatNEON (float * restrict out, SInt16 const * restrict in, NSUInteger count)
+{
+	NSUInteger i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		int16x8_t value = vld1q_s16 (& in [i]);
+
+		vst1q_f32 (& out [i], vmulq_n_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_low_s16 (value))), INT16_SCALE));
+		vst1q_f32 (& out [i + 4], vmulq_n_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_high_s16 (value))), INT16_SCALE));
+	}
+
+	int16ToFloatScalar (& out [i], & in [i], count - i);
+}
+
+static void deinterleaveStereoInt16NEON (SInt16 * restrict left, SInt16 * restrict right, SInt16 const * restrict in, NSUInteger numFrames)
+{
+	NSUInteger i = 0;
+
+	for (; i + 8 <= numFrames; i += 8) {
+		int16x8x2_t value = vld2q_s16 (& in [i * 2]);
+
+		vst1q_s16 (& left [i], value.val [0]);
+		vst1q_s16 (& right [i], value.val [1]);
+	}
+
+	deinterleaveStereoInt16Scalar (& left [i], & right [i], & in [i * 2], numFrames - i);
+}
+
+static void deinterleaveStereoFloatNEON (float * restrict left, float * restrict right, SInt16 const * restrict in, NSUInteger numFrames)
+{
+	NSUInteger i = 0;
+
+	for (; i + 8 <= numFrames; i += 8) {
+		int16x8x2_t value = vld2q_s16 (& in [i * 2]);
+
+		vst1q_f32 (& left [i], vmulq_n_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_low_s16 (value.val [0]))), INT16_SCALE));
+		vst1q_f32 (& left [i + 4], vmulq_n_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_high_s16 (value.val [0]))), INT16_SCALE));
+		vst1q_f32 (& right [i], vmulq_n_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_low_s16 (value.val [1]))), INT16_SCALE));
+		vst1q_f32 (& right [i + 4], vmulq_n_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_high_s16 (value.val [1]))), INT16_SCALE));
+	}
+
+	deinterleaveStereoFloatScalar (& left [i], & right [i], & in [i * 2], numFrames - i);
+}
+
+static void mixInt16NEON (SInt16 * restrict out, SInt16 const * restrict in, NSUInteger count)
+{
+	NSUInteger i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		vst1q_s16 (& out [i], vqaddq_s16 (vld1q_s16 (& out [i]), vld1q_s16 (& in [i])));
+	}
+
+	mixInt16Scalar (& out [i], & in [i], count - i);
+}
+
+static BKCOutputKernels const neonKernels = {
+	.int16ToFloat            = int16ToFloatNEON,
+	.deinterleaveStereoInt16 = deinterleaveStereoInt16NEON,
+	.deinterleaveStereoFloat = deinterleaveStereoFloatNEON,
+	.mixInt16                = mixInt16NEON,
+};
+
+#endif
+
+static BKCOutputKernels const * kernelsOfType (BKCOutputKernelType type)
+{
+	switch (type) {
+		case BKCOutputKernelTypeScalar: {
+			return & scalarKernels;
+		}
+#if BKC_OUTPUT_X86
+		case BKCOutputKernelTypeSSE2: {
+			return __builtin_cpu_supports ("sse2") ? & sse2Kernels : NULL;
+		}
+		case BKCOutputKernelTypeAVX2: {
+			return __builtin_cpu_supports ("avx2") ? & avx2Kernels : NULL;
+		}
+#endif
+#if BKC_OUTPUT_NEON
+		case BKCOutputKernelTypeNEON: {
+			return & neonKernels;
+		}
+#endif
+		default: {
+			return NULL;
+		}
+	}
+}
+
+/**
+ * Get current kernels
+ *
+ * Selects the best supported kernels on first call
+ */
+static BKCOutputKernels const * currentKernels (void)
+{
+	static dispatch_once_t once;
+
+	dispatch_once (& once, ^{
+		if (kernels == NULL) {
+			for (NSInteger type = BKCOutputKernelTypeCount - 1; type >= 0; type --) {
+				if ((kernels = kernelsOfType (type))) {
+					kernelType = type;
+					break;
+				}
+			}
+		}
+	});
+
+	return kernels;
+}
+
+BKCOutputKernelType BKCOutputGetKernelType (void)
+{
+	currentKernels ();
+
+	return kernelType;
+}
+
+BOOL BKCOutputSetKernelType (BKCOutputKernelType type)
+{
+	BKCOutputKernels const * newKernels = kernelsOfType (type);
+
+	if (newKernels == NULL) {
+		return NO;
+	}
+
+	currentKernels ();
+
+	kernels    = newKernels;
+	kernelType = type;
+
+	return YES;
+}
+
+BOOL BKCOutputKernelTypeIsSupported (BKCOutputKernelType type)
+{
+	return kernelsOfType (type) != NULL;
+}
+
+char const * BKCOutputKernelTypeName (BKCOutputKernelType type)
+{
+	if (type < 0 || type >= BKCOutputKernelTypeCount) {
+		return "unknown";
+	}
+
+	return kernelNames [type];
+}
+
+void BKCOutputInt16ToFloat (float * out, SInt16 const * frames, NSUInteger numSamples)
+{
+	currentKernels () -> int16ToFloat (out, frames, numSamples);
+}
+
+void BKCOutputDeinterleaveInt16 (SInt16 * const * outBuffers, NSUInteger offset, SInt16 const * frames, NSUInteger numFrames, NSUInteger numChannels)
+{
+	if (numChannels == 2) {
+		currentKernels () -> deinterleaveStereoInt16 (outBuffers [0] + offset, outBuffers [1] + offset, frames, numFrames);
+		return;
+	}
+
+	for (NSUInteger c = 0; c < numChannels; c ++) {
+		SInt16 * restrict out = outBuffers [c] + offset;
+
+		for (NSUInteger i = 0; i < numFrames; i ++) {
+			out [i] = frames [i * numChannels + c];
+		}
+	}
+}
+
+void BKCOutputDeinterleaveFloat (float * const * outBuffers, NSUInteger offset, SInt16 const * frames, NSUInteger numFrames, NSUInteger numChannels)
+{
+	if (numChannels == 2) {
+		currentKernels () -> deinterleaveStereoFloat (outBuffers [0] + offset, outBuffers [1] + offset, frames, numFrames);
+		return;
+	}
+
+	// mono is not interleaved
+	if (numChannels == 1) {
+		currentKernels () -> int16ToFloat (outBuffers [0] + offset, frames, numFrames);
+		return;
+	}
+
+	for (NSUInteger c = 0; c < numChannels; c ++) {
+		float * restrict out = outBuffers [c] + offset;
+
+		for (NSUInteger i = 0; i < numFrames; i ++) {
+			out [i] = frames [i * numChannels + c] * INT16_SCALE;
+		}
+	}
+}
+
+void BKCOutputMixInt16 (SInt16 * out, SInt16 const * frames, NSUInteger numSamples)
+{
+	currentKernels () -> mixInt16 (out, frames, numSamples);
+}
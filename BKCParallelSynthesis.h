@@ -0,0 +1,64 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+#import "BKCContext.h"
+
+@interface BKCContext (BKCParallelSynthesis)
+
+/**
+ * Number of threads which synthesize tracks
+ *
+ * If larger than 1, attached tracks are partitioned across this many
+ * BlipKit contexts which are clocked in step with the render context. One
+ * partition is synthesized by the calling thread, the others by a fixed
+ * pool of worker threads. Partitions are advanced to each tick of the clock
+ * before the render context runs it, so changes made by dividers and the
+ * program apply at the same time as in a single context. The unclipped
+ * samples of the partitions are summed into the render context, which
+ * clips once, so the output is the same as without partitions.
+ *
+ * Tracks attached later are synthesized serially until
+ * rebalanceSynthesisThreads is called. Default is 1. Should be changed
+ * before generating frames; see rebalanceSynthesisThreads.
+ */
+@property (readwrite, nonatomic) NSUInteger numberOfSynthesisThreads;
+
+/**
+ * Minimum number of partitioned tracks for using worker threads
+ *
+ * Below, partitions are synthesized by the calling thread to avoid
+ * synchronization overhead. The output is the same in both cases. Default
+ * is 32.
+ */
+@property (readwrite, nonatomic) NSUInteger parallelSynthesisThreshold;
+
+/**
+ * Distribute attached tracks evenly across synthesis threads
+ *
+ * Returns NO while the audio unit or render pipeline is running with a
+ * command queue, as the render thread then doesn't take the lock.
+ */
+- (BOOL)rebalanceSynthesisThreads;
+
+@end
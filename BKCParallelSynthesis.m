@@ -0,0 +1,470 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import <stdatomic.h>
+#import "BKCParallelSynthesis.h"
+#import "BKCContext_internal.h"
+#import "BKCRealtimeChecker.h"
+#import "BKCTrack.h"
+
+#define PARTITION_CAPACITY 1024
+
+/**
+ * A thread which synthesizes a partition on request
+ */
+@interface BKCSynthesisWorker : NSObject
+{
+@public
+	BKContext          * ctx;
+	BKTime               time;
+	BOOL                 end;
+	BKInt                result;
+	atomic_bool          quit;
+	dispatch_semaphore_t startSemaphore;
+	dispatch_semaphore_t doneSemaphore;
+	dispatch_semaphore_t exitSemaphore;
+	NSThread           * thread;
+}
+
+@end
+
+/**
+ * Partition contexts, their tracks and workers
+ */
+@interface BKCSynthesisSession : NSObject
+{
+@public
+	NSUInteger       numPartitions;
+	NSUInteger       numTracks;
+	BKContext      * contexts;
+	BKTime         * startTimes;
+	NSUInteger       numInitialized;
+	NSMutableArray * partitionTracks;
+	NSMutableArray * workers;
+	SInt16         * scratch;
+	BKTrack          clockTrack;
+	BOOL             initialized;
+}
+
+@end
+
+/**
+ * Generate partition up to `time` and end its frames there if `end` is set
+ */
+static BKInt advancePartition (BKContext * ctx, BKTime time, BOOL end)
+{
+	BKInt res = BKContextGenerateToTime (ctx, time, NULL);
+
+	if (res >= 0 && end) {
+		BKContextEnd (ctx, time);
+	}
+
+	return res;
+}
+
+/**
+ * Move the pending deltas of the channel buffers of `ctx` into those of
+ * `target`
+ *
+ * Both contexts have to be ended at the same frame. Deltas are summed as
+ * integers and only `target` clips when its frames are read, so the output
+ * is the same as if the tracks of `ctx` were attached to `target`.
+ */
+static void mergeChannelBuffers (BKContext * target, BKContext * ctx, UInt32 numFrames)
+{
+	NSUInteger count = numFrames + BK_STEP_WIDTH;
+
+	for (BKInt c = 0; c < ctx -> numChannels; c ++) {
+		BKInt * frames       = ctx -> channels [c].frames;
+		BKInt * targetFrames = target -> channels [c].frames;
+
+		for (NSUInteger i = 0; i < count; i ++) {
+			targetFrames [i] += frames [i];
+			frames [i] = 0;
+		}
+	}
+}
+
+@implementation BKCSynthesisWorker
+
+- (instancetype)initWithContext:(BKContext *)theContext doneSemaphore:(dispatch_semaphore_t)semaphore
+{
+	if ((self = [super init])) {
+		ctx            = theContext;
+		doneSemaphore  = semaphore;
+		startSemaphore = dispatch_semaphore_create (0);
+		exitSemaphore  = dispatch_semaphore_create (0);
+		atomic_init (& quit, NO);
+
+		thread = [[NSThread alloc] initWithTarget:self selector:@selector(synthesize) object:nil];
+		thread.name = @"BKCSynthesisWorker";
+		thread.qualityOfService = NSQualityOfServiceUserInteractive;
+		[thread start];
+	}
+
+	return self;
+}
+
+- (void)stop
+{
+	atomic_store_explicit (& quit, YES, memory_order_release);
+	dispatch_semaphore_signal (startSemaphore);
+	dispatch_semaphore_wait (exitSemaphore, DISPATCH_TIME_FOREVER);
+	thread = nil;
+}
+
+- (void)synthesize
+{
+	while (1) {
+		dispatch_semaphore_wait (startSemaphore, DISPATCH_TIME_FOREVER);
+
+		if (atomic_load_explicit (& quit, memory_order_acquire)) {
+			break;
+		}
+
+		// semaphores order accesses to `time`, `end` and `result`
+		BKC_REALTIME_SECTION_BEGIN ();
+		result = advancePartition (ctx, time, end);
+		BKC_REALTIME_SECTION_END ();
+		dispatch_semaphore_signal (doneSemaphore);
+	}
+
+	dispatch_semaphore_signal (exitSemaphore);
+}
+
+@end
+
+@implementation BKCSynthesisSession
+
+- (void)dealloc
+{
+	for (BKCSynthesisWorker * worker in workers) {
+		[worker stop];
+	}
+
+	for (NSUInteger i = 0; i < numInitialized; i ++) {
+		BKDispose (& contexts [i]);
+	}
+
+	if (initialized) {
+		BKDispose (& clockTrack);
+	}
+
+	if (contexts) {
+		free (contexts);
+	}
+
+	if (startTimes) {
+		free (startTimes);
+	}
+
+	if (scratch) {
+		free (scratch);
+	}
+}
+
+@end
+
+@implementation BKCContext (BKCParallelSynthesis)
+
+- (NSUInteger)numberOfSynthesisThreads
+{
+	return numberOfSynthesisThreads;
+}
+
+- (void)setNumberOfSynthesisThreads:(NSUInteger)newNumberOfThreads
+{
+	newNumberOfThreads = MAX (newNumberOfThreads, 1);
+
+	if (newNumberOfThreads != numberOfSynthesisThreads) {
+		numberOfSynthesisThreads = newNumberOfThreads;
+		[self rebalanceSynthesisThreads];
+	}
+}
+
+- (NSUInteger)parallelSynthesisThreshold
+{
+	return parallelSynthesisThreshold;
+}
+
+- (void)setParallelSynthesisThreshold:(NSUInteger)newThreshold
+{
+	parallelSynthesisThreshold = newThreshold;
+}
+
+- (BOOL)rebalanceSynthesisThreads
+{
+	BKTime period;
+	NSUInteger numPartitions;
+	BKCSynthesisSession * session;
+	dispatch_semaphore_t doneSemaphore;
+	UInt32 numChannels = renderCtx.numChannels;
+
+	if ([self rendersWithoutLock]) {
+		NSLog (@"*** Synthesis threads can't be rebalanced while rendering with a command queue or render pipeline");
+		return NO;
+	}
+
+	[self endSynthesisSession];
+
+	if (numberOfSynthesisThreads <= 1) {
+		return YES;
+	}
+
+	if (stemSession || checkpointStore) {
+		NSLog (@"*** Synthesis threads can't be used with stems or checkpoints");
+		return NO;
+	}
+
+	numPartitions = MIN (numberOfSynthesisThreads, MAX (tracks.count, 1));
+
+	session = [[BKCSynthesisSession alloc] init];
+	session -> numPartitions   = numPartitions;
+	session -> contexts        = malloc (numPartitions * sizeof (BKContext));
+	session -> startTimes      = malloc (numPartitions * sizeof (BKTime));
+	session -> scratch         = malloc (PARTITION_CAPACITY * numChannels * sizeof (SInt16));
+	session -> partitionTracks = [[NSMutableArray alloc] init];
+	session -> workers         = [[NSMutableArray alloc] init];
+
+	if (session -> contexts == NULL || session -> startTimes == NULL || session -> scratch == NULL) {
+		NSLog (@"*** Couldn't allocate synthesis partitions");
+		return NO;
+	}
+
+	if (BKTrackInit (& session -> clockTrack, BK_SQUARE) < 0) {
+		NSLog (@"*** Couldn't initialize track");
+		return NO;
+	}
+
+	session -> initialized = YES;
+	BKSetAttr (& session -> clockTrack, BK_VOLUME, 0);
+
+	BKGetPtr (& renderCtx, BK_CLOCK_PERIOD, & period, sizeof (period));
+
+	for (NSUInteger i = 0; i < numPartitions; i ++) {
+		if (BKContextInit (& session -> contexts [i], numChannels, renderCtx.sampleRate) < 0) {
+			NSLog (@"*** Couldn't initialize synthesis context");
+			return NO;
+		}
+
+		session -> numInitialized ++;
+		BKSetPtr (& session -> contexts [i], BK_CLOCK_PERIOD, & period, sizeof (period));
+		[session -> partitionTracks addObject:[[NSMutableArray alloc] init]];
+	}
+
+	doneSemaphore = dispatch_semaphore_create (0);
+
+	// first partition is synthesized by the render thread
+	for (NSUInteger i = 1; i < numPartitions; i ++) {
+		BKCSynthesisWorker * worker = [[BKCSynthesisWorker alloc] initWithContext:& session -> contexts [i] doneSemaphore:doneSemaphore];
+
+		[session -> workers addObject:worker];
+	}
+
+	[self lock];
+
+	// round-robin keeps program tracks with similar load apart
+	for (NSUInteger i = 0; i < tracks.count; i ++) {
+		[session -> partitionTracks [i % numPartitions] addObject:tracks [i]];
+	}
+
+	for (NSUInteger i = 0; i < numPartitions; i ++) {
+		[self moveTracks:session -> partitionTracks [i] toContext:& session -> contexts [i]];
+	}
+
+	session -> numTracks = tracks.count;
+	BKTrackAttach (& session -> clockTrack, & renderCtx);
+	synthesisSession = session;
+
+	[self unlock];
+
+	return YES;
+}
+
+@end
+
+@implementation BKCContext (BKCSynthesisContexts)
+
+/**
+ * Check if a render thread may generate frames without taking the lock
+ */
+- (BOOL)rendersWithoutLock
+{
+	BOOL running = renderPipeline.running;
+
+#if BKC_AUDIO_UNIT
+	running = running || audioUnit.isStarted;
+#endif
+
+	// the audio unit or the pipeline's producer takes it otherwise
+	return running && commandQueue != nil;
+}
+
+/**
+ * Advance all partitions to `offset` from the start of the segment
+ *
+ * Waits for all workers before returning.
+ */
+static BKInt advancePartitions (BKCSynthesisSession * session, BKTime offset, BOOL end, BOOL threaded)
+{
+	BKInt res;
+	BKCSynthesisWorker * worker;
+
+	for (NSUInteger i = 1; i < session -> numPartitions; i ++) {
+		worker = session -> workers [i - 1];
+		worker -> time = BKTimeAdd (session -> startTimes [i], offset);
+		worker -> end  = end;
+
+		if (threaded) {
+			dispatch_semaphore_signal (worker -> startSemaphore);
+		}
+	}
+
+	res = advancePartition (& session -> contexts [0], BKTimeAdd (session -> startTimes [0], offset), end);
+
+	for (NSUInteger i = 1; i < session -> numPartitions; i ++) {
+		worker = session -> workers [i - 1];
+
+		if (threaded) {
+			dispatch_semaphore_wait (worker -> doneSemaphore, DISPATCH_TIME_FOREVER);
+		}
+		else {
+			worker -> result = advancePartition (worker -> ctx, worker -> time, end);
+		}
+	}
+
+	// workers share the semaphore; results are complete after all waits
+	for (NSUInteger i = 1; i < session -> numPartitions && res >= 0; i ++) {
+		res = ((BKCSynthesisWorker *) session -> workers [i - 1]) -> result;
+	}
+
+	return res;
+}
+
+- (BKInt)generateSynthesisFrames:(SInt16 *)outBuffer numberFrames:(UInt32)inNumberFrames
+{
+	BKInt  res;
+	BOOL   end;
+	UInt32 size;
+	UInt32 numFrames = 0;
+	BKTime startTime, stepTime, endTime;
+	UInt32 numChannels = renderCtx.numChannels;
+	BKCSynthesisSession * session = synthesisSession;
+	BOOL threaded = session -> workers.count && session -> numTracks >= parallelSynthesisThreshold;
+
+	while (numFrames < inNumberFrames) {
+		size = MIN (inNumberFrames - numFrames, PARTITION_CAPACITY);
+
+		BKGetPtr (& renderCtx, BK_TIME, & startTime, sizeof (startTime));
+		endTime = BKTimeAddFrames (startTime, size);
+
+		for (NSUInteger i = 0; i < session -> numPartitions; i ++) {
+			BKGetPtr (& session -> contexts [i], BK_TIME, & session -> startTimes [i], sizeof (BKTime));
+		}
+
+		// partitions reach each clock tick before the render context runs it
+		do {
+			stepTime = [self nextRenderStepTime:endTime];
+			end      = !BKTimeIsLess (stepTime, endTime);
+
+			if ((res = advancePartitions (session, BKTimeSub (stepTime, startTime), end, threaded)) < 0) {
+				return res;
+			}
+
+			// remaining tracks and dividers; the clock track keeps it generating
+			if ((res = BKContextGenerateToTime (& renderCtx, stepTime, NULL)) < 0) {
+				return res;
+			}
+		}
+		while (!end);
+
+		BKContextEnd (& renderCtx, endTime);
+
+		// sum partitions before the render context clips
+		for (NSUInteger i = 0; i < session -> numPartitions; i ++) {
+			mergeChannelBuffers (& renderCtx, & session -> contexts [i], size);
+			BKContextRead (& session -> contexts [i], session -> scratch, size);
+		}
+
+		if ((res = BKContextRead (& renderCtx, & outBuffer [numFrames * numChannels], size)) < 0) {
+			return res;
+		}
+
+		if (res < size) {
+			memset (& outBuffer [(numFrames + res) * numChannels], 0, (size - res) * numChannels * sizeof (SInt16));
+		}
+
+		numFrames += size;
+	}
+
+	return inNumberFrames;
+}
+
+- (void)resetSynthesisContexts
+{
+	BKCSynthesisSession * session = synthesisSession;
+
+	for (NSUInteger i = 0; i < session -> numPartitions; i ++) {
+		BKContextReset (& session -> contexts [i]);
+	}
+}
+
+- (BKContext *)synthesisContextOfTrack:(BKCTrack *)track
+{
+	BKCSynthesisSession * session = synthesisSession;
+
+	for (NSUInteger i = 0; i < session -> numPartitions; i ++) {
+		if ([session -> partitionTracks [i] indexOfObjectIdenticalTo:track] != NSNotFound) {
+			return & session -> contexts [i];
+		}
+	}
+
+	return & renderCtx;
+}
+
+- (void)endSynthesisSession
+{
+	BKCSynthesisSession * session = synthesisSession;
+
+	if (session == nil) {
+		return;
+	}
+
+	[self lock];
+
+	for (NSArray * partition in session -> partitionTracks) {
+		for (BKCTrack * track in partition) {
+			// may have been detached meanwhile
+			if (track.context == self) {
+				[self moveTracks:@[track] toContext:& renderCtx];
+			}
+		}
+	}
+
+	BKTrackDetach (& session -> clockTrack);
+	synthesisSession = nil;
+
+	[self unlock];
+}
+
+@end
@@ -0,0 +1,61 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+#import "BlipKit.h"
+#import "BKTKCompiler.h"
+
+/**
+ * Immutable result of a compilation
+ *
+ * Is created once with BKCCompiler's program method and can be
+ * instantiated by any number of contexts with addTracksFromProgram:.
+ * Instruments, waveforms, samples and track commands are shared by all
+ * instances; each context only allocates its tracks and their playback
+ * state. The compiled data must not be modified after creation.
+ */
+@interface BKCProgram : NSObject
+{
+	BKTKCompiler * compiler;
+	NSData       * mappedData;
+	NSArray      * commandPointers;
+}
+
+/**
+ * The compiled data
+ *
+ * Only to be read
+ */
+@property (readonly, nonatomic) BKTKCompiler const * compiler;
+
+/**
+ * Compile string into a new program
+ */
++ (instancetype)programWithString:(NSString *)string error:(NSError **)error;
+
+/**
+ * Compile data into a new program
+ */
++ (instancetype)programWithData:(NSData *)data error:(NSError **)error;
+
+@end
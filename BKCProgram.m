@@ -0,0 +1,89 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import "BKCProgram_internal.h"
+#import "BKCCompiler.h"
+
+@implementation BKCProgram
+
+- (instancetype)initWithCompiler:(BKTKCompiler *)inCompiler
+{
+	return [self initWithCompiler:inCompiler commandPointers:nil];
+}
+
+- (instancetype)initWithCompiler:(BKTKCompiler *)inCompiler commandPointers:(NSArray *)pointers
+{
+	if ((self = [super init])) {
+		compiler        = inCompiler;
+		commandPointers = pointers;
+	}
+
+	return self;
+}
+
+- (void)dealloc
+{
+	if (compiler) {
+		BKDispose (compiler);
+		free (compiler);
+	}
+}
+
++ (instancetype)programWithString:(NSString *)string error:(NSError **)error
+{
+	return [self programWithData:[string dataUsingEncoding:NSUTF8StringEncoding] error:error];
+}
+
++ (instancetype)programWithData:(NSData *)data error:(NSError **)error
+{
+	BKCCompiler * compiler = [[BKCCompiler alloc] init];
+
+	if ([compiler compileData:data error:error] == NO) {
+		return nil;
+	}
+
+	return [compiler program];
+}
+
+- (BKTKCompiler const *)compiler
+{
+	return compiler;
+}
+
+- (BKCProgram *)instantiateParserContext:(BKTKContext *)ctx
+{
+	BKInt res;
+
+	// BKTKContextCreate only reads the compiler: tracks get their own state
+	// and refer to the compiler's commands and objects without owning them
+	res = BKTKContextCreate (ctx, compiler);
+
+	if (res != 0) {
+		NSLog (@"*** Couldn't instantiate program: %d", res);
+		return nil;
+	}
+
+	return self;
+}
+
+@end
@@ -0,0 +1,69 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+#import "BKCProgram.h"
+
+/**
+ * Version of the binary program format
+ *
+ * Archives with a different version are rejected and have to be converted
+ * again from the source
+ */
+#define BKC_PROGRAM_ARCHIVE_VERSION 1
+
+@interface BKCProgram (BKCProgramArchive)
+
+/**
+ * Load program from a binary archive without compiling
+ *
+ * The file is memory mapped. Waveform and sample frames reference the
+ * mapped file; command streams are copied to resolve their references to
+ * instruments, waveforms and samples. Archives are only valid for the
+ * same version of the parser and the same architecture as used by the
+ * converter.
+ */
++ (instancetype)programWithContentsOfArchiveFile:(NSString *)path error:(NSError **)error;
+
+/**
+ * Load program from binary archive data without compiling
+ *
+ * Frames reference `data`, which is kept alive by the program
+ */
++ (instancetype)programWithArchiveData:(NSData *)data error:(NSError **)error;
+
+/**
+ * Serialize compiled data into the binary format
+ *
+ * The program has to be compiled with BKCCompiler's recordsCommandPointers
+ * set, or loaded from an archive; only the recorded pointers in commands are
+ * relocated. Returns nil if the compiled data can't be archived.
+ */
+- (NSData *)archivedDataWithError:(NSError **)error;
+
+/**
+ * Frames of waveforms and samples reference the archive data
+ */
+@property (readonly, nonatomic) BOOL isMapped;
+
+@end
@@ -0,0 +1,877 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import "BKCProgramArchive.h"
+#import "BKCProgram_internal.h"
+#import "BKTKContext.h"
+
+#define ARCHIVE_MAGIC "BKCP"
+#define ARCHIVE_BYTE_ORDER 0x01020304
+#define ARCHIVE_ALIGNMENT 8
+
+/**
+ * Fixed-size start of an archive
+ *
+ * Is followed by instruments, waveforms, samples and tracks in this order
+ */
+typedef struct
+{
+	char   magic [4];
+	UInt32 version;
+	UInt32 byteOrder;
+	UInt16 pointerSize;
+	UInt16 intSize;
+	UInt32 numInstruments;
+	UInt32 numWaveforms;
+	UInt32 numSamples;
+	UInt32 numTracks;
+} BKCArchiveHeader;
+
+/**
+ * Sequence of an instrument slot
+ */
+typedef struct
+{
+	UInt32 format;
+	SInt32 length;
+	SInt32 sustainOffset;
+	SInt32 sustainLength;
+} BKCArchiveSequence;
+
+/**
+ * Frames of a waveform or sample
+ */
+typedef struct
+{
+	UInt32 numChannels;
+	UInt32 numFrames;
+} BKCArchiveFrames;
+
+/**
+ * Objects which command streams can point to
+ */
+typedef NS_ENUM(UInt16, BKCArchiveObject)
+{
+	BKCArchiveObjectInstrument,
+	BKCArchiveObjectInstrumentData,
+	BKCArchiveObjectWaveform,
+	BKCArchiveObjectWaveformData,
+	BKCArchiveObjectSample,
+	BKCArchiveObjectSampleData,
+	BKCArchiveObjectTrack,
+	BKCArchiveObjectCommands,
+};
+
+/**
+ * A pointer in a command stream
+ *
+ * `index` is the object index; tracks are numbered from 1 after the global
+ * track and command buffers from 1 after the global commands of a track,
+ * which is stored in `subIndex`.
+ */
+typedef struct
+{
+	UInt32 offset;
+	UInt16 object;
+	UInt16 reserved;
+	UInt32 index;
+	UInt32 subIndex;
+} BKCArchiveRelocation;
+
+/**
+ * A known object address used to find pointers in command streams
+ */
+typedef struct
+{
+	void const * pointer;
+	BKCArchiveRelocation target;
+} BKCArchiveTarget;
+
+/**
+ * Bounds checked reader of archive data
+ */
+typedef struct
+{
+	UInt8 const * bytes;
+	NSUInteger    offset;
+	NSUInteger    size;
+} BKCArchiveReader;
+
+static NSError * archiveError (NSInteger code, NSString * description)
+{
+	return [NSError errorWithDomain:NSPOSIXErrorDomain code:code userInfo:@{
+		NSLocalizedDescriptionKey: description
+	}];
+}
+
+static void appendBytes (NSMutableData * data, void const * bytes, NSUInteger size)
+{
+	static UInt8 const padding [ARCHIVE_ALIGNMENT] = {0};
+
+	[data appendBytes:bytes length:size];
+
+	// keep frames aligned so they can be referenced in place
+	if (data.length % ARCHIVE_ALIGNMENT) {
+		[data appendBytes:padding length:ARCHIVE_ALIGNMENT - data.length % ARCHIVE_ALIGNMENT];
+	}
+}
+
+static void appendName (NSMutableData * data, char const * name)
+{
+	UInt32 length = (UInt32) strlen (name);
+
+	appendBytes (data, & length, sizeof (length));
+	appendBytes (data, name, length + 1);
+}
+
+static void const * readBytes (BKCArchiveReader * reader, NSUInteger size)
+{
+	void const * bytes;
+	NSUInteger alignedSize = (size + ARCHIVE_ALIGNMENT - 1) & ~(NSUInteger) (ARCHIVE_ALIGNMENT - 1);
+
+	if (alignedSize < size || reader -> size - reader -> offset < alignedSize) {
+		return NULL;
+	}
+
+	bytes = & reader -> bytes [reader -> offset];
+	reader -> offset += alignedSize;
+
+	return bytes;
+}
+
+static char const * readName (BKCArchiveReader * reader)
+{
+	UInt32 const * length = readBytes (reader, sizeof (UInt32));
+	char const * name;
+
+	if (length == NULL || (name = readBytes (reader, (NSUInteger) * length + 1)) == NULL) {
+		return NULL;
+	}
+
+	return name [* length] == '\0' ? name : NULL;
+}
+
+static int compareTargets (void const * a, void const * b)
+{
+	uintptr_t pa = (uintptr_t) ((BKCArchiveTarget const *) a) -> pointer;
+	uintptr_t pb = (uintptr_t) ((BKCArchiveTarget const *) b) -> pointer;
+
+	return pa < pb ? -1 : (pa > pb ? 1 : 0);
+}
+
+/**
+ * Command buffer of track
+ *
+ * Index 0 is the buffer of global commands
+ */
+static BKByteBuffer * commandBuffer (BKTKCompilerTrack * track, NSUInteger index)
+{
+	if (index == 0) {
+		return & track -> globalCmds;
+	}
+
+	return *(BKByteBuffer **) BKArrayItemAt (& track -> cmdGroups, index - 1);
+}
+
+static BKTKCompilerTrack * compilerTrack (BKTKCompiler const * compiler, NSUInteger index)
+{
+	if (index == 0) {
+		return (BKTKCompilerTrack *) & compiler -> globalTrack;
+	}
+
+	return *(BKTKCompilerTrack **) BKArrayItemAt (& compiler -> tracks, index - 1);
+}
+
+/**
+ * Objects of a hash table in iteration order
+ */
+static NSArray * hashTableItems (BKHashTable const * table, NSMutableArray * names)
+{
+	BKHashTableIterator itor;
+	char const * key;
+	void * item;
+	NSMutableArray * items = [[NSMutableArray alloc] init];
+
+	BKHashTableIteratorInit (& itor, (BKHashTable *) table);
+
+	while (BKHashTableIteratorNext (& itor, & key, & item)) {
+		[items addObject:[NSValue valueWithPointer:item]];
+		[names addObject:[NSValue valueWithPointer:key]];
+	}
+
+	return items;
+}
+
+static void appendFrames (NSMutableData * data, BKData const * frames)
+{
+	BKCArchiveFrames header = {
+		.numChannels = frames -> numChannels,
+		.numFrames   = frames -> numFrames,
+	};
+
+	appendBytes (data, & header, sizeof (header));
+	appendBytes (data, frames -> frames, (NSUInteger) header.numFrames * header.numChannels * sizeof (BKFrame));
+}
+
+static BOOL readFrames (BKCArchiveReader * reader, BKData * data)
+{
+	BKCArchiveFrames const * header = readBytes (reader, sizeof (BKCArchiveFrames));
+	BKFrame const * frames;
+
+	if (header == NULL || header -> numChannels == 0) {
+		return NO;
+	}
+
+	if ((frames = readBytes (reader, (NSUInteger) header -> numFrames * header -> numChannels * sizeof (BKFrame))) == NULL) {
+		return NO;
+	}
+
+	// reference mapped frames
+	return BKDataSetFrames (data, frames, header -> numFrames, header -> numChannels, NO) >= 0;
+}
+
+static void appendInstrument (NSMutableData * data, BKInstrument const * instr)
+{
+	for (BKInt slot = 0; slot < BK_MAX_SEQUENCES; slot ++) {
+		BKSequence const * sequence = BKInstrumentGetSequence (instr, slot);
+		BKCArchiveSequence header = {0};
+		NSUInteger valueSize = 0;
+
+		if (sequence) {
+			header.format        = sequence -> funcs == & BKSequenceFuncsEnvelope ? 2 : 1;
+			header.length        = sequence -> length;
+			header.sustainOffset = sequence -> sustainOffset;
+			header.sustainLength = sequence -> sustainEnd - sequence -> sustainOffset;
+			valueSize            = header.format == 2 ? sizeof (BKSequencePhase) : sizeof (BKInt);
+		}
+
+		appendBytes (data, & header, sizeof (header));
+
+		if (sequence) {
+			appendBytes (data, sequence -> values, header.length * valueSize);
+		}
+	}
+}
+
+static BOOL readInstrument (BKCArchiveReader * reader, BKInstrument * instr)
+{
+	for (BKInt slot = 0; slot < BK_MAX_SEQUENCES; slot ++) {
+		BKCArchiveSequence const * header = readBytes (reader, sizeof (BKCArchiveSequence));
+		void const * values;
+		BKInt res;
+
+		if (header == NULL || header -> length < 0) {
+			return NO;
+		}
+
+		if (header -> format == 0) {
+			continue;
+		}
+
+		if ((values = readBytes (reader, header -> length * (header -> format == 2 ? sizeof (BKSequencePhase) : sizeof (BKInt)))) == NULL) {
+			return NO;
+		}
+
+		if (header -> format == 2) {
+			res = BKInstrumentSetEnvelope (instr, slot, values, header -> length, header -> sustainOffset, header -> sustainLength);
+		}
+		else {
+			res = BKInstrumentSetSequence (instr, slot, values, header -> length, header -> sustainOffset, header -> sustainLength);
+		}
+
+		if (res < 0) {
+			return NO;
+		}
+	}
+
+	return YES;
+}
+
+/**
+ * Collect addresses of all objects which commands can point to
+ *
+ * Targets are sorted by address
+ */
+static NSData * collectTargets (BKTKCompiler const * compiler, NSArray * instruments, NSArray * waveforms, NSArray * samples)
+{
+	NSMutableData * targets = [[NSMutableData alloc] init];
+	NSUInteger numTracks = compiler -> tracks.len + 1;
+
+	void (^ addTarget) (void const *, BKCArchiveObject, NSUInteger, NSUInteger) = ^(void const * pointer, BKCArchiveObject object, NSUInteger index, NSUInteger subIndex) {
+		BKCArchiveTarget target = {
+			.pointer = pointer,
+			.target  = {
+				.object   = object,
+				.index    = (UInt32) index,
+				.subIndex = (UInt32) subIndex,
+			},
+		};
+
+		[targets appendBytes:& target length:sizeof (target)];
+	};
+
+	for (NSUInteger i = 0; i < instruments.count; i ++) {
+		BKTKInstrument * instr = [instruments [i] pointerValue];
+
+		addTarget (instr, BKCArchiveObjectInstrument, i, 0);
+		addTarget (& instr -> instr, BKCArchiveObjectInstrumentData, i, 0);
+	}
+
+	for (NSUInteger i = 0; i < waveforms.count; i ++) {
+		BKTKWaveform * waveform = [waveforms [i] pointerValue];
+
+		addTarget (waveform, BKCArchiveObjectWaveform, i, 0);
+		addTarget (& waveform -> data, BKCArchiveObjectWaveformData, i, 0);
+	}
+
+	for (NSUInteger i = 0; i < samples.count; i ++) {
+		BKTKSample * sample = [samples [i] pointerValue];
+
+		addTarget (sample, BKCArchiveObjectSample, i, 0);
+		addTarget (& sample -> data, BKCArchiveObjectSampleData, i, 0);
+	}
+
+	for (NSUInteger i = 0; i < numTracks; i ++) {
+		BKTKCompilerTrack * track = compilerTrack (compiler, i);
+
+		addTarget (track, BKCArchiveObjectTrack, i, 0);
+
+		for (NSUInteger g = 0; g <= track -> cmdGroups.len; g ++) {
+			addTarget (commandBuffer (track, g), BKCArchiveObjectCommands, i, g);
+		}
+	}
+
+	qsort (targets.mutableBytes, targets.length / sizeof (BKCArchiveTarget), sizeof (BKCArchiveTarget), compareTargets);
+
+	return targets;
+}
+
+static NSData * collectCompilerTargets (BKTKCompiler const * compiler)
+{
+	NSArray * instruments = hashTableItems (& compiler -> instruments, nil);
+	NSArray * waveforms = hashTableItems (& compiler -> waveforms, nil);
+	NSArray * samples = hashTableItems (& compiler -> samples, nil);
+
+	return collectTargets (compiler, instruments, waveforms, samples);
+}
+
+/**
+ * Object whose address is stored at `bytes`
+ */
+static BKCArchiveTarget const * findTarget (NSData * targets, UInt8 const * bytes)
+{
+	BKCArchiveTarget key = {0};
+
+	memcpy (& key.pointer, bytes, sizeof (void *));
+
+	return bsearch (& key, targets.bytes, targets.length / sizeof (BKCArchiveTarget), sizeof (BKCArchiveTarget), compareTargets);
+}
+
+static BOOL isSameTarget (BKCArchiveTarget const * a, BKCArchiveTarget const * b)
+{
+	return a -> target.object == b -> target.object && a -> target.index == b -> target.index && a -> target.subIndex == b -> target.subIndex;
+}
+
+/**
+ * Find offsets of pointers in a command buffer
+ *
+ * Both buffers were compiled from the same parse tree, so they only differ
+ * in object addresses. Every differing byte has to be part of a word which
+ * points to the same object in both buffers; returns nil otherwise.
+ */
+static NSData * findPointers (BKByteBuffer * buffer, NSData * targets, BKByteBuffer * shadowBuffer, NSData * shadowTargets)
+{
+	NSUInteger size = BKByteBufferSize (buffer);
+	NSMutableData * bytes = [[NSMutableData alloc] initWithLength:size];
+	NSMutableData * shadowBytes = [[NSMutableData alloc] initWithLength:size];
+	NSMutableData * offsets = [[NSMutableData alloc] init];
+	UInt8 const * a = bytes.bytes;
+	UInt8 const * b = shadowBytes.bytes;
+	NSUInteger end = 0;
+
+	if (BKByteBufferSize (shadowBuffer) != size || size > UINT32_MAX) {
+		return nil;
+	}
+
+	BKByteBufferCopy (buffer, bytes.mutableBytes);
+	BKByteBufferCopy (shadowBuffer, shadowBytes.mutableBytes);
+
+	for (NSUInteger offset = 0; offset < size; offset ++) {
+		NSUInteger start = offset >= sizeof (void *) - 1 ? offset - (sizeof (void *) - 1) : 0;
+		BOOL found = NO;
+
+		if (a [offset] == b [offset]) {
+			continue;
+		}
+
+		// leading bytes of both addresses may be equal
+		for (start = MAX (start, end); start <= offset && start + sizeof (void *) <= size; start ++) {
+			BKCArchiveTarget const * target = findTarget (targets, & a [start]);
+			BKCArchiveTarget const * shadowTarget = findTarget (shadowTargets, & b [start]);
+
+			if (target && shadowTarget && isSameTarget (target, shadowTarget)) {
+				UInt32 pointerOffset = (UInt32) start;
+
+				[offsets appendBytes:& pointerOffset length:sizeof (pointerOffset)];
+				end    = start + sizeof (void *);
+				offset = end - 1;
+				found  = YES;
+				break;
+			}
+		}
+
+		if (!found) {
+			return nil;
+		}
+	}
+
+	return offsets;
+}
+
+NSArray * BKCProgramFindCommandPointers (BKTKCompiler const * compiler, BKTKCompiler const * shadow)
+{
+	NSMutableArray * pointers = [[NSMutableArray alloc] init];
+	NSData * targets = collectCompilerTargets (compiler);
+	NSData * shadowTargets = collectCompilerTargets (shadow);
+	NSUInteger numTracks = compiler -> tracks.len + 1;
+
+	if (shadow -> tracks.len != compiler -> tracks.len || shadowTargets.length != targets.length) {
+		return nil;
+	}
+
+	for (NSUInteger i = 0; i < numTracks; i ++) {
+		BKTKCompilerTrack * track = compilerTrack (compiler, i);
+		BKTKCompilerTrack * shadowTrack = compilerTrack (shadow, i);
+
+		if (shadowTrack -> cmdGroups.len != track -> cmdGroups.len) {
+			return nil;
+		}
+
+		for (NSUInteger g = 0; g <= track -> cmdGroups.len; g ++) {
+			NSData * offsets = findPointers (commandBuffer (track, g), targets, commandBuffer (shadowTrack, g), shadowTargets);
+
+			if (offsets == nil) {
+				return nil;
+			}
+
+			[pointers addObject:offsets];
+		}
+	}
+
+	return pointers;
+}
+
+/**
+ * Append command buffer and the targets of its pointers
+ *
+ * `offsets` are the pointer positions recorded by the compiler. Returns NO
+ * if one of them doesn't point to an archived object.
+ */
+static BOOL appendCommands (NSMutableData * data, BKByteBuffer * buffer, NSData * offsets, NSData * targets)
+{
+	UInt32 size = (UInt32) BKByteBufferSize (buffer);
+	NSMutableData * bytes = [[NSMutableData alloc] initWithLength:size];
+	NSMutableData * relocations = [[NSMutableData alloc] init];
+	UInt32 const * pointerOffsets = offsets.bytes;
+	UInt32 numRelocations = (UInt32) (offsets.length / sizeof (UInt32));
+
+	BKByteBufferCopy (buffer, bytes.mutableBytes);
+
+	for (UInt32 r = 0; r < numRelocations; r ++) {
+		BKCArchiveTarget const * target = NULL;
+		BKCArchiveRelocation relocation;
+
+		if ((NSUInteger) pointerOffsets [r] + sizeof (void *) <= size) {
+			target = findTarget (targets, (UInt8 const *) bytes.bytes + pointerOffsets [r]);
+		}
+
+		if (target == NULL) {
+			return NO;
+		}
+
+		relocation        = target -> target;
+		relocation.offset = pointerOffsets [r];
+		[relocations appendBytes:& relocation length:sizeof (relocation)];
+	}
+
+	appendBytes (data, & size, sizeof (size));
+	appendBytes (data, & numRelocations, sizeof (numRelocations));
+	appendBytes (data, relocations.bytes, relocations.length);
+	appendBytes (data, bytes.bytes, size);
+
+	return YES;
+}
+
+@implementation BKCProgram (BKCProgramArchive)
+
+- (NSData *)archivedDataWithError:(NSError **)error
+{
+	BKCArchiveHeader header = {0};
+	NSMutableArray * instrumentNames = [[NSMutableArray alloc] init];
+	NSMutableArray * waveformNames = [[NSMutableArray alloc] init];
+	NSMutableArray * sampleNames = [[NSMutableArray alloc] init];
+	NSArray * instruments = hashTableItems (& compiler -> instruments, instrumentNames);
+	NSArray * waveforms = hashTableItems (& compiler -> waveforms, waveformNames);
+	NSArray * samples = hashTableItems (& compiler -> samples, sampleNames);
+	NSUInteger numTracks = compiler -> tracks.len + 1;
+	NSMutableData * data = [[NSMutableData alloc] init];
+	NSData * targets;
+	NSUInteger bufferIndex = 0;
+
+	if (commandPointers == nil) {
+		if (error) {
+			*error = archiveError (EINVAL, @"Pointers in commands weren't recorded by the compiler");
+		}
+
+		return nil;
+	}
+
+	if (numTracks > UINT32_MAX) {
+		if (error) {
+			*error = archiveError (EOVERFLOW, @"Too many tracks to archive");
+		}
+
+		return nil;
+	}
+
+	memcpy (header.magic, ARCHIVE_MAGIC, sizeof (header.magic));
+	header.version        = BKC_PROGRAM_ARCHIVE_VERSION;
+	header.byteOrder      = ARCHIVE_BYTE_ORDER;
+	header.pointerSize    = sizeof (void *);
+	header.intSize        = sizeof (BKInt);
+	header.numInstruments = (UInt32) instruments.count;
+	header.numWaveforms   = (UInt32) waveforms.count;
+	header.numSamples     = (UInt32) samples.count;
+	header.numTracks      = (UInt32) numTracks;
+
+	appendBytes (data, & header, sizeof (header));
+
+	for (NSUInteger i = 0; i < instruments.count; i ++) {
+		appendName (data, [instrumentNames [i] pointerValue]);
+		appendInstrument (data, & ((BKTKInstrument *) [instruments [i] pointerValue]) -> instr);
+	}
+
+	for (NSUInteger i = 0; i < waveforms.count; i ++) {
+		appendName (data, [waveformNames [i] pointerValue]);
+		appendFrames (data, & ((BKTKWaveform *) [waveforms [i] pointerValue]) -> data);
+	}
+
+	for (NSUInteger i = 0; i < samples.count; i ++) {
+		appendName (data, [sampleNames [i] pointerValue]);
+		appendFrames (data, & ((BKTKSample *) [samples [i] pointerValue]) -> data);
+	}
+
+	targets = collectTargets (compiler, instruments, waveforms, samples);
+
+	for (NSUInteger i = 0; i < numTracks; i ++) {
+		BKTKCompilerTrack * track = compilerTrack (compiler, i);
+		UInt32 numBuffers = (UInt32) track -> cmdGroups.len + 1;
+
+		appendBytes (data, & numBuffers, sizeof (numBuffers));
+
+		for (NSUInteger g = 0; g < numBuffers; g ++) {
+			NSData * offsets = bufferIndex < commandPointers.count ? commandPointers [bufferIndex ++] : nil;
+
+			if (offsets == nil || !appendCommands (data, commandBuffer (track, g), offsets, targets)) {
+				if (error) {
+					*error = archiveError (EINVAL, @"Commands contain pointers which can't be archived");
+				}
+
+				return nil;
+			}
+		}
+	}
+
+	return data;
+}
+
+/**
+ * Address of relocation target in loaded compiler
+ */
+static void * relocationTarget (BKTKCompiler * compiler, BKCArchiveRelocation const * relocation, void * const * instruments, void * const * waveforms, void * const * samples, BKCArchiveHeader const * header)
+{
+	BKTKCompilerTrack * track;
+
+	switch (relocation -> object) {
+		case BKCArchiveObjectInstrument:
+		case BKCArchiveObjectInstrumentData: {
+			if (relocation -> index >= header -> numInstruments) {
+				return NULL;
+			}
+
+			BKTKInstrument * instr = instruments [relocation -> index];
+
+			return relocation -> object == BKCArchiveObjectInstrument ? (void *) instr : (void *) & instr -> instr;
+		}
+		case BKCArchiveObjectWaveform:
+		case BKCArchiveObjectWaveformData: {
+			if (relocation -> index >= header -> numWaveforms) {
+				return NULL;
+			}
+
+			BKTKWaveform * waveform = waveforms [relocation -> index];
+
+			return relocation -> object == BKCArchiveObjectWaveform ? (void *) waveform : (void *) & waveform -> data;
+		}
+		case BKCArchiveObjectSample:
+		case BKCArchiveObjectSampleData: {
+			if (relocation -> index >= header -> numSamples) {
+				return NULL;
+			}
+
+			BKTKSample * sample = samples [relocation -> index];
+
+			return relocation -> object == BKCArchiveObjectSample ? (void *) sample : (void *) & sample -> data;
+		}
+		case BKCArchiveObjectTrack:
+		case BKCArchiveObjectCommands: {
+			// tracks are created before commands are relocated
+			if (relocation -> index > compiler -> tracks.len) {
+				return NULL;
+			}
+
+			track = compilerTrack (compiler, relocation -> index);
+
+			if (relocation -> object == BKCArchiveObjectTrack) {
+				return track;
+			}
+
+			return relocation -> subIndex <= track -> cmdGroups.len ? commandBuffer (track, relocation -> subIndex) : NULL;
+		}
+		default: {
+			return NULL;
+		}
+	}
+}
+
+/**
+ * Create tracks and their empty command buffers
+ */
+static BOOL createTracks (BKTKCompiler * compiler, BKCArchiveReader reader, UInt32 numTracks)
+{
+	for (UInt32 i = 0; i < numTracks; i ++) {
+		UInt32 const * numBuffers = readBytes (& reader, sizeof (UInt32));
+		BKTKCompilerTrack * track = NULL;
+
+		if (numBuffers == NULL || * numBuffers == 0) {
+			return NO;
+		}
+
+		if (i == 0) {
+			track = compilerTrack (compiler, 0);
+		}
+		else if (BKTKCompilerTrackAlloc (& track) < 0 || BKArrayPush (& compiler -> tracks, & track) < 0) {
+			return NO;
+		}
+
+		for (UInt32 g = 1; g < * numBuffers; g ++) {
+			BKByteBuffer * buffer = NULL;
+
+			if (BKByteBufferAlloc (& buffer, 0) < 0 || BKArrayPush (& track -> cmdGroups, & buffer) < 0) {
+				return NO;
+			}
+		}
+
+		// skip commands
+		for (UInt32 g = 0; g < * numBuffers; g ++) {
+			UInt32 const * size = readBytes (& reader, sizeof (UInt32));
+			UInt32 const * numRelocations = readBytes (& reader, sizeof (UInt32));
+
+			if (size == NULL || numRelocations == NULL) {
+				return NO;
+			}
+
+			if (readBytes (& reader, (NSUInteger) * numRelocations * sizeof (BKCArchiveRelocation)) == NULL) {
+				return NO;
+			}
+
+			if (readBytes (& reader, * size) == NULL) {
+				return NO;
+			}
+		}
+	}
+
+	return YES;
+}
+
++ (instancetype)programWithContentsOfArchiveFile:(NSString *)path error:(NSError **)error
+{
+	NSData * data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedAlways error:error];
+
+	if (data == nil) {
+		return nil;
+	}
+
+	return [self programWithArchiveData:data error:error];
+}
+
++ (instancetype)programWithArchiveData:(NSData *)data error:(NSError **)error
+{
+	BKCArchiveReader reader = {
+		.bytes = data.bytes,
+		.size  = data.length,
+	};
+	BKCArchiveHeader const * header = readBytes (& reader, sizeof (BKCArchiveHeader));
+	BKTKCompiler * compiler;
+	BKCProgram * program;
+	NSMutableData * objects;
+	void ** instruments, ** waveforms, ** samples;
+	NSMutableArray * pointers = [[NSMutableArray alloc] init];
+	NSString * failure = nil;
+
+	if (header == NULL || memcmp (header -> magic, ARCHIVE_MAGIC, sizeof (header -> magic)) != 0) {
+		if (error) {
+			*error = archiveError (EINVAL, @"Data is not a program archive");
+		}
+
+		return nil;
+	}
+
+	if (header -> version != BKC_PROGRAM_ARCHIVE_VERSION || header -> byteOrder != ARCHIVE_BYTE_ORDER || header -> pointerSize != sizeof (void *) || header -> intSize != sizeof (BKInt)) {
+		if (error) {
+			*error = archiveError (EINVAL, @"Program archive was created for another version or architecture");
+		}
+
+		return nil;
+	}
+
+	compiler = malloc (sizeof (*compiler));
+
+	if (compiler == NULL || BKTKCompilerInit (compiler) != 0) {
+		free (compiler);
+
+		if (error) {
+			*error = archiveError (ENOMEM, @"Couldn't allocate compiler");
+		}
+
+		return nil;
+	}
+
+	// owns the compiler from now on
+	program = [[self alloc] initWithCompiler:compiler];
+	program -> mappedData = data;
+
+	objects     = [[NSMutableData alloc] initWithLength:((NSUInteger) header -> numInstruments + header -> numWaveforms + header -> numSamples) * sizeof (void *)];
+	instruments = objects.mutableBytes;
+	waveforms   = instruments + header -> numInstruments;
+	samples     = waveforms + header -> numWaveforms;
+
+	for (UInt32 i = 0; i < header -> numInstruments && failure == nil; i ++) {
+		char const * name = readName (& reader);
+		BKTKInstrument * instr = NULL;
+
+		if (name == NULL || BKTKInstrumentAlloc (& instr) < 0) {
+			failure = @"Invalid instrument";
+		}
+		else if (BKHashTableSet (& compiler -> instruments, name, instr) < 0 || !readInstrument (& reader, & instr -> instr)) {
+			failure = @"Invalid instrument";
+		}
+
+		instruments [i] = instr;
+	}
+
+	for (UInt32 i = 0; i < header -> numWaveforms && failure == nil; i ++) {
+		char const * name = readName (& reader);
+		BKTKWaveform * waveform = NULL;
+
+		if (name == NULL || BKTKWaveformAlloc (& waveform) < 0) {
+			failure = @"Invalid waveform";
+		}
+		else if (BKHashTableSet (& compiler -> waveforms, name, waveform) < 0 || !readFrames (& reader, & waveform -> data)) {
+			failure = @"Invalid waveform";
+		}
+
+		waveforms [i] = waveform;
+	}
+
+	for (UInt32 i = 0; i < header -> numSamples && failure == nil; i ++) {
+		char const * name = readName (& reader);
+		BKTKSample * sample = NULL;
+
+		if (name == NULL || BKTKSampleAlloc (& sample) < 0) {
+			failure = @"Invalid sample";
+		}
+		else if (BKHashTableSet (& compiler -> samples, name, sample) < 0 || !readFrames (& reader, & sample -> data)) {
+			failure = @"Invalid sample";
+		}
+
+		samples [i] = sample;
+	}
+
+	// commands can point to any track or buffer
+	if (failure == nil && (header -> numTracks == 0 || !createTracks (compiler, reader, header -> numTracks))) {
+		failure = @"Invalid tracks";
+	}
+
+	// sizes are validated by createTracks
+	for (UInt32 i = 0; i < header -> numTracks && failure == nil; i ++) {
+		BKTKCompilerTrack * track = compilerTrack (compiler, i);
+		UInt32 const * numBuffers = readBytes (& reader, sizeof (UInt32));
+
+		for (UInt32 g = 0; g < * numBuffers && failure == nil; g ++) {
+			UInt32 const * size = readBytes (& reader, sizeof (UInt32));
+			UInt32 const * numRelocations = readBytes (& reader, sizeof (UInt32));
+			BKCArchiveRelocation const * relocations = readBytes (& reader, (NSUInteger) * numRelocations * sizeof (BKCArchiveRelocation));
+			NSMutableData * commands = [[NSMutableData alloc] initWithBytes:readBytes (& reader, * size) length:* size];
+			NSMutableData * offsets = [[NSMutableData alloc] initWithCapacity:* numRelocations * sizeof (UInt32)];
+
+			for (UInt32 r = 0; r < * numRelocations; r ++) {
+				void * target = relocationTarget (compiler, & relocations [r], instruments, waveforms, samples, header);
+
+				if (target == NULL || (NSUInteger) relocations [r].offset + sizeof (void *) > * size) {
+					failure = @"Invalid command reference";
+					break;
+				}
+
+				memcpy ((UInt8 *) commands.mutableBytes + relocations [r].offset, & target, sizeof (void *));
+				[offsets appendBytes:& relocations [r].offset length:sizeof (UInt32)];
+			}
+
+			[pointers addObject:offsets];
+
+			if (failure == nil && BKByteBufferAppend (commandBuffer (track, g), commands.bytes, * size) < 0) {
+				failure = @"Couldn't allocate commands";
+			}
+		}
+	}
+
+	if (failure) {
+		if (error) {
+			*error = archiveError (EINVAL, failure);
+		}
+
+		return nil;
+	}
+
+	// allows archiving the program again
+	program -> commandPointers = pointers;
+
+	return program;
+}
+
+- (BOOL)isMapped
+{
+	return mappedData != nil;
+}
+
+@end
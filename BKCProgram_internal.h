@@ -0,0 +1,63 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import "BKCProgram.h"
+#import "BKTKContext.h"
+
+@interface BKCProgram ()
+
+/**
+ * Take ownership of a compiled and heap allocated compiler
+ *
+ * The compiler is disposed and freed when the program is deallocated
+ */
+- (instancetype)initWithCompiler:(BKTKCompiler *)compiler;
+
+/**
+ * Take ownership of a compiled and heap allocated compiler
+ *
+ * `pointers` are the positions of object addresses in the command buffers
+ * as returned by BKCProgramFindCommandPointers; they are needed to archive
+ * the program
+ */
+- (instancetype)initWithCompiler:(BKTKCompiler *)compiler commandPointers:(NSArray *)pointers;
+
+/**
+ * Create parser context from the compiled data
+ *
+ * Returns the program whose data the context refers to; it has to be kept
+ * alive as long as the context is used. Returns nil on failure.
+ */
+- (BKCProgram *)instantiateParserContext:(BKTKContext *)ctx;
+
+@end
+
+/**
+ * Find positions of object addresses in the command buffers of `compiler`
+ *
+ * `shadow` has to be compiled from the same parse tree. Returns an NSData of
+ * UInt32 offsets for each command buffer, ordered by track and the global
+ * commands first, or nil if the buffers differ in anything but the
+ * addresses of instruments, waveforms, samples, tracks and command buffers.
+ */
+extern NSArray * BKCProgramFindCommandPointers (BKTKCompiler const * compiler, BKTKCompiler const * shadow);
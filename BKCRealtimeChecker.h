@@ -0,0 +1,123 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Enables real-time checks
+ *
+ * Define as 1 in debug builds to intercept allocations, contended locks and
+ * file I/O made by threads in a real-time section. Interception is done by
+ * wrapping the default malloc zone and interposing lock and I/O functions
+ * on Apple platforms, and by overriding the libc functions on Linux. On
+ * Linux, the offline render path can be checked headless, as the context
+ * builds without the audio unit when BKC_AUDIO_UNIT is 0 and render clocks
+ * use CLOCK_MONOTONIC; the GNUmakefile builds blipcompile with checks when
+ * REALTIME_CHECKS=1 is given.
+ */
+#ifndef BKC_REALTIME_CHECKS
+#define BKC_REALTIME_CHECKS 0
+#endif
+
+/**
+ * Kinds of operations not allowed in a real-time section
+ */
+typedef NS_ENUM(NSInteger, BKCRealtimeViolation)
+{
+	BKCRealtimeViolationAllocation,
+	BKCRealtimeViolationDeallocation,
+	BKCRealtimeViolationLockWait,
+	BKCRealtimeViolationFileIO,
+	BKCRealtimeViolationCount,
+};
+
+/**
+ * Mark the span of a real-time section on the current thread
+ *
+ * Sections can be nested. Compile to nothing without BKC_REALTIME_CHECKS.
+ */
+#if BKC_REALTIME_CHECKS
+#define BKC_REALTIME_SECTION_BEGIN() BKCRealtimeSectionBegin ()
+#define BKC_REALTIME_SECTION_END() BKCRealtimeSectionEnd ()
+#else
+#define BKC_REALTIME_SECTION_BEGIN() ((void) 0)
+#define BKC_REALTIME_SECTION_END() ((void) 0)
+#endif
+
+/**
+ * Install interceptors
+ *
+ * Must be called before the first real-time section. Returns NO if checks
+ * are not compiled in or interceptors couldn't be installed.
+ */
+extern BOOL BKCRealtimeCheckerInstall (void);
+
+/**
+ * Enter real-time section on the current thread
+ */
+extern void BKCRealtimeSectionBegin (void);
+
+/**
+ * Leave real-time section on the current thread
+ */
+extern void BKCRealtimeSectionEnd (void);
+
+/**
+ * Check if the current thread is in a real-time section
+ */
+extern BOOL BKCRealtimeIsInSection (void);
+
+/**
+ * Record violation with backtrace if the current thread is in a real-time
+ * section
+ *
+ * Doesn't allocate. Identical backtraces are counted in the same record.
+ */
+extern void BKCRealtimeRecordViolation (BKCRealtimeViolation violation);
+
+/**
+ * Number of recorded violations of kind
+ */
+extern NSUInteger BKCRealtimeViolationCount (BKCRealtimeViolation violation);
+
+/**
+ * Number of recorded violations of all kinds
+ */
+extern NSUInteger BKCRealtimeTotalViolationCount (void);
+
+/**
+ * Name of violation kind
+ */
+extern char const * BKCRealtimeViolationName (BKCRealtimeViolation violation);
+
+/**
+ * Counts and symbolicated backtraces of recorded violations
+ *
+ * Must not be called in a real-time section
+ */
+extern NSString * BKCRealtimeReport (void);
+
+/**
+ * Clear recorded violations
+ */
+extern void BKCRealtimeReset (void);
@@ -0,0 +1,611 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE  // RTLD_NEXT
+#endif
+
+#import <execinfo.h>
+#import <stdatomic.h>
+#import "BKCRealtimeChecker.h"
+
+#if BKC_REALTIME_CHECKS
+#import <fcntl.h>
+#import <pthread.h>
+#import <stdarg.h>
+#import <sys/uio.h>
+#import <unistd.h>
+
+#ifdef __APPLE__
+#import <malloc/malloc.h>
+#import <mach/mach.h>
+#else
+#import <dlfcn.h>
+#endif
+#endif
+
+#define MAX_RECORDS 64
+#define MAX_FRAMES 24
+
+/**
+ * Violations with the same backtrace
+ */
+typedef struct
+{
+	BKCRealtimeViolation violation;
+	NSUInteger           count;
+	int                  numFrames;
+	void               * frames [MAX_FRAMES];
+} BKCRealtimeRecord;
+
+static char const * const violationNames [BKCRealtimeViolationCount] = {
+	"allocation", "deallocation", "lock wait", "file I/O",
+};
+
+static atomic_ulong violationCounts [BKCRealtimeViolationCount];
+static atomic_ulong numDropped;
+static atomic_flag recordLock = ATOMIC_FLAG_INIT;
+static BKCRealtimeRecord records [MAX_RECORDS];
+static NSUInteger numRecords;
+
+#if BKC_REALTIME_CHECKS
+
+// must not allocate when accessed first
+#ifdef __linux__
+#define THREAD_LOCAL _Thread_local __attribute__ ((tls_model ("initial-exec")))
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+static THREAD_LOCAL NSUInteger sectionDepth;
+static THREAD_LOCAL BOOL recording;
+
+#endif
+
+char const * BKCRealtimeViolationName (BKCRealtimeViolation violation)
+{
+	if (violation < 0 || violation >= BKCRealtimeViolationCount) {
+		return "unknown";
+	}
+
+	return violationNames [violation];
+}
+
+void BKCRealtimeSectionBegin (void)
+{
+#if BKC_REALTIME_CHECKS
+	sectionDepth ++;
+#endif
+}
+
+void BKCRealtimeSectionEnd (void)
+{
+#if BKC_REALTIME_CHECKS
+	if (sectionDepth) {
+		sectionDepth --;
+	}
+#endif
+}
+
+BOOL BKCRealtimeIsInSection (void)
+{
+#if BKC_REALTIME_CHECKS
+	return sectionDepth > 0;
+#else
+	return NO;
+#endif
+}
+
+#if BKC_REALTIME_CHECKS
+
+/**
+ * Add backtrace to matching record or to a new one
+ */
+static void addRecord (BKCRealtimeViolation violation, void * const * frames, int numFrames)
+{
+	BKCRealtimeRecord * record;
+
+	// doesn't block the scheduler like a mutex; violations are rare
+	while (atomic_flag_test_and_set_explicit (& recordLock, memory_order_acquire)) {
+	}
+
+	for (NSUInteger i = 0; i < numRecords; i ++) {
+		record = & records [i];
+
+		if (record -> violation == violation && record -> numFrames == numFrames && memcmp (record -> frames, frames, numFrames * sizeof (void *)) == 0) {
+			record -> count ++;
+			atomic_flag_clear_explicit (& recordLock, memory_order_release);
+			return;
+		}
+	}
+
+	if (numRecords < MAX_RECORDS) {
+		record = & records [numRecords ++];
+		record -> violation = violation;
+		record -> count     = 1;
+		record -> numFrames = numFrames;
+		memcpy (record -> frames, frames, numFrames * sizeof (void *));
+	}
+	else {
+		atomic_fetch_add_explicit (& numDropped, 1, memory_order_relaxed);
+	}
+
+	atomic_flag_clear_explicit (& recordLock, memory_order_release);
+}
+
+#endif
+
+void BKCRealtimeRecordViolation (BKCRealtimeViolation violation)
+{
+#if BKC_REALTIME_CHECKS
+	void * frames [MAX_FRAMES + 1];
+	int numFrames;
+
+	if (sectionDepth == 0 || recording || violation < 0 || violation >= BKCRealtimeViolationCount) {
+		return;
+	}
+
+	// backtrace may allocate itself
+	recording = YES;
+
+	atomic_fetch_add_explicit (& violationCounts [violation], 1, memory_order_relaxed);
+
+	// skip this function
+	numFrames = backtrace (frames, MAX_FRAMES + 1);
+	addRecord (violation, & frames [1], MAX (numFrames - 1, 0));
+
+	recording = NO;
+#endif
+}
+
+NSUInteger BKCRealtimeViolationCount (BKCRealtimeViolation violation)
+{
+	if (violation < 0 || violation >= BKCRealtimeViolationCount) {
+		return 0;
+	}
+
+	return atomic_load_explicit (& violationCounts [violation], memory_order_relaxed);
+}
+
+NSUInteger BKCRealtimeTotalViolationCount (void)
+{
+	NSUInteger count = 0;
+
+	for (NSInteger i = 0; i < BKCRealtimeViolationCount; i ++) {
+		count += BKCRealtimeViolationCount (i);
+	}
+
+	return count;
+}
+
+NSString * BKCRealtimeReport (void)
+{
+	char ** symbols;
+	NSMutableString * report = [[NSMutableString alloc] init];
+	NSMutableData * copy = [[NSMutableData alloc] initWithLength:sizeof (records)];
+	BKCRealtimeRecord * copiedRecords = copy.mutableBytes;
+	NSUInteger count;
+
+	[report appendString:@"Real-time violations:"];
+
+	for (NSInteger i = 0; i < BKCRealtimeViolationCount; i ++) {
+		[report appendFormat:@"%s %lu %s", i ? "," : "", (unsigned long) BKCRealtimeViolationCount (i), violationNames [i]];
+	}
+
+	[report appendString:@"\n"];
+
+	while (atomic_flag_test_and_set_explicit (& recordLock, memory_order_acquire)) {
+	}
+
+	count = numRecords;
+	memcpy (copiedRecords, records, count * sizeof (BKCRealtimeRecord));
+	atomic_flag_clear_explicit (& recordLock, memory_order_release);
+
+	for (NSUInteger i = 0; i < count; i ++) {
+		BKCRealtimeRecord const * record = & copiedRecords [i];
+
+		[report appendFormat:@"\n%lux %s\n", (unsigned long) record -> count, violationNames [record -> violation]];
+
+		if ((symbols = backtrace_symbols (record -> frames, record -> numFrames))) {
+			for (int f = 0; f < record -> numFrames; f ++) {
+				[report appendFormat:@"  %s\n", symbols [f]];
+			}
+
+			free (symbols);
+		}
+	}
+
+	if (atomic_load_explicit (& numDropped, memory_order_relaxed)) {
+		[report appendFormat:@"\n%lu backtraces not recorded\n", (unsigned long) atomic_load_explicit (& numDropped, memory_order_relaxed)];
+	}
+
+	return report;
+}
+
+void BKCRealtimeReset (void)
+{
+	while (atomic_flag_test_and_set_explicit (& recordLock, memory_order_acquire)) {
+	}
+
+	numRecords = 0;
+
+	for (NSInteger i = 0; i < BKCRealtimeViolationCount; i ++) {
+		atomic_store_explicit (& violationCounts [i], 0, memory_order_relaxed);
+	}
+
+	atomic_store_explicit (& numDropped, 0, memory_order_relaxed);
+	atomic_flag_clear_explicit (& recordLock, memory_order_release);
+}
+
+#if BKC_REALTIME_CHECKS
+
+/**
+ * Wait for mutex and record if it is contended
+ */
+static int lockMutex (pthread_mutex_t * mutex, int (* lock) (pthread_mutex_t *))
+{
+	int res;
+
+	if (sectionDepth == 0) {
+		return lock (mutex);
+	}
+
+	if ((res = pthread_mutex_trylock (mutex)) != EBUSY) {
+		return res;
+	}
+
+	BKCRealtimeRecordViolation (BKCRealtimeViolationLockWait);
+
+	return lock (mutex);
+}
+
+#ifdef __APPLE__
+
+/**
+ * Allocation checks
+ *
+ * Wrap the allocation functions of the default malloc zone
+ */
+static void * (* zoneMalloc) (malloc_zone_t *, size_t);
+static void * (* zoneCalloc) (malloc_zone_t *, size_t, size_t);
+static void * (* zoneValloc) (malloc_zone_t *, size_t);
+static void * (* zoneRealloc) (malloc_zone_t *, void *, size_t);
+static void * (* zoneMemalign) (malloc_zone_t *, size_t, size_t);
+static void (* zoneFree) (malloc_zone_t *, void *);
+static void (* zoneFreeDefiniteSize) (malloc_zone_t *, void *, size_t);
+
+static void * checkedMalloc (malloc_zone_t * zone, size_t size)
+{
+	BKCRealtimeRecordViolation (BKCRealtimeViolationAllocation);
+
+	return zoneMalloc (zone, size);
+}
+
+static void * checkedCalloc (malloc_zone_t * zone, size_t count, size_t size)
+{
+	BKCRealtimeRecordViolation (BKCRealtimeViolationAllocation);
+
+	return zoneCalloc (zone, count, size);
+}
+
+static void * checkedValloc (malloc_zone_t * zone, size_t size)
+{
+	BKCRealtimeRecordViolation (BKCRealtimeViolationAllocation);
+
+	return zoneValloc (zone, size);
+}
+
+static void * checkedRealloc (malloc_zone_t * zone, void * ptr, size_t size)
+{
+	BKCRealtimeRecordViolation (BKCRealtimeViolationAllocation);
+
+	return zoneRealloc (zone, ptr, size);
+}
+
+static void * checkedMemalign (malloc_zone_t * zone, size_t alignment, size_t size)
+{
+	BKCRealtimeRecordViolation (BKCRealtimeViolationAllocation);
+
+	return zoneMemalign (zone, alignment, size);
+}
+
+static void checkedFree (malloc_zone_t * zone, void * ptr)
+{
+	if (ptr) {
+		BKCRealtimeRecordViolation (BKCRealtimeViolationDeallocation);
+	}
+
+	zoneFree (zone, ptr);
+}
+
+static void checkedFreeDefiniteSize (malloc_zone_t * zone, void * ptr, size_t size)
+{
+	BKCRealtimeRecordViolation (BKCRealtimeViolationDeallocation);
+
+	zoneFreeDefiniteSize (zone, ptr, size);
+}
+
+static BOOL installAllocationChecks (void)
+{
+	malloc_zone_t * zone = malloc_default_zone ();
+
+	if (vm_protect (mach_task_self (), (vm_address_t) zone, sizeof (*zone), 0, VM_PROT_READ | VM_PROT_WRITE) != KERN_SUCCESS) {
+		return NO;
+	}
+
+	zoneMalloc  = zone -> malloc;
+	zoneCalloc  = zone -> calloc;
+	zoneValloc  = zone -> valloc;
+	zoneRealloc = zone -> realloc;
+	zoneFree    = zone -> free;
+
+	zone -> malloc  = checkedMalloc;
+	zone -> calloc  = checkedCalloc;
+	zone -> valloc  = checkedValloc;
+	zone -> realloc = checkedRealloc;
+	zone -> free    = checkedFree;
+
+	if (zone -> version >= 5 && zone -> memalign) {
+		zoneMemalign   = zone -> memalign;
+		zone -> memalign = checkedMemalign;
+	}
+
+	if (zone -> version >= 6 && zone -> free_definite_size) {
+		zoneFreeDefiniteSize     = zone -> free_definite_size;
+		zone -> free_definite_size = checkedFreeDefiniteSize;
+	}
+
+	vm_protect (mach_task_self (), (vm_address_t) zone, sizeof (*zone), 0, VM_PROT_READ);
+
+	return YES;
+}
+
+/**
+ * Lock and I/O checks
+ *
+ * Calls from this image are not interposed, so the replacements call the
+ * original functions directly
+ */
+#define INTERPOSE(replacement, replacee) \
+	__attribute__ ((used)) static struct { void const * replacement; void const * replacee; } interpose_##replacee \
+	__attribute__ ((section ("__DATA,__interpose"))) = {(void const *) & replacement, (void const *) & replacee};
+
+static int checkedMutexLock (pthread_mutex_t * mutex)
+{
+	return lockMutex (mutex, pthread_mutex_lock);
+}
+
+static ssize_t checkedRead (int fd, void * buffer, size_t size)
+{
+	BKCRealtimeRecordViolation (BKCRealtimeViolationFileIO);
+
+	return read (fd, buffer, size);
+}
+
+static ssize_t checkedWrite (int fd, void const * buffer, size_t size)
+{
+	BKCRealtimeRecordViolation (BKCRealtimeViolationFileIO);
+
+	return write (fd, buffer, size);
+}
+
+static ssize_t checkedWritev (int fd, struct iovec const * iov, int count)
+{
+	BKCRealtimeRecordViolation (BKCRealtimeViolationFileIO);
+
+	return writev (fd, iov, count);
+}
+
+static int checkedOpen (char const * path, int flags, ...)
+{
+	va_list args;
+	int mode = 0;
+
+	if (flags & O_CREAT) {
+		va_start (args, flags);
+		mode = va_arg (args, int);
+		va_end (args);
+	}
+
+	BKCRealtimeRecordViolation (BKCRealtimeViolationFileIO);
+
+	return open (path, flags, mode);
+}
+
+INTERPOSE (checkedMutexLock, pthread_mutex_lock)
+INTERPOSE (checkedRead, read)
+INTERPOSE (checkedWrite, write)
+INTERPOSE (checkedWritev, writev)
+INTERPOSE (checkedOpen, open)
+
+#elif defined (__linux__)
+
+/**
+ * Allocation, lock and I/O checks
+ *
+ * Override the libc functions and forward to their internal names
+ */
+extern void * __libc_malloc (size_t size);
+extern void * __libc_calloc (size_t count, size_t size);
+extern void * __libc_realloc (void * ptr, size_t size);
+extern void * __libc_memalign (size_t alignment, size_t size);
+extern void * __libc_valloc (size_t size);
+extern void * __libc_pvalloc (size_t size);
+extern void __libc_free (void * ptr);
+extern ssize_t __read (int fd, void * buffer, size_t size);
+extern ssize_t __write (int fd, void const * buffer, size_t size);
+extern int __open (char const * path, int flags, ...);
+
+void * malloc (size_t size)
+{
+	BKCRealtimeRecordViolation (BKCRealtimeViolationAllocation);
+
+	return __libc_malloc (size);
+}
+
+void * calloc (size_t count, size_t size)
+{
+	BKCRealtimeRecordViolation (BKCRealtimeViolationAllocation);
+
+	return __libc_calloc (count, size);
+}
+
+void * realloc (void * ptr, size_t size)
+{
+	BKCRealtimeRecordViolation (BKCRealtimeViolationAllocation);
+
+	return __libc_realloc (ptr, size);
+}
+
+void * memalign (size_t alignment, size_t size)
+{
+	BKCRealtimeRecordViolation (BKCRealtimeViolationAllocation);
+
+	return __libc_memalign (alignment, size);
+}
+
+int posix_memalign (void ** ptr, size_t alignment, size_t size)
+{
+	BKCRealtimeRecordViolation (BKCRealtimeViolationAllocation);
+
+	*ptr = __libc_memalign (alignment, size);
+
+	return *ptr ? 0 : ENOMEM;
+}
+
+void * aligned_alloc (size_t alignment, size_t size)
+{
+	BKCRealtimeRecordViolation (BKCRealtimeViolationAllocation);
+
+	return __libc_memalign (alignment, size);
+}
+
+void * valloc (size_t size)
+{
+	BKCRealtimeRecordViolation (BKCRealtimeViolationAllocation);
+
+	return __libc_valloc (size);
+}
+
+void * pvalloc (size_t size)
+{
+	BKCRealtimeRecordViolation (BKCRealtimeViolationAllocation);
+
+	return __libc_pvalloc (size);
+}
+
+void free (void * ptr)
+{
+	if (ptr) {
+		BKCRealtimeRecordViolation (BKCRealtimeViolationDeallocation);
+	}
+
+	__libc_free (ptr);
+}
+
+static int (* libcMutexLock) (pthread_mutex_t *);
+
+/**
+ * Call pthread_mutex_lock of libc
+ *
+ * glibc 2.34 and later don't export __pthread_mutex_lock for linking, so
+ * the next definition is looked up on first use. dlsym only takes internal
+ * locks of the loader.
+ */
+static int nextMutexLock (pthread_mutex_t * mutex)
+{
+	if (libcMutexLock == NULL) {
+		libcMutexLock = (int (*) (pthread_mutex_t *)) dlsym (RTLD_NEXT, "pthread_mutex_lock");
+	}
+
+	return libcMutexLock (mutex);
+}
+
+int pthread_mutex_lock (pthread_mutex_t * mutex)
+{
+	return lockMutex (mutex, nextMutexLock);
+}
+
+ssize_t read (int fd, void * buffer, size_t size)
+{
+	BKCRealtimeRecordViolation (BKCRealtimeViolationFileIO);
+
+	return __read (fd, buffer, size);
+}
+
+ssize_t write (int fd, void const * buffer, size_t size)
+{
+	BKCRealtimeRecordViolation (BKCRealtimeViolationFileIO);
+
+	return __write (fd, buffer, size);
+}
+
+int open (char const * path, int flags, ...)
+{
+	va_list args;
+	int mode = 0;
+
+	if (flags & O_CREAT) {
+		va_start (args, flags);
+		mode = va_arg (args, int);
+		va_end (args);
+	}
+
+	BKCRealtimeRecordViolation (BKCRealtimeViolationFileIO);
+
+	return __open (path, flags, mode);
+}
+
+#endif
+
+#endif
+
+BOOL BKCRealtimeCheckerInstall (void)
+{
+#if BKC_REALTIME_CHECKS
+	static BOOL installed = NO;
+	static dispatch_once_t once;
+
+	dispatch_once (& once, ^{
+		void * frames [MAX_FRAMES];
+
+		// load unwinder before the first section
+		backtrace (frames, MAX_FRAMES);
+
+#ifdef __APPLE__
+		installed = installAllocationChecks ();
+#elif defined (__linux__)
+		// resolve before the first section
+		pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+		pthread_mutex_lock (& mutex);
+		pthread_mutex_unlock (& mutex);
+		installed = libcMutexLock != NULL;
+#endif
+	});
+
+	return installed;
+#else
+	return NO;
+#endif
+}
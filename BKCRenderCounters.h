@@ -0,0 +1,125 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+#import <stdatomic.h>
+#import "BKCBase.h"
+
+/**
+ * Number of callback time histogram buckets
+ *
+ * Bucket i counts callbacks which took less than 2^(i+1) microseconds;
+ * the last bucket counts all longer callbacks
+ */
+#define BKC_RENDER_HISTOGRAM_SIZE 16
+
+/**
+ * Snapshot of render thread counters
+ */
+typedef struct
+{
+	UInt64         numberOfCallbacks;
+	UInt64         callbackTimeHistogram [BKC_RENDER_HISTOGRAM_SIZE];
+	NSTimeInterval totalCallbackTime;
+	NSTimeInterval maxCallbackTime;
+	UInt64         numberOfXruns;            // Callbacks which took longer than the duration of their buffer
+	NSTimeInterval lockWaitTime;
+	NSTimeInterval maxLockWaitTime;
+	UInt64         numberOfRequestedFrames;
+	UInt64         numberOfProducedFrames;
+	UInt64         numberOfZeroFilledFrames; // Requested frames which were filled with silence
+	UInt64         numberOfDividerCalls;
+	NSTimeInterval totalDividerTime;
+	NSTimeInterval maxDividerTime;
+} BKCRenderThreadStatistics;
+
+/**
+ * Counters written by the render thread
+ *
+ * Are only written by a single thread and can be read from any thread
+ * without locking. Times are in nanoseconds.
+ */
+typedef struct
+{
+	atomic_ullong numberOfCallbacks;
+	atomic_ullong callbackTimeHistogram [BKC_RENDER_HISTOGRAM_SIZE];
+	atomic_ullong totalCallbackTime;
+	atomic_ullong maxCallbackTime;
+	atomic_ullong numberOfXruns;
+	atomic_ullong lockWaitTime;
+	atomic_ullong maxLockWaitTime;
+	atomic_ullong numberOfRequestedFrames;
+	atomic_ullong numberOfProducedFrames;
+	atomic_ullong numberOfZeroFilledFrames;
+	atomic_ullong numberOfDividerCalls;
+	atomic_ullong totalDividerTime;
+	atomic_ullong maxDividerTime;
+} BKCRenderCounters;
+
+/**
+ * Monotonic time in nanoseconds
+ *
+ * Doesn't lock or allocate and can be used on the render thread
+ */
+extern UInt64 BKCRenderClockNow (void);
+
+/**
+ * Set all counters to 0
+ *
+ * Counts which are written at the same time may be lost
+ */
+extern void BKCRenderCountersReset (BKCRenderCounters * counters);
+
+/**
+ * Record a render callback
+ *
+ * An xrun is counted if `time` exceeds `deadline`
+ */
+extern void BKCRenderCountersAddCallback (BKCRenderCounters * counters, UInt64 time, UInt64 deadline);
+
+/**
+ * Record time spent waiting on a lock
+ */
+extern void BKCRenderCountersAddLockWait (BKCRenderCounters * counters, UInt64 time);
+
+/**
+ * Record requested and produced frames
+ */
+extern void BKCRenderCountersAddFrames (BKCRenderCounters * counters, UInt64 requested, UInt64 produced);
+
+/**
+ * Record frames filled with silence
+ */
+extern void BKCRenderCountersAddZeroFilledFrames (BKCRenderCounters * counters, UInt64 numFrames);
+
+/**
+ * Record a divider callback
+ */
+extern void BKCRenderCountersAddDivider (BKCRenderCounters * counters, UInt64 time);
+
+/**
+ * Add counter values to `statistics`
+ *
+ * Maximums are merged. The values are not read atomically as a whole.
+ */
+extern void BKCRenderCountersGetStatistics (BKCRenderCounters * counters, BKCRenderThreadStatistics * statistics);
@@ -0,0 +1,144 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifdef __APPLE__
+#import <mach/mach_time.h>
+#else
+#import <time.h>
+#endif
+#import "BKCRenderCounters.h"
+
+#ifdef __APPLE__
+static mach_timebase_info_data_t timebase;
+#endif
+
+static void updateMax (atomic_ullong * max, UInt64 value)
+{
+	// single writer; no compare-and-swap needed
+	if (value > atomic_load_explicit (max, memory_order_relaxed)) {
+		atomic_store_explicit (max, value, memory_order_relaxed);
+	}
+}
+
+static void add (atomic_ullong * counter, UInt64 value)
+{
+	atomic_fetch_add_explicit (counter, value, memory_order_relaxed);
+}
+
+static UInt64 load (atomic_ullong * counter)
+{
+	return atomic_load_explicit (counter, memory_order_relaxed);
+}
+
+UInt64 BKCRenderClockNow (void)
+{
+#ifdef __APPLE__
+	if (timebase.denom == 0) {
+		mach_timebase_info (& timebase);
+	}
+
+	return mach_absolute_time () * timebase.numer / timebase.denom;
+#else
+	struct timespec time;
+
+	clock_gettime (CLOCK_MONOTONIC, & time);
+
+	return (UInt64) time.tv_sec * 1000000000 + time.tv_nsec;
+#endif
+}
+
+void BKCRenderCountersReset (BKCRenderCounters * counters)
+{
+	atomic_ullong * values = (atomic_ullong *) counters;
+
+	for (NSUInteger i = 0; i < sizeof (*counters) / sizeof (atomic_ullong); i ++) {
+		atomic_store_explicit (& values [i], 0, memory_order_relaxed);
+	}
+}
+
+void BKCRenderCountersAddCallback (BKCRenderCounters * counters, UInt64 time, UInt64 deadline)
+{
+	NSUInteger bucket = 0;
+
+	for (UInt64 us = time / 1000; us > 1 && bucket < BKC_RENDER_HISTOGRAM_SIZE - 1; us >>= 1) {
+		bucket ++;
+	}
+
+	add (& counters -> numberOfCallbacks, 1);
+	add (& counters -> callbackTimeHistogram [bucket], 1);
+	add (& counters -> totalCallbackTime, time);
+	updateMax (& counters -> maxCallbackTime, time);
+
+	if (time > deadline) {
+		add (& counters -> numberOfXruns, 1);
+	}
+}
+
+void BKCRenderCountersAddLockWait (BKCRenderCounters * counters, UInt64 time)
+{
+	add (& counters -> lockWaitTime, time);
+	updateMax (& counters -> maxLockWaitTime, time);
+}
+
+void BKCRenderCountersAddFrames (BKCRenderCounters * counters, UInt64 requested, UInt64 produced)
+{
+	add (& counters -> numberOfRequestedFrames, requested);
+	add (& counters -> numberOfProducedFrames, produced);
+}
+
+void BKCRenderCountersAddZeroFilledFrames (BKCRenderCounters * counters, UInt64 numFrames)
+{
+	add (& counters -> numberOfZeroFilledFrames, numFrames);
+}
+
+void BKCRenderCountersAddDivider (BKCRenderCounters * counters, UInt64 time)
+{
+	add (& counters -> numberOfDividerCalls, 1);
+	add (& counters -> totalDividerTime, time);
+	updateMax (& counters -> maxDividerTime, time);
+}
+
+void BKCRenderCountersGetStatistics (BKCRenderCounters * counters, BKCRenderThreadStatistics * statistics)
+{
+	double const scale = 1e-9;
+
+	statistics -> numberOfCallbacks += load (& counters -> numberOfCallbacks);
+
+	for (NSUInteger i = 0; i < BKC_RENDER_HISTOGRAM_SIZE; i ++) {
+		statistics -> callbackTimeHistogram [i] += load (& counters -> callbackTimeHistogram [i]);
+	}
+
+	statistics -> totalCallbackTime += load (& counters -> totalCallbackTime) * scale;
+	statistics -> maxCallbackTime    = MAX (statistics -> maxCallbackTime, load (& counters -> maxCallbackTime) * scale);
+	statistics -> numberOfXruns     += load (& counters -> numberOfXruns);
+	statistics -> lockWaitTime      += load (& counters -> lockWaitTime) * scale;
+	statistics -> maxLockWaitTime    = MAX (statistics -> maxLockWaitTime, load (& counters -> maxLockWaitTime) * scale);
+
+	statistics -> numberOfRequestedFrames  += load (& counters -> numberOfRequestedFrames);
+	statistics -> numberOfProducedFrames   += load (& counters -> numberOfProducedFrames);
+	statistics -> numberOfZeroFilledFrames += load (& counters -> numberOfZeroFilledFrames);
+
+	statistics -> numberOfDividerCalls += load (& counters -> numberOfDividerCalls);
+	statistics -> totalDividerTime     += load (& counters -> totalDividerTime) * scale;
+	statistics -> maxDividerTime        = MAX (statistics -> maxDividerTime, load (& counters -> maxDividerTime) * scale);
+}
@@ -0,0 +1,134 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+#import <stdatomic.h>
+
+@class BKCContext;
+
+/**
+ * Fill level and underruns of the lookahead ring
+ */
+typedef struct
+{
+	NSUInteger depth;                   // Maximum number of frames generated ahead
+	NSUInteger fillLevel;               // Number of frames currently generated ahead
+	NSUInteger minimumFillLevel;        // Lowest fill level seen by the consumer
+	UInt64     numberOfUnderruns;       // Reads which found not enough frames
+	UInt64     numberOfUnderrunFrames;  // Frames filled with silence
+	UInt64     numberOfProducedFrames;
+} BKCLookaheadStatistics;
+
+/**
+ * Generates frames ahead of playback on a dedicated thread
+ *
+ * The producer thread generates output frames of the context into a
+ * lock-free single-producer/single-consumer ring until it contains `depth`
+ * frames. The audio unit's render callback only copies frames out of the
+ * ring, so spikes in synthesis cost are absorbed by the lookahead instead of
+ * causing glitches. Changes and events are applied `depth` frames before
+ * they are heard.
+ */
+@interface BKCRenderPipeline : NSObject
+{
+	__weak BKCContext * context;
+	SInt16            * frames;
+	SInt16            * chunkFrames;
+	NSUInteger          capacity;
+	NSUInteger          depth;
+	NSUInteger          chunkSize;
+	UInt32              numChannels;
+	atomic_ulong        writeIndex;
+	atomic_ulong        readIndex;
+	atomic_bool         running;
+	atomic_bool         flushRequested;
+	atomic_ulong        minFillLevel;
+	atomic_ullong       numUnderruns;
+	atomic_ullong       numUnderrunFrames;
+	atomic_ullong       numProducedFrames;
+	dispatch_semaphore_t spaceSemaphore;
+	dispatch_semaphore_t doneSemaphore;
+	NSThread          * thread;
+}
+
+/**
+ * Maximum number of frames generated ahead
+ */
+@property (readonly, nonatomic) NSUInteger depth;
+
+/**
+ * Number of frames generated at once by the producer thread
+ */
+@property (readonly, nonatomic) NSUInteger chunkSize;
+
+/**
+ * Check if the producer thread is running
+ */
+@property (readonly, nonatomic, getter=isRunning) BOOL running;
+
+/**
+ * Snapshot of fill level and underruns
+ *
+ * Can be read from any thread
+ */
+@property (readonly, nonatomic) BKCLookaheadStatistics statistics;
+
+/**
+ * Initialize with context and lookahead depth in frames
+ *
+ * `chunkSize` is rounded down to `depth` if larger.
+ */
+- (instancetype)initWithContext:(BKCContext *)context depth:(NSUInteger)depth chunkSize:(NSUInteger)chunkSize;
+
+/**
+ * Start producer thread
+ */
+- (void)start;
+
+/**
+ * Stop producer thread and wait until it has finished
+ */
+- (void)stop;
+
+/**
+ * Copy frames out of the ring
+ *
+ * Is called by the consumer, usually the audio unit's render callback.
+ * Missing frames are filled with silence and counted as underrun. Returns
+ * the number of frames copied from the ring.
+ */
+- (NSUInteger)readFrames:(SInt16 *)outFrames numberFrames:(NSUInteger)numberFrames;
+
+/**
+ * Discard all frames generated ahead
+ *
+ * Is applied by the consumer on its next read
+ */
+- (void)flush;
+
+/**
+ * Reset underrun counters and minimum fill level
+ */
+- (void)resetStatistics;
+
+@end
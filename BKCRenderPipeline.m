@@ -0,0 +1,233 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import "BKCRenderPipeline.h"
+#import "BKCContext_internal.h"
+
+@implementation BKCRenderPipeline
+
+@synthesize depth;
+@synthesize chunkSize;
+
+- (instancetype)initWithContext:(BKCContext *)theContext depth:(NSUInteger)theDepth chunkSize:(NSUInteger)theChunkSize
+{
+	if ((self = [super init])) {
+		if (theDepth == 0) {
+			NSLog (@"*** Lookahead depth must not be 0");
+			return nil;
+		}
+
+		context     = theContext;
+		depth       = theDepth;
+		chunkSize   = MAX (MIN (theChunkSize, theDepth), 1);
+		numChannels = theContext.numberOfChannels;
+		capacity    = 1;
+
+		while (capacity < depth) {
+			capacity <<= 1;
+		}
+
+		frames      = malloc (capacity * numChannels * sizeof (SInt16));
+		chunkFrames = malloc (chunkSize * numChannels * sizeof (SInt16));
+
+		if (frames == NULL || chunkFrames == NULL) {
+			NSLog (@"*** Couldn't allocate lookahead ring");
+			return nil;
+		}
+
+		atomic_init (& writeIndex, 0);
+		atomic_init (& readIndex, 0);
+		atomic_init (& running, NO);
+		atomic_init (& flushRequested, NO);
+		atomic_init (& minFillLevel, NSUIntegerMax);
+		atomic_init (& numUnderruns, 0);
+		atomic_init (& numUnderrunFrames, 0);
+		atomic_init (& numProducedFrames, 0);
+
+		spaceSemaphore = dispatch_semaphore_create (0);
+		doneSemaphore  = dispatch_semaphore_create (0);
+	}
+
+	return self;
+}
+
+- (void)dealloc
+{
+	if (frames) {
+		free (frames);
+	}
+
+	if (chunkFrames) {
+		free (chunkFrames);
+	}
+}
+
+- (BOOL)isRunning
+{
+	return atomic_load_explicit (& running, memory_order_acquire);
+}
+
+- (void)start
+{
+	if (atomic_exchange_explicit (& running, YES, memory_order_acq_rel)) {
+		return;
+	}
+
+	thread = [[NSThread alloc] initWithTarget:self selector:@selector(produce) object:nil];
+	thread.name = @"BKCRenderPipeline";
+	thread.qualityOfService = NSQualityOfServiceUserInteractive;
+	[thread start];
+}
+
+- (void)stop
+{
+	if (!atomic_exchange_explicit (& running, NO, memory_order_acq_rel)) {
+		return;
+	}
+
+	dispatch_semaphore_signal (spaceSemaphore);
+	dispatch_semaphore_wait (doneSemaphore, DISPATCH_TIME_FOREVER);
+	thread = nil;
+}
+
+/**
+ * Copy chunk into ring at `writeIdx`
+ */
+static void writeChunk (BKCRenderPipeline * self, NSUInteger writeIdx, NSUInteger numFrames)
+{
+	NSUInteger offset = writeIdx & (self -> capacity - 1);
+	NSUInteger size = MIN (numFrames, self -> capacity - offset);
+	NSUInteger frameSize = self -> numChannels * sizeof (SInt16);
+
+	memcpy (& self -> frames [offset * self -> numChannels], self -> chunkFrames, size * frameSize);
+
+	// wrap around
+	if (size < numFrames) {
+		memcpy (self -> frames, & self -> chunkFrames [size * self -> numChannels], (numFrames - size) * frameSize);
+	}
+}
+
+/**
+ * Body of the producer thread
+ */
+- (void)produce
+{
+	while (atomic_load_explicit (& running, memory_order_acquire)) {
+		@autoreleasepool {
+			BKInt res;
+			BKCContext * theContext = context;
+			NSUInteger writeIdx = atomic_load_explicit (& writeIndex, memory_order_relaxed);
+			NSUInteger fillLevel = writeIdx - atomic_load_explicit (& readIndex, memory_order_acquire);
+
+			if (theContext == nil) {
+				break;
+			}
+
+			// wait until the consumer has made space
+			if (fillLevel + chunkSize > depth) {
+				dispatch_semaphore_wait (spaceSemaphore, DISPATCH_TIME_FOREVER);
+				continue;
+			}
+
+			res = [theContext generateLookaheadFrames:chunkFrames numberFrames:(UInt32) chunkSize];
+
+			if (res < 0) {
+				NSLog (@"*** Couldn't generate lookahead frames: %d", res);
+				break;
+			}
+
+			writeChunk (self, writeIdx, chunkSize);
+			atomic_store_explicit (& writeIndex, writeIdx + chunkSize, memory_order_release);
+			atomic_fetch_add_explicit (& numProducedFrames, chunkSize, memory_order_relaxed);
+		}
+	}
+
+	dispatch_semaphore_signal (doneSemaphore);
+}
+
+- (NSUInteger)readFrames:(SInt16 *)outFrames numberFrames:(NSUInteger)numberFrames
+{
+	NSUInteger writeIdx = atomic_load_explicit (& writeIndex, memory_order_acquire);
+	NSUInteger readIdx = atomic_load_explicit (& readIndex, memory_order_relaxed);
+	NSUInteger fillLevel, numFrames, offset, size;
+
+	if (atomic_exchange_explicit (& flushRequested, NO, memory_order_acq_rel)) {
+		readIdx = writeIdx;
+	}
+
+	fillLevel = writeIdx - readIdx;
+	numFrames = MIN (fillLevel, numberFrames);
+	offset    = readIdx & (capacity - 1);
+	size      = MIN (numFrames, capacity - offset);
+
+	memcpy (outFrames, & frames [offset * numChannels], size * numChannels * sizeof (SInt16));
+
+	// wrap around
+	if (size < numFrames) {
+		memcpy (& outFrames [size * numChannels], frames, (numFrames - size) * numChannels * sizeof (SInt16));
+	}
+
+	atomic_store_explicit (& readIndex, readIdx + numFrames, memory_order_release);
+	dispatch_semaphore_signal (spaceSemaphore);
+
+	if (fillLevel < atomic_load_explicit (& minFillLevel, memory_order_relaxed)) {
+		atomic_store_explicit (& minFillLevel, fillLevel, memory_order_relaxed);
+	}
+
+	if (numFrames < numberFrames) {
+		memset (& outFrames [numFrames * numChannels], 0, (numberFrames - numFrames) * numChannels * sizeof (SInt16));
+		atomic_fetch_add_explicit (& numUnderruns, 1, memory_order_relaxed);
+		atomic_fetch_add_explicit (& numUnderrunFrames, numberFrames - numFrames, memory_order_relaxed);
+	}
+
+	return numFrames;
+}
+
+- (void)flush
+{
+	atomic_store_explicit (& flushRequested, YES, memory_order_release);
+}
+
+- (BKCLookaheadStatistics)statistics
+{
+	BKCLookaheadStatistics statistics;
+	NSUInteger minFill = atomic_load_explicit (& minFillLevel, memory_order_relaxed);
+
+	statistics.depth                  = depth;
+	statistics.fillLevel              = atomic_load_explicit (& writeIndex, memory_order_acquire) - atomic_load_explicit (& readIndex, memory_order_acquire);
+	statistics.minimumFillLevel       = minFill == NSUIntegerMax ? statistics.fillLevel : minFill;
+	statistics.numberOfUnderruns      = atomic_load_explicit (& numUnderruns, memory_order_relaxed);
+	statistics.numberOfUnderrunFrames = atomic_load_explicit (& numUnderrunFrames, memory_order_relaxed);
+	statistics.numberOfProducedFrames = atomic_load_explicit (& numProducedFrames, memory_order_relaxed);
+
+	return statistics;
+}
+
+- (void)resetStatistics
+{
+	atomic_store_explicit (& minFillLevel, NSUIntegerMax, memory_order_relaxed);
+	atomic_store_explicit (& numUnderruns, 0, memory_order_relaxed);
+	atomic_store_explicit (& numUnderrunFrames, 0, memory_order_relaxed);
+}
+
+@end
@@ -0,0 +1,131 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Trade-off between CPU usage and quality of the resampler
+ */
+typedef NS_ENUM(NSInteger, BKCResamplerQuality)
+{
+	BKCResamplerQualityLow,     // 8 taps; lowest CPU usage
+	BKCResamplerQualityMedium,  // 16 taps
+	BKCResamplerQualityHigh,    // 32 taps; steepest filter
+};
+
+/**
+ * Streaming polyphase resampler
+ *
+ * Converts interleaved frames between two fixed sample rates using a
+ * windowed sinc filter. The ratio of the rates is reduced to `L / M` and a
+ * filter phase is precalculated for each of the `L` output positions
+ * between two input frames. History is stored planar as float, so each
+ * output sample is a contiguous dot product which can be vectorized by the
+ * compiler.
+ *
+ * Doesn't allocate memory after initialization and can be used on the
+ * render thread.
+ */
+@interface BKCResampler : NSObject
+{
+	UInt32              inputSampleRate;
+	UInt32              outputSampleRate;
+	UInt32              numberOfChannels;
+	BKCResamplerQuality quality;
+	NSUInteger          capacity;
+	NSUInteger          upFactor;
+	NSUInteger          downFactor;
+	NSUInteger          numTaps;
+	float             * coefs;
+	float             * history;
+	NSUInteger          historyCapacity;
+	NSUInteger          historyLength;
+	NSUInteger          position;
+	NSUInteger          phase;
+}
+
+/**
+ * Sample rate of input frames
+ */
+@property (readonly, nonatomic) UInt32 inputSampleRate;
+
+/**
+ * Sample rate of output frames
+ */
+@property (readonly, nonatomic) UInt32 outputSampleRate;
+
+/**
+ * Number of interleaved channels
+ */
+@property (readonly, nonatomic) UInt32 numberOfChannels;
+
+/**
+ * The quality preset
+ */
+@property (readonly, nonatomic) BKCResamplerQuality quality;
+
+/**
+ * Maximum number of output frames per call of
+ * resampleFrames:numberFrames:outFrames:numberFrames:
+ */
+@property (readonly, nonatomic) NSUInteger capacity;
+
+/**
+ * Delay of output in input frames
+ */
+@property (readonly, nonatomic) NSUInteger latency;
+
+/**
+ * Initialize with sample rates
+ *
+ * Returns nil if the reduced ratio of the sample rates needs more than
+ * 2048 filter phases.
+ */
+- (instancetype)initWithInputSampleRate:(UInt32)inputSampleRate outputSampleRate:(UInt32)outputSampleRate numberOfChannels:(UInt32)numberOfChannels quality:(BKCResamplerQuality)quality capacity:(NSUInteger)capacity;
+
+/**
+ * Number of input frames needed to produce exactly `numberFrames` output
+ * frames
+ */
+- (NSUInteger)numberOfInputFramesForOutputFrames:(NSUInteger)numberFrames;
+
+/**
+ * Upper bound of numberOfInputFramesForOutputFrames: for `capacity` frames
+ */
+- (NSUInteger)maximumNumberOfInputFrames;
+
+/**
+ * Append input frames and produce output frames
+ *
+ * `inNumberFrames` should be the value returned by
+ * numberOfInputFramesForOutputFrames:. Returns the number of produced
+ * output frames.
+ */
+- (NSUInteger)resampleFrames:(SInt16 const *)inFrames numberFrames:(NSUInteger)inNumberFrames outFrames:(SInt16 *)outFrames numberFrames:(NSUInteger)outNumberFrames;
+
+/**
+ * Clear history
+ */
+- (void)reset;
+
+@end
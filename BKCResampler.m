@@ -0,0 +1,253 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import "BKCResampler.h"
+
+#define MAX_NUM_PHASES 2048
+
+/**
+ * Number of filter taps and cutoff relative to the lower Nyquist frequency
+ */
+static struct {
+	NSUInteger numTaps;
+	double     rolloff;
+} const qualityPresets [] = {
+	[BKCResamplerQualityLow]    = {8, 0.80},
+	[BKCResamplerQualityMedium] = {16, 0.88},
+	[BKCResamplerQualityHigh]   = {32, 0.93},
+};
+
+@implementation BKCResampler
+
+@synthesize inputSampleRate;
+@synthesize outputSampleRate;
+@synthesize numberOfChannels;
+@synthesize quality;
+@synthesize capacity;
+
+static NSUInteger greatestCommonDivisor (NSUInteger a, NSUInteger b)
+{
+	while (b) {
+		NSUInteger t = a % b;
+		a = b;
+		b = t;
+	}
+
+	return a;
+}
+
+static double sinc (double x)
+{
+	if (fabs (x) < 1e-9) {
+		return 1.0;
+	}
+
+	return sin (M_PI * x) / (M_PI * x);
+}
+
+/**
+ * Calculate a Blackman-Harris windowed sinc for every phase
+ *
+ * Phase `p` of output frame at window start `i` is centered between input
+ * frame `i + numTaps / 2 - 1` and the next one at `p / L`. The coefficients
+ * of each phase are normalized to unity gain.
+ */
+static void initCoefs (float * coefs, NSUInteger numPhases, NSUInteger numTaps, double cutoff)
+{
+	double half = numTaps / 2;
+
+	for (NSUInteger p = 0; p < numPhases; p ++) {
+		float * phaseCoefs = & coefs [p * numTaps];
+		double sum = 0.0;
+
+		for (NSUInteger j = 0; j < numTaps; j ++) {
+			double x = (double) j - (half - 1.0) - (double) p / numPhases;
+			double u = (x + half) / numTaps;
+			double w = 0.35875 - 0.48829 * cos (2.0 * M_PI * u) + 0.14128 * cos (4.0 * M_PI * u) - 0.01168 * cos (6.0 * M_PI * u);
+			double h = cutoff * sinc (cutoff * x) * w;
+
+			phaseCoefs [j] = h;
+			sum += h;
+		}
+
+		for (NSUInteger j = 0; j < numTaps; j ++) {
+			phaseCoefs [j] /= sum;
+		}
+	}
+}
+
+- (instancetype)initWithInputSampleRate:(UInt32)theInputSampleRate outputSampleRate:(UInt32)theOutputSampleRate numberOfChannels:(UInt32)theNumberOfChannels quality:(BKCResamplerQuality)theQuality capacity:(NSUInteger)theCapacity
+{
+	if ((self = [super init])) {
+		NSUInteger divisor;
+
+		if (theInputSampleRate == 0 || theOutputSampleRate == 0 || theNumberOfChannels == 0) {
+			NSLog (@"*** Invalid resampler format");
+			return nil;
+		}
+
+		theQuality = MAX (BKCResamplerQualityLow, MIN (theQuality, BKCResamplerQualityHigh));
+		divisor    = greatestCommonDivisor (theInputSampleRate, theOutputSampleRate);
+
+		inputSampleRate  = theInputSampleRate;
+		outputSampleRate = theOutputSampleRate;
+		numberOfChannels = theNumberOfChannels;
+		quality          = theQuality;
+		capacity         = MAX (theCapacity, 1);
+		upFactor         = theOutputSampleRate / divisor;
+		downFactor       = theInputSampleRate / divisor;
+
+		if (upFactor > MAX_NUM_PHASES) {
+			NSLog (@"*** Ratio of sample rates %u/%u needs too many filter phases", theOutputSampleRate, theInputSampleRate);
+			return nil;
+		}
+
+		// widen filter when downsampling to keep the same transition band
+		numTaps = qualityPresets [quality].numTaps * ((downFactor + upFactor - 1) / upFactor);
+		coefs   = malloc (upFactor * numTaps * sizeof (float));
+
+		if (coefs == NULL) {
+			NSLog (@"*** Couldn't allocate filter");
+			return nil;
+		}
+
+		initCoefs (coefs, upFactor, numTaps, qualityPresets [quality].rolloff * MIN (1.0, (double) upFactor / downFactor));
+
+		historyCapacity = [self maximumNumberOfInputFrames];
+		history = malloc (historyCapacity * numberOfChannels * sizeof (float));
+
+		if (history == NULL) {
+			NSLog (@"*** Couldn't allocate resampler history");
+			return nil;
+		}
+
+		[self reset];
+	}
+
+	return self;
+}
+
+- (void)dealloc
+{
+	if (coefs) {
+		free (coefs);
+	}
+
+	if (history) {
+		free (history);
+	}
+}
+
+- (NSUInteger)latency
+{
+	return numTaps / 2;
+}
+
+- (NSUInteger)numberOfInputFramesForOutputFrames:(NSUInteger)numberFrames
+{
+	NSUInteger needed;
+
+	if (numberFrames == 0) {
+		return 0;
+	}
+
+	// window end of last output frame
+	needed = position + (phase + (numberFrames - 1) * downFactor) / upFactor + numTaps;
+
+	return needed > historyLength ? needed - historyLength : 0;
+}
+
+- (NSUInteger)maximumNumberOfInputFrames
+{
+	return (upFactor - 1 + (capacity - 1) * downFactor) / upFactor + numTaps;
+}
+
+- (NSUInteger)resampleFrames:(SInt16 const *)inFrames numberFrames:(NSUInteger)inNumberFrames outFrames:(SInt16 *)outFrames numberFrames:(NSUInteger)outNumberFrames
+{
+	NSUInteger numFrames = 0;
+	NSUInteger numChannels = numberOfChannels;
+
+	inNumberFrames = MIN (inNumberFrames, historyCapacity - historyLength);
+
+	for (NSUInteger c = 0; c < numChannels; c ++) {
+		float * channel = & history [c * historyCapacity + historyLength];
+
+		for (NSUInteger i = 0; i < inNumberFrames; i ++) {
+			channel [i] = inFrames [i * numChannels + c];
+		}
+	}
+
+	historyLength += inNumberFrames;
+
+	while (numFrames < outNumberFrames && position + numTaps <= historyLength) {
+		float const * phaseCoefs = & coefs [phase * numTaps];
+
+		for (NSUInteger c = 0; c < numChannels; c ++) {
+			float const * x = & history [c * historyCapacity + position];
+			float sum0 = 0.0f, sum1 = 0.0f, sum2 = 0.0f, sum3 = 0.0f;
+			long value;
+
+			// independent sums allow vectorization without reordering
+			for (NSUInteger j = 0; j < numTaps; j += 4) {
+				sum0 += x [j + 0] * phaseCoefs [j + 0];
+				sum1 += x [j + 1] * phaseCoefs [j + 1];
+				sum2 += x [j + 2] * phaseCoefs [j + 2];
+				sum3 += x [j + 3] * phaseCoefs [j + 3];
+			}
+
+			value = lrintf ((sum0 + sum1) + (sum2 + sum3));
+			outFrames [numFrames * numChannels + c] = (SInt16) MAX (-32768, MIN (value, 32767));
+		}
+
+		numFrames ++;
+		phase    += downFactor;
+		position += phase / upFactor;
+		phase    %= upFactor;
+	}
+
+	// discard consumed history
+	if (position > 0) {
+		for (NSUInteger c = 0; c < numChannels; c ++) {
+			float * channel = & history [c * historyCapacity];
+
+			memmove (channel, & channel [position], (historyLength - position) * sizeof (float));
+		}
+
+		historyLength -= position;
+		position = 0;
+	}
+
+	return numFrames;
+}
+
+- (void)reset
+{
+	memset (history, 0, historyCapacity * numberOfChannels * sizeof (float));
+
+	// first output frame is centered on first input frame
+	historyLength = numTaps / 2 - 1;
+	position      = 0;
+	phase         = 0;
+}
+
+@end
@@ -26,7 +26,8 @@
 
 @interface BKCSample : NSObject
 {
-	BKData data;
+	BKData   data;
+	NSData * mappedData;
 }
 
 /**
@@ -44,6 +45,11 @@
  */
 @property (readonly, nonatomic) BKData * data;
 
+/**
+ * Frames reference memory mapped file
+ */
+@property (readonly, nonatomic) BOOL isMapped;
+
 /**
  * Initialize with raw content of file
  */
@@ -54,6 +60,22 @@
  */
 - (instancetype)initWithWAVEFile:(NSString *)path;
 
+/**
+ * Initialize with memory mapped raw content of file
+ *
+ * Frames are referenced directly if `params` matches the layout of BKFrame
+ * (16 bit signed, native endian), otherwise they are converted.
+ */
+- (instancetype)initWithMappedRawAudioOfFile:(NSString *)path numberOfChannels:(NSUInteger)numberOfChannels params:(BKEnum)params;
+
+/**
+ * Initialize with memory mapped content of WAVE file
+ *
+ * Frames are referenced directly if the file contains 16 bit PCM,
+ * otherwise they are converted.
+ */
+- (instancetype)initWithMappedWAVEFile:(NSString *)path;
+
 /**
  * Initialize with given copy of given data.
  */
@@ -22,6 +22,7 @@
  */
 
 #import "BKCSample.h"
+#import "BKCSample_internal.h"
 #import "BKWaveFileReader.h"
 
 @interface BKCWaveFileReader : NSObject
@@ -112,6 +113,84 @@
 
 @end
 
+/**
+ * Check if params describe frames with layout of BKFrame
+ */
+static BOOL paramsMatchFrameLayout (BKEnum params)
+{
+#ifdef __BIG_ENDIAN__
+	BKEnum nativeEndian = BK_BIG_ENDIAN;
+#else
+	BKEnum nativeEndian = BK_LITTLE_ENDIAN;
+#endif
+
+	return params == BK_16_BIT_SIGNED || params == (BK_16_BIT_SIGNED | nativeEndian);
+}
+
+static UInt16 readUInt16LE (UInt8 const * bytes)
+{
+	return bytes [0] | (bytes [1] << 8);
+}
+
+static UInt32 readUInt32LE (UInt8 const * bytes)
+{
+	return bytes [0] | (bytes [1] << 8) | (bytes [2] << 16) | ((UInt32) bytes [3] << 24);
+}
+
+BOOL BKCFindWAVEFrames (NSData * file, NSUInteger * outOffset, NSUInteger * outSize, NSUInteger * outNumChannels)
+{
+	UInt8 const * bytes = file.bytes;
+	NSUInteger length = file.length;
+	NSUInteger offset = 12;
+	NSUInteger numChannels = 0;
+	BOOL hasFormat = NO;
+
+	if (length < 12 || memcmp (bytes, "RIFF", 4) != 0 || memcmp (& bytes [8], "WAVE", 4) != 0) {
+		return NO;
+	}
+
+	while (offset + 8 <= length) {
+		UInt8 const * chunk = & bytes [offset];
+		NSUInteger chunkSize = readUInt32LE (& chunk [4]);
+
+		offset += 8;
+
+		if (chunkSize > length - offset) {
+			return NO;
+		}
+
+		if (memcmp (chunk, "fmt ", 4) == 0) {
+			if (chunkSize < 16) {
+				return NO;
+			}
+
+			// only plain 16 bit PCM has layout of BKFrame
+			if (readUInt16LE (& chunk [8]) != 1 || readUInt16LE (& chunk [22]) != 16) {
+				return NO;
+			}
+
+			numChannels = readUInt16LE (& chunk [10]);
+			hasFormat   = YES;
+		}
+		else if (memcmp (chunk, "data", 4) == 0) {
+			if (hasFormat == NO || numChannels == 0) {
+				return NO;
+			}
+
+			* outOffset      = offset;
+			* outSize        = chunkSize;
+			* outNumChannels = numChannels;
+
+			return YES;
+		}
+
+		// chunks are padded to even size
+		offset += chunkSize + (chunkSize & 1);
+	}
+
+	return NO;
+}
+
 @implementation BKCSample
 
 - (instancetype)init
@@ -168,6 +247,89 @@
 	return self;
 }
 
+- (instancetype)initWithMappedRawAudioOfFile:(NSString *)path numberOfChannels:(NSUInteger)numberOfChannels params:(BKEnum)params
+{
+	BKInt      res;
+	NSData   * rawAudio;
+	NSError  * error = nil;
+	NSUInteger numFrames;
+
+	if (self = [self init]) {
+		rawAudio = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedAlways error:& error];
+
+		if (rawAudio == nil) {
+			NSLog (@"*** Failed to map file: %@", error);
+			return nil;
+		}
+
+		if (numberOfChannels && paramsMatchFrameLayout (params) && ((uintptr_t) rawAudio.bytes & (sizeof (BKFrame) - 1)) == 0) {
+			numFrames = rawAudio.length / sizeof (BKFrame) / numberOfChannels;
+			res       = BKDataSetFrames (& data, rawAudio.bytes, (BKUInt)numFrames, (BKUInt)numberOfChannels, NO);
+
+			if (res < 0) {
+				NSLog (@"*** Failed to reference raw audio: %d", res);
+				return nil;
+			}
+
+			mappedData = rawAudio;
+		}
+		else {
+			// frames have to be converted
+			res = BKDataSetData (& data, rawAudio.bytes, (BKUInt)rawAudio.length, (BKUInt)numberOfChannels, params);
+
+			if (res < 0) {
+				NSLog (@"*** Failed to load raw audio: %d", res);
+				return nil;
+			}
+		}
+	}
+
+	return self;
+}
+
+- (instancetype)initWithMappedWAVEFile:(NSString *)path
+{
+	BKInt      res;
+	NSData   * file;
+	NSError  * error = nil;
+	NSUInteger offset, size, numChannels;
+	BOOL canReference;
+	void const * frames;
+
+	file = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedAlways error:& error];
+
+	if (file == nil) {
+		NSLog (@"*** Failed to map file: %@", error);
+		return nil;
+	}
+
+	canReference = BKCFindWAVEFrames (file, & offset, & size, & numChannels) && (offset & (sizeof (BKFrame) - 1)) == 0;
+
+#ifdef __BIG_ENDIAN__
+	// WAVE frames are little endian
+	canReference = NO;
+#endif
+
+	// use reader to convert other formats
+	if (canReference == NO) {
+		return [self initWithWAVEFile:path];
+	}
+
+	if (self = [self init]) {
+		frames = (UInt8 const *) file.bytes + offset;
+		res    = BKDataSetFrames (& data, frames, (BKUInt)(size / sizeof (BKFrame) / numChannels), (BKUInt)numChannels, NO);
+
+		if (res < 0) {
+			NSLog (@"*** Failed to reference WAVE frames: %d", res);
+			return nil;
+		}
+
+		mappedData = file;
+	}
+
+	return self;
+}
+
 - (instancetype)initWithData:(BKData const *)newData
 {
 	BKInt res;
@@ -204,9 +366,23 @@
 	return & data;
 }
 
+- (BOOL)isMapped
+{
+	return mappedData != nil;
+}
+
 - (BKInt)loadFrames:(void const *)frames dataSize:(NSUInteger)dataSize numberOfChannels:(NSUInteger)numberOfChannels params:(BKEnum)params
 {
-	return BKDataSetData (& data, frames, (BKInt)dataSize, (BKInt)numberOfChannels, params);
+	BKInt res;
+
+	res = BKDataSetData (& data, frames, (BKInt)dataSize, (BKInt)numberOfChannels, params);
+
+	// frames are copied; mapped file isn't needed anymore
+	if (res >= 0) {
+		mappedData = nil;
+	}
+
+	return res;
 }
 
 @end
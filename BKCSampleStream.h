@@ -0,0 +1,161 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+#import <stdatomic.h>
+#import "BlipKit.h"
+
+/**
+ * A sample which is streamed from disk while playing
+ *
+ * Frames are read ahead of the play position by a background thread into
+ * a ring of chunks. The track plays one chunk after the other; its sample
+ * callback switches to the next chunk when the current chunk has ended and
+ * only then hands the finished chunk back to the reader.
+ * Only 16 bit PCM WAVE files and 16 bit signed raw files are supported.
+ */
+@interface BKCSampleStream : NSObject
+{
+	int            fileDescriptor;
+	off_t          dataOffset;
+	NSUInteger     numFrames;
+	NSUInteger     numChannels;
+	NSUInteger     chunkSize;
+	NSUInteger     numChunks;
+	BKFrame      * frames;
+	BKData       * chunks;
+	BKData         silence;
+	BKTrack      * track;
+	NSThread     * readerThread;
+	dispatch_semaphore_t readerSemaphore;
+	NSUInteger     readPosition;
+	NSRange        range;
+	BKEnum         repeatMode;
+	NSLock       * settingsLock;
+	atomic_ulong   numWrittenChunks;
+	atomic_ulong   numPlayedChunks;
+	atomic_ulong   underrunCount;
+	atomic_ulong   rewindCount;
+	atomic_bool    isEnded;
+	atomic_bool    isClosed;
+}
+
+/**
+ * Number of frames in file
+ */
+@property (readonly, nonatomic) NSUInteger length;
+
+/**
+ * Number of channels
+ */
+@property (readonly, nonatomic) NSUInteger numberOfChannels;
+
+/**
+ * Number of frames per chunk
+ */
+@property (readonly, nonatomic) NSUInteger chunkSize;
+
+/**
+ * Number of chunks which are read ahead
+ */
+@property (readonly, nonatomic) NSUInteger numberOfChunks;
+
+/**
+ * Range of frames to play
+ *
+ * Same as BK_SAMPLE_RANGE. Changes are applied when the stream is rewound
+ * or wraps around; already read chunks are played before.
+ */
+@property (readwrite, nonatomic) NSRange range;
+
+/**
+ * Repeat mode
+ *
+ * Same as BK_SAMPLE_REPEAT. BK_PALINDROME is played as BK_REPEAT.
+ */
+@property (readwrite, nonatomic) BKEnum repeatMode;
+
+/**
+ * Number of chunks which are read and not yet played
+ */
+@property (readonly, nonatomic) NSUInteger numberOfPrefetchedChunks;
+
+/**
+ * Number of chunks which were not read in time
+ *
+ * Silence is played instead
+ */
+@property (readonly, nonatomic) NSUInteger underrunCount;
+
+/**
+ * Stream has reached the end of its range and doesn't repeat
+ */
+@property (readonly, nonatomic) BOOL isEnded;
+
+/**
+ * Initialize with 16 bit PCM WAVE file
+ */
+- (instancetype)initWithWAVEFile:(NSString *)path chunkSize:(NSUInteger)chunkSize numberOfChunks:(NSUInteger)numberOfChunks;
+
+/**
+ * Initialize with 16 bit signed raw audio file in native byte order
+ */
+- (instancetype)initWithRawAudioOfFile:(NSString *)path numberOfChannels:(NSUInteger)numberOfChannels chunkSize:(NSUInteger)chunkSize numberOfChunks:(NSUInteger)numberOfChunks;
+
+/**
+ * Callback which has to be set as BK_SAMPLE_CALLBACK of the track
+ */
+@property (readonly, nonatomic) BKCallback sampleCallback;
+
+/**
+ * Chunk which has to be set as BK_SAMPLE of the track when attaching
+ */
+@property (readonly, nonatomic) BKData * currentChunk;
+
+/**
+ * Attach to track
+ *
+ * Reads the first chunks and starts the reader thread. The caller has to set
+ * the track's BK_SAMPLE_CALLBACK to `sampleCallback`, BK_SAMPLE to
+ * `currentChunk` and BK_SAMPLE_REPEAT to BK_REPEAT.
+ */
+- (BOOL)attachToTrack:(BKTrack *)track;
+
+/**
+ * Detach from track
+ *
+ * The caller has to reset the track's sample callback.
+ */
+- (void)detach;
+
+/**
+ * Start reading from the beginning of range again
+ */
+- (void)rewind;
+
+/**
+ * Stop reader thread and close file
+ */
+- (void)close;
+
+@end
@@ -0,0 +1,459 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import <fcntl.h>
+#import <unistd.h>
+#import "BKCSampleStream.h"
+#import "BKCSample_internal.h"
+
+#define DEFAULT_CHUNK_SIZE 16384
+#define DEFAULT_NUM_CHUNKS 4
+
+@interface BKCSampleStream ()
+{
+	BOOL       playsSilence;
+	BOOL       threadStarted;
+	NSUInteger numAppliedRewinds;
+}
+
+@end
+
+@implementation BKCSampleStream
+
+@synthesize chunkSize;
+
+/**
+ * Called by the track on the render thread when a chunk has finished
+ *
+ * The event is emitted when the chunk wraps around, before its first frame is
+ * played again; the next chunk continues at exactly this frame. The finished
+ * chunk is handed back to the reader only after the track has been switched
+ * away from it.
+ */
+static BKEnum sampleCallback (BKCallbackInfo * info, void * userInfo)
+{
+	BKCSampleStream * self = (__bridge BKCSampleStream *) userInfo;
+	NSUInteger played, written, next;
+
+	if (info -> event != BK_EVENT_SAMPLE_RESET || self -> track == NULL) {
+		return 0;
+	}
+
+	played  = atomic_load_explicit (& self -> numPlayedChunks, memory_order_relaxed);
+	written = atomic_load_explicit (& self -> numWrittenChunks, memory_order_acquire);
+
+	// current chunk has finished if not waiting for it
+	next = self -> playsSilence ? played : played + 1;
+
+	if (next < written) {
+		BKSetPtr (self -> track, BK_SAMPLE, & self -> chunks [next % self -> numChunks], 0);
+		self -> playsSilence = NO;
+	}
+	else {
+		if (atomic_load (& self -> isEnded) == NO) {
+			atomic_fetch_add_explicit (& self -> underrunCount, 1, memory_order_relaxed);
+		}
+
+		if (self -> playsSilence == NO) {
+			BKSetPtr (self -> track, BK_SAMPLE, & self -> silence, 0);
+		}
+
+		self -> playsSilence = YES;
+	}
+
+	// release finished chunk after the track doesn't reference it anymore
+	if (next != played) {
+		atomic_store_explicit (& self -> numPlayedChunks, next, memory_order_release);
+		dispatch_semaphore_signal (self -> readerSemaphore);
+	}
+
+	return 0;
+}
+
+- (instancetype)initWithFile:(NSString *)path dataOffset:(off_t)offset dataSize:(NSUInteger)size numberOfChannels:(NSUInteger)theNumberOfChannels chunkSize:(NSUInteger)theChunkSize numberOfChunks:(NSUInteger)theNumberOfChunks
+{
+	BKInt res;
+
+	if ((self = [super init])) {
+		fileDescriptor = open (path.fileSystemRepresentation, O_RDONLY);
+
+		if (fileDescriptor < 0) {
+			NSLog (@"*** Failed to open file: %@", path);
+			return nil;
+		}
+
+		if (theNumberOfChannels == 0) {
+			NSLog (@"*** Number of channels must be at least 1");
+			return nil;
+		}
+
+		dataOffset  = offset;
+		numChannels = theNumberOfChannels;
+		numFrames   = size / sizeof (BKFrame) / numChannels;
+		chunkSize   = theChunkSize ? theChunkSize : DEFAULT_CHUNK_SIZE;
+		numChunks   = MAX (theNumberOfChunks, 2);
+		range       = NSMakeRange (0, numFrames);
+		repeatMode  = BK_NO_REPEAT;
+
+		// last chunk is always silent
+		frames = calloc ((numChunks + 1) * chunkSize * numChannels, sizeof (BKFrame));
+		chunks = calloc (numChunks, sizeof (BKData));
+
+		if (frames == NULL || chunks == NULL) {
+			NSLog (@"*** Couldn't allocate sample stream chunks");
+			return nil;
+		}
+
+		for (NSUInteger i = 0; i < numChunks; i ++) {
+			BKDataInit (& chunks [i]);
+		}
+
+		BKDataInit (& silence);
+		res = BKDataSetFrames (& silence, & frames [numChunks * chunkSize * numChannels], (BKUInt)chunkSize, (BKUInt)numChannels, NO);
+
+		if (res < 0) {
+			NSLog (@"*** Couldn't initialize silence: %d", res);
+			return nil;
+		}
+
+		readerSemaphore = dispatch_semaphore_create (0);
+		settingsLock    = [[NSLock alloc] init];
+
+		atomic_init (& numWrittenChunks, 0);
+		atomic_init (& numPlayedChunks, 0);
+		atomic_init (& underrunCount, 0);
+		atomic_init (& rewindCount, 0);
+		atomic_init (& isEnded, NO);
+		atomic_init (& isClosed, NO);
+	}
+
+	return self;
+}
+
+- (instancetype)initWithWAVEFile:(NSString *)path chunkSize:(NSUInteger)theChunkSize numberOfChunks:(NSUInteger)theNumberOfChunks
+{
+	NSData   * file;
+	NSError  * error = nil;
+	NSUInteger offset, size, theNumberOfChannels;
+
+	// only header pages are read
+	file = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedAlways error:& error];
+
+	if (file == nil) {
+		NSLog (@"*** Failed to map file: %@", error);
+		return nil;
+	}
+
+	if (BKCFindWAVEFrames (file, & offset, & size, & theNumberOfChannels) == NO) {
+		NSLog (@"*** Only 16 bit PCM WAVE files can be streamed: %@", path);
+		return nil;
+	}
+
+	return [self initWithFile:path dataOffset:offset dataSize:size numberOfChannels:theNumberOfChannels chunkSize:theChunkSize numberOfChunks:theNumberOfChunks];
+}
+
+- (instancetype)initWithRawAudioOfFile:(NSString *)path numberOfChannels:(NSUInteger)theNumberOfChannels chunkSize:(NSUInteger)theChunkSize numberOfChunks:(NSUInteger)theNumberOfChunks
+{
+	NSDictionary * attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:path error:nil];
+
+	if (attributes == nil) {
+		NSLog (@"*** Failed to open file: %@", path);
+		return nil;
+	}
+
+	return [self initWithFile:path dataOffset:0 dataSize:(NSUInteger)attributes.fileSize numberOfChannels:theNumberOfChannels chunkSize:theChunkSize numberOfChunks:theNumberOfChunks];
+}
+
+- (instancetype)init
+{
+	return nil;
+}
+
+- (void)dealloc
+{
+	atomic_store (& isClosed, YES);
+
+	if (readerSemaphore) {
+		dispatch_semaphore_signal (readerSemaphore);
+	}
+
+	if (fileDescriptor > 0) {
+		close (fileDescriptor);
+	}
+
+	if (chunks) {
+		for (NSUInteger i = 0; i < numChunks; i ++) {
+			BKDispose (& chunks [i]);
+		}
+
+		free (chunks);
+	}
+
+	BKDispose (& silence);
+
+	if (frames) {
+		free (frames);
+	}
+}
+
+- (NSUInteger)length
+{
+	return numFrames;
+}
+
+- (NSUInteger)numberOfChannels
+{
+	return numChannels;
+}
+
+- (NSUInteger)numberOfChunks
+{
+	return numChunks;
+}
+
+- (NSRange)range
+{
+	NSRange value;
+
+	[settingsLock lock];
+	value = range;
+	[settingsLock unlock];
+
+	return value;
+}
+
+- (void)setRange:(NSRange)newRange
+{
+	[settingsLock lock];
+	range = newRange;
+	[settingsLock unlock];
+}
+
+- (BKEnum)repeatMode
+{
+	BKEnum value;
+
+	[settingsLock lock];
+	value = repeatMode;
+	[settingsLock unlock];
+
+	return value;
+}
+
+- (void)setRepeatMode:(BKEnum)newRepeatMode
+{
+	[settingsLock lock];
+	repeatMode = newRepeatMode;
+	[settingsLock unlock];
+}
+
+- (NSUInteger)numberOfPrefetchedChunks
+{
+	NSUInteger played  = atomic_load (& numPlayedChunks);
+	NSUInteger written = atomic_load (& numWrittenChunks);
+
+	return written > played ? written - played : 0;
+}
+
+- (NSUInteger)underrunCount
+{
+	return atomic_load (& underrunCount);
+}
+
+- (BOOL)isEnded
+{
+	return atomic_load (& isEnded) && self.numberOfPrefetchedChunks == 0;
+}
+
+/**
+ * Read next chunk
+ *
+ * Returns the number of frames read
+ */
+- (NSUInteger)readChunk:(BKFrame *)chunkFrames
+{
+	NSUInteger filled = 0;
+	NSRange    playRange;
+	BKEnum     repeat;
+	NSUInteger end;
+	NSUInteger rewinds = atomic_load (& rewindCount);
+	size_t     frameSize = numChannels * sizeof (BKFrame);
+
+	// settings are changed on other threads
+	[settingsLock lock];
+	playRange = NSIntersectionRange (range, NSMakeRange (0, numFrames));
+	repeat    = repeatMode;
+	[settingsLock unlock];
+
+	end = NSMaxRange (playRange);
+
+	if (numAppliedRewinds != rewinds || readPosition < playRange.location) {
+		numAppliedRewinds = rewinds;
+		readPosition      = playRange.location;
+	}
+
+	while (filled < chunkSize && playRange.length) {
+		NSUInteger count;
+		ssize_t size;
+
+		if (readPosition >= end) {
+			if (repeat == BK_NO_REPEAT) {
+				break;
+			}
+
+			readPosition = playRange.location;
+		}
+
+		count = MIN (chunkSize - filled, end - readPosition);
+		size  = pread (fileDescriptor, & chunkFrames [filled * numChannels], count * frameSize, dataOffset + readPosition * frameSize);
+
+		if (size <= 0) {
+			NSLog (@"*** Failed to read sample stream: %d", errno);
+			readPosition = end;
+			break;
+		}
+
+		count         = size / frameSize;
+		filled       += count;
+		readPosition += count;
+	}
+
+	return filled;
+}
+
+/**
+ * Read chunks until all free chunks are filled
+ */
+- (void)fillChunks
+{
+	NSUInteger written = atomic_load_explicit (& numWrittenChunks, memory_order_relaxed);
+
+	while (atomic_load (& isClosed) == NO && atomic_load (& isEnded) == NO) {
+		NSUInteger played = atomic_load_explicit (& numPlayedChunks, memory_order_acquire);
+		NSUInteger index = written % numChunks;
+		BKFrame * chunkFrames = & frames [index * chunkSize * numChannels];
+		NSUInteger count;
+
+		// the chunk with same index is still playing
+		if (written >= played + numChunks) {
+			break;
+		}
+
+		count = [self readChunk:chunkFrames];
+
+		if (count == 0) {
+			atomic_store (& isEnded, YES);
+			break;
+		}
+
+		BKDataSetFrames (& chunks [index], chunkFrames, (BKUInt)count, (BKUInt)numChannels, NO);
+		atomic_store_explicit (& numWrittenChunks, ++ written, memory_order_release);
+	}
+}
+
+- (void)startReaderThread
+{
+	__weak BKCSampleStream * weakSelf = self;
+	dispatch_semaphore_t semaphore = readerSemaphore;
+
+	readerThread = [[NSThread alloc] initWithBlock:^{
+		while (1) {
+			@autoreleasepool {
+				BKCSampleStream * stream = weakSelf;
+
+				if (stream == nil || atomic_load (& stream -> isClosed)) {
+					break;
+				}
+
+				[stream fillChunks];
+			}
+
+			dispatch_semaphore_wait (semaphore, DISPATCH_TIME_FOREVER);
+		}
+	}];
+
+	readerThread.name             = @"BKCSampleStream";
+	readerThread.qualityOfService = NSQualityOfServiceUserInitiated;
+
+	[readerThread start];
+}
+
+- (BKCallback)sampleCallback
+{
+	BKCallback callback;
+
+	callback.func     = sampleCallback;
+	callback.userInfo = (__bridge void *) self;
+
+	return callback;
+}
+
+- (BKData *)currentChunk
+{
+	NSUInteger played = atomic_load (& numPlayedChunks);
+
+	if (played >= atomic_load (& numWrittenChunks)) {
+		return & silence;
+	}
+
+	return & chunks [played % numChunks];
+}
+
+- (BOOL)attachToTrack:(BKTrack *)newTrack
+{
+	if (newTrack == NULL) {
+		return NO;
+	}
+
+	if (threadStarted == NO) {
+		// read first chunks before playing
+		[self fillChunks];
+		[self startReaderThread];
+		threadStarted = YES;
+	}
+
+	playsSilence = self.currentChunk == & silence;
+	track        = newTrack;
+
+	return YES;
+}
+
+- (void)detach
+{
+	track = NULL;
+}
+
+- (void)rewind
+{
+	atomic_fetch_add (& rewindCount, 1);
+	atomic_store (& isEnded, NO);
+	dispatch_semaphore_signal (readerSemaphore);
+}
+
+- (void)close
+{
+	atomic_store (& isClosed, YES);
+	dispatch_semaphore_signal (readerSemaphore);
+}
+
+@end
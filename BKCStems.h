@@ -0,0 +1,126 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+#import "BKCContext.h"
+
+/**
+ * Reusable planar buffers which receive stems
+ *
+ * Contains a buffer per stem and channel, and a buffer per channel for the
+ * master mix.
+ */
+@interface BKCStemBuffers : NSObject
+{
+	NSUInteger      numberOfStems;
+	NSUInteger      numberOfChannels;
+	NSUInteger      capacity;
+	NSUInteger      numberOfFrames;
+	NSMutableData * planarData;
+@public
+	SInt16        * scratch;  // Interleaved frames of a single context
+	SInt16        * mix;      // Interleaved master mix
+}
+
+/**
+ * Number of stems
+ */
+@property (readonly, nonatomic) NSUInteger numberOfStems;
+
+/**
+ * Number of channels
+ */
+@property (readonly, nonatomic) NSUInteger numberOfChannels;
+
+/**
+ * Maximum number of frames per call of generateStems:numberFrames:
+ */
+@property (readonly, nonatomic) NSUInteger capacity;
+
+/**
+ * Number of frames generated by the last call
+ */
+@property (readwrite, nonatomic) NSUInteger numberOfFrames;
+
+/**
+ * Initialize buffers
+ */
+- (instancetype)initWithNumberOfStems:(NSUInteger)numberOfStems numberOfChannels:(NSUInteger)numberOfChannels capacity:(NSUInteger)capacity;
+
+/**
+ * Frames of stem and channel
+ */
+- (SInt16 *)framesOfStem:(NSUInteger)stem channel:(NSUInteger)channel;
+
+/**
+ * Frames of master mix and channel
+ */
+- (SInt16 *)masterFramesOfChannel:(NSUInteger)channel;
+
+@end
+
+@interface BKCContext (BKCStems)
+
+/**
+ * Number of stems since beginStemsWithGroups:
+ */
+@property (readonly, nonatomic) NSUInteger numberOfStems;
+
+/**
+ * Render groups of tracks into separate stems
+ *
+ * `groups` is an array of arrays of attached tracks; each group becomes a
+ * stem. If `groups` is nil, each attached track becomes a stem. Tracks are
+ * moved to a separate BlipKit context per group, which is clocked in step
+ * with this context, so all stems are generated in a single pass. Frames
+ * are generated in steps which end at ticks of the clock, so changes made
+ * by dividers and programs apply to the stems at the tick. Tracks
+ * not contained in a group stay in this context and are only in the master
+ * mix.
+ *
+ * Is meant for offline rendering and should be called before generating
+ * frames, as the clocks of the groups start at 0. The audio unit must not
+ * be running.
+ */
+- (BOOL)beginStemsWithGroups:(NSArray *)groups;
+
+/**
+ * Create buffers for the current stems
+ */
+- (BKCStemBuffers *)stemBuffersWithCapacity:(NSUInteger)capacity;
+
+/**
+ * Generate frames of all stems and the master mix
+ *
+ * The master mix is the sum of all stems and the remaining tracks and is
+ * clipped. Returns the number of generated frames or a negative value on
+ * error.
+ */
+- (BKInt)generateStems:(BKCStemBuffers *)buffers numberFrames:(UInt32)numberFrames;
+
+/**
+ * Move tracks back to this context
+ */
+- (void)endStems;
+
+@end
@@ -0,0 +1,357 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import "BKCStems.h"
+#import "BKCContext_internal.h"
+#import "BKCOutputKernels.h"
+#import "BKCTrack.h"
+
+#define MAX_SEGMENT_FRAMES 1024
+
+/**
+ * A group of tracks rendered into a stem
+ */
+@interface BKCStemGroup : NSObject
+{
+@public
+	BKContext ctx;
+	NSArray * tracks;
+	BOOL      initialized;
+}
+
+@end
+
+@implementation BKCStemGroup
+
+- (void)dealloc
+{
+	if (initialized) {
+		BKDispose (& ctx);
+	}
+}
+
+@end
+
+/**
+ * Groups and a silent track which keeps the master context generating
+ */
+@interface BKCStemSession : NSObject
+{
+@public
+	NSMutableArray * groups;
+	BKTrack          clockTrack;
+	BOOL             initialized;
+}
+
+@end
+
+@implementation BKCStemSession
+
+- (void)dealloc
+{
+	if (initialized) {
+		BKDispose (& clockTrack);
+	}
+}
+
+@end
+
+@implementation BKCStemBuffers
+
+@synthesize numberOfStems;
+@synthesize numberOfChannels;
+@synthesize capacity;
+@synthesize numberOfFrames;
+
+- (instancetype)initWithNumberOfStems:(NSUInteger)theNumberOfStems numberOfChannels:(NSUInteger)theNumberOfChannels capacity:(NSUInteger)theCapacity
+{
+	if ((self = [super init])) {
+		NSUInteger numBuffers = (theNumberOfStems + 1) * theNumberOfChannels + 2 * theNumberOfChannels;
+
+		numberOfStems    = theNumberOfStems;
+		numberOfChannels = theNumberOfChannels;
+		capacity         = theCapacity;
+		planarData       = [[NSMutableData alloc] initWithLength:numBuffers * capacity * sizeof (SInt16)];
+
+		if (planarData == nil) {
+			NSLog (@"*** Couldn't allocate stem buffers");
+			return nil;
+		}
+
+		// interleaved buffers are at the end
+		scratch = (SInt16 *) planarData.mutableBytes + (theNumberOfStems + 1) * numberOfChannels * capacity;
+		mix     = scratch + numberOfChannels * capacity;
+	}
+
+	return self;
+}
+
+- (SInt16 *)framesOfStem:(NSUInteger)stem channel:(NSUInteger)channel
+{
+	if (stem >= numberOfStems || channel >= numberOfChannels) {
+		return NULL;
+	}
+
+	return (SInt16 *) planarData.mutableBytes + (stem * numberOfChannels + channel) * capacity;
+}
+
+- (SInt16 *)masterFramesOfChannel:(NSUInteger)channel
+{
+	if (channel >= numberOfChannels) {
+		return NULL;
+	}
+
+	return (SInt16 *) planarData.mutableBytes + (numberOfStems * numberOfChannels + channel) * capacity;
+}
+
+@end
+
+@implementation BKCContext (BKCStems)
+
+- (NSUInteger)numberOfStems
+{
+	BKCStemSession * session = stemSession;
+
+	return session ? session -> groups.count : 0;
+}
+
+- (BOOL)beginStemsWithGroups:(NSArray *)groups
+{
+	BKTime period;
+	BKCStemSession * session;
+
+	if (stemSession) {
+		NSLog (@"*** Stems have already begun");
+		return NO;
+	}
+
+	if (groups == nil) {
+		NSMutableArray * trackGroups = [[NSMutableArray alloc] init];
+
+		for (BKCTrack * track in tracks) {
+			[trackGroups addObject:@[track]];
+		}
+
+		groups = trackGroups;
+	}
+
+	for (NSArray * groupTracks in groups) {
+		for (BKCTrack * track in groupTracks) {
+			if (track.context != self) {
+				NSLog (@"*** Track of stem group is not attached to context");
+				return NO;
+			}
+		}
+	}
+
+	[self endSynthesisSession];
+
+	session = [[BKCStemSession alloc] init];
+	session -> groups = [[NSMutableArray alloc] init];
+
+	if (BKTrackInit (& session -> clockTrack, BK_SQUARE) < 0) {
+		NSLog (@"*** Couldn't initialize track");
+		return NO;
+	}
+
+	session -> initialized = YES;
+	BKSetAttr (& session -> clockTrack, BK_VOLUME, 0);
+
+	BKGetPtr (& renderCtx, BK_CLOCK_PERIOD, & period, sizeof (period));
+
+	[self lock];
+
+	for (NSArray * groupTracks in groups) {
+		BKCStemGroup * group = [[BKCStemGroup alloc] init];
+
+		if (BKContextInit (& group -> ctx, renderCtx.numChannels, renderCtx.sampleRate) < 0) {
+			NSLog (@"*** Couldn't initialize stem context");
+			[self unlock];
+			[self endStemSession:session];
+			return NO;
+		}
+
+		group -> initialized = YES;
+		group -> tracks = [groupTracks copy];
+		BKSetPtr (& group -> ctx, BK_CLOCK_PERIOD, & period, sizeof (period));
+
+		[self moveTracks:group -> tracks toContext:& group -> ctx];
+		[session -> groups addObject:group];
+	}
+
+	BKTrackAttach (& session -> clockTrack, & renderCtx);
+	stemSession = session;
+
+	[self unlock];
+
+	return YES;
+}
+
+- (BKCStemBuffers *)stemBuffersWithCapacity:(NSUInteger)capacity
+{
+	return [[BKCStemBuffers alloc] initWithNumberOfStems:self.numberOfStems numberOfChannels:renderCtx.numChannels capacity:capacity];
+}
+
+/**
+ * End frames of context at `time`, read them into `out` and clear missing
+ * frames
+ */
+static BKInt readContext (BKContext * ctx, BKTime time, SInt16 * out, UInt32 numFrames)
+{
+	BKInt res;
+
+	BKContextEnd (ctx, time);
+	res = BKContextRead (ctx, out, numFrames);
+
+	if (res >= 0 && res < numFrames) {
+		memset (& out [res * ctx -> numChannels], 0, (numFrames - res) * ctx -> numChannels * sizeof (SInt16));
+	}
+
+	return res;
+}
+
+- (BKInt)generateStems:(BKCStemBuffers *)buffers numberFrames:(UInt32)inNumberFrames
+{
+	BKInt  res;
+	UInt32 size;
+	UInt64 frameTime, nextTime;
+	BKTime startTime, stepTime, endTime, offset;
+	UInt32 numFrames = 0;
+	UInt32 numChannels = renderCtx.numChannels;
+	BKCStemSession * session = stemSession;
+	NSUInteger numGroups = self.numberOfStems;
+	SInt16 * planar [numChannels];
+	BKTime groupTimes [MAX (numGroups, 1)];
+
+	if (session == nil || buffers.numberOfStems != numGroups || buffers.numberOfChannels != numChannels) {
+		NSLog (@"*** Stem buffers don't match stems");
+		return -1;
+	}
+
+	inNumberFrames = (UInt32) MIN (inNumberFrames, buffers.capacity);
+
+	[commandQueue drain];
+	[eventScheduler collectEvents];
+
+	// split frames at event times like generateFrames:numberFrames:
+	while (numFrames < inNumberFrames) {
+		frameTime = [self renderFrameTime];
+
+		[eventScheduler executeEventsUntilTime:frameTime];
+		nextTime = [eventScheduler nextEventTime];
+
+		size = (UInt32) MIN (MIN (inNumberFrames - numFrames, nextTime - frameTime), MAX_SEGMENT_FRAMES);
+
+		BKGetPtr (& renderCtx, BK_TIME, & startTime, sizeof (startTime));
+		endTime = BKTimeAddFrames (startTime, size);
+
+		for (NSUInteger i = 0; i < numGroups; i ++) {
+			BKCStemGroup * group = session -> groups [i];
+
+			BKGetPtr (& group -> ctx, BK_TIME, & groupTimes [i], sizeof (groupTimes [i]));
+		}
+
+		// groups reach each clock tick before the master context runs it
+		do {
+			stepTime = [self nextRenderStepTime:endTime];
+			offset   = BKTimeSub (stepTime, startTime);
+
+			for (NSUInteger i = 0; i < numGroups; i ++) {
+				BKCStemGroup * group = session -> groups [i];
+
+				if ((res = BKContextGenerateToTime (& group -> ctx, BKTimeAdd (groupTimes [i], offset), NULL)) < 0) {
+					return res;
+				}
+			}
+
+			if ((res = BKContextGenerateToTime (& renderCtx, stepTime, NULL)) < 0) {
+				return res;
+			}
+		}
+		while (BKTimeIsLess (stepTime, endTime));
+
+		// master context with remaining tracks and dividers
+		if ((res = readContext (& renderCtx, endTime, & buffers -> mix [numFrames * numChannels], size)) < 0) {
+			return res;
+		}
+
+		for (NSUInteger i = 0; i < numGroups; i ++) {
+			BKCStemGroup * group = session -> groups [i];
+
+			if ((res = readContext (& group -> ctx, BKTimeAdd (groupTimes [i], offset), buffers -> scratch, size)) < 0) {
+				return res;
+			}
+
+			for (NSUInteger c = 0; c < numChannels; c ++) {
+				planar [c] = [buffers framesOfStem:i channel:c];
+			}
+
+			BKCOutputDeinterleaveInt16 (planar, numFrames, buffers -> scratch, size, numChannels);
+			BKCOutputMixInt16 (& buffers -> mix [numFrames * numChannels], buffers -> scratch, size * numChannels);
+		}
+
+		numFrames += size;
+	}
+
+	for (NSUInteger c = 0; c < numChannels; c ++) {
+		planar [c] = [buffers masterFramesOfChannel:c];
+	}
+
+	BKCOutputDeinterleaveInt16 (planar, 0, buffers -> mix, numFrames, numChannels);
+
+	[eventScheduler publishFrameTime:[self renderFrameTime]];
+
+	buffers.numberOfFrames = numFrames;
+
+	return numFrames;
+}
+
+/**
+ * Move tracks back and dispose session
+ */
+- (void)endStemSession:(BKCStemSession *)session
+{
+	[self lock];
+
+	for (BKCStemGroup * group in session -> groups) {
+		[self moveTracks:group -> tracks toContext:& renderCtx];
+	}
+
+	if (session -> initialized) {
+		BKTrackDetach (& session -> clockTrack);
+	}
+
+	[self unlock];
+}
+
+- (void)endStems
+{
+	BKCStemSession * session = stemSession;
+
+	if (session) {
+		[self endStemSession:session];
+		stemSession = nil;
+	}
+}
+
+@end
@@ -22,10 +22,12 @@
  */
 
 #import <Foundation/Foundation.h>
+#import <stdatomic.h>
 #import "BlipKit.h"
 #import "BKCBase.h"
 #import "BKCInstrument.h"
 #import "BKCSample.h"
+#import "BKCSampleStream.h"
 #import "BKCWaveform.h"
 #import "BKCSample.h"
 
@@ -33,10 +35,16 @@
 
 @interface BKCTrack : NSObject <BKCAttributes>
 {
-	BKTrack       * track;
-	BKCInstrument * instrument;
-	BKCWaveform   * waveform;
-	BKCSample     * sample;
+	BKTrack         * track;
+	BKCInstrument   * instrument;
+	BKCWaveform     * waveform;
+	BKCSample       * sample;
+	BKCSampleStream * sampleStream;
+	BKInt             idleValues [3];  // Volume, master volume and mute as set through the track
+	BOOL              volumeSlides;
+	BOOL              idle;
+	UInt64            lastScheduledTime;
+	atomic_int        idleGeneration;
 }
 
 /**
@@ -64,6 +72,14 @@
  */
 @property (readwrite, nonatomic) BKCSample * sample;
 
+/**
+ * Current sample stream
+ *
+ * Replaces `sample`. While assigned, BK_SAMPLE_RANGE and BK_SAMPLE_REPEAT
+ * are applied to the stream.
+ */
+@property (readwrite, nonatomic) BKCSampleStream * sampleStream;
+
 /**
  * Initialize with waveform
  */
@@ -84,6 +100,26 @@
  */
 - (BKInt)setEffect:(BKCAttr)effect values:(BKInt const [3])values;
 
+/**
+ * Set attribute at frame time of context
+ *
+ * The change is applied at exactly `time`; see BKCContext's frameTime
+ */
+- (BOOL)setAttribute:(BKCAttr)attribute value:(BKInt)value atTime:(UInt64)time;
+
+/**
+ * Set pointer values at frame time of context
+ *
+ * The values are copied; `size` must not be 0 or exceed
+ * BKC_COMMAND_MAX_VALUE_SIZE
+ */
+- (BOOL)setPointer:(BKCAttr)attribute value:(void *)value size:(NSUInteger)size atTime:(UInt64)time;
+
+/**
+ * Set effect values at frame time of context
+ */
+- (BOOL)setEffect:(BKCAttr)effect values:(BKInt const [3])values atTime:(UInt64)time;
+
 /**
  * Get effect values
  */
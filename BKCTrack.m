@@ -21,8 +21,13 @@
  * IN THE SOFTWARE.
  */
 
+#import <unistd.h>
 #import "BKCTrack.h"
+#import "BKCTrack_internal.h"
 #import "BKCContext.h"
+#import "BKCContext_internal.h"
+
+#define QUEUE_RETRY_INTERVAL 1000
 
 @interface BKCTrack ()
 
@@ -30,11 +35,147 @@
 
 @end
 
+/**
+ * Calls dispose block when released
+ */
+@interface BKCRetiredPointer : NSObject
+{
+@public
+	void (^ dispose) (void);
+}
+
+- (instancetype)initWithDispose:(void (^) (void))dispose;
+
+@end
+
+@implementation BKCRetiredPointer
+
+- (instancetype)initWithDispose:(void (^) (void))theDispose
+{
+	if ((self = [super init])) {
+		dispose = theDispose;
+	}
+
+	return self;
+}
+
+- (void)dealloc
+{
+	if (dispose) {
+		dispose ();
+	}
+}
+
+@end
+
+/**
+ * Push command to queue
+ *
+ * `object` is kept alive until the command was executed by the render thread
+ */
+static BOOL pushCommand (BKCCommandQueue * queue, BKCCommand const * command, id object)
+{
+	if (object) {
+		return [queue pushCommand:command completion:^{
+			(void) object;
+		}];
+	}
+
+	return [queue pushCommand:command];
+}
+
+/**
+ * Set pointer attribute of tracks of `context` with the lock held
+ *
+ * Commands pending before are executed first, so they don't overwrite the
+ * pointer afterwards. Returns NO if the render thread renders without lock.
+ */
+static BOOL setPointerOfTracksWithLock (BKCContext * context, NSArray * tracks, BKEnum attribute, void * pointer)
+{
+	[context lock];
+
+	// queue is drained concurrently
+	if ([context rendersWithoutLock]) {
+		[context unlock];
+		return NO;
+	}
+
+	[context.commandQueue drain];
+
+	for (BKCTrack * track in tracks) {
+		if (track.context == context) {
+			BKSetPtr (track.track, attribute, pointer, 0);
+		}
+	}
+
+	[context unlock];
+
+	return YES;
+}
+
+void BKCTrackSetPointerOfTracks (NSArray * tracks, BKEnum attribute, void * pointer, void (^ dispose) (void))
+{
+	NSMutableArray * contexts = [[NSMutableArray alloc] init];
+	BKCRetiredPointer * retired = [[BKCRetiredPointer alloc] initWithDispose:dispose];
+
+	for (BKCTrack * track in tracks) {
+		BKCContext * context = track.context;
+
+		// not rendered
+		if (context == nil) {
+			BKSetPtr (track.track, attribute, pointer, 0);
+		}
+		else if (![contexts containsObject:context]) {
+			[contexts addObject:context];
+		}
+	}
+
+	for (BKCContext * context in contexts) {
+		NSUInteger count = 0;
+		BKCCommandQueue * queue = context.commandQueue;
+		NSMutableData * commands = [[NSMutableData alloc] initWithLength:tracks.count * sizeof (BKCCommand)];
+		BKCCommand * command = commands.mutableBytes;
+
+		if (queue) {
+			for (BKCTrack * track in tracks) {
+				if (track.context == context) {
+					BKCCommandInit (& command [count], BKCCommandTypeSetPointer, track.track, attribute);
+					command [count ++].pointer = pointer;
+				}
+			}
+
+			// previous pointer may be used until commands are executed
+			while (![queue pushCommands:command count:count completion:^{
+				(void) retired;
+			}]) {
+				if (setPointerOfTracksWithLock (context, tracks, attribute, pointer)) {
+					break;
+				}
+
+				// render thread frees space with the next buffer
+				usleep (QUEUE_RETRY_INTERVAL);
+			}
+		}
+		else {
+			[context lock];
+
+			for (BKCTrack * track in tracks) {
+				if (track.context == context) {
+					BKSetPtr (track.track, attribute, pointer, 0);
+				}
+			}
+
+			[context unlock];
+		}
+	}
+}
+
 @implementation BKCContext (BKTrackContext)
 
 - (BOOL)attachTrack:(BKCTrack *)track
 {
-	if ([tracks containsObject:track])
+	// a track is in `tracks` as long as its context is set
+	if (track.context == self)
 		return NO;
 
 	[tracks addObject:track];
@@ -47,12 +188,13 @@
 {
 	[self lock];
 
-	if (![tracks containsObject:track]) {
+	if (track.context != self) {
 		[self unlock];
 		return NO;
 	}
 
-	[tracks removeObject:track];
+	[tracks removeObjectIdenticalTo:track];
+	track.context = nil;
 
 	[self unlock];
 
@@ -64,6 +206,7 @@
 @implementation BKCTrack
 
 @synthesize context = context;
+@synthesize idle;
 
 - (instancetype)init
 {
@@ -73,6 +216,8 @@
 - (instancetype)initWithWaveform:(BKCWaveform *)theWaveform
 {
 	if ((self = [super init])) {
+		atomic_init (& idleGeneration, 0);
+		[self forgetIdleValues];
 		self.waveform = theWaveform;
 	}
 
@@ -114,11 +259,36 @@
 	return instrument;
 }
 
+/**
+ * Exchange instrument and update its tracks
+ */
+- (void)replaceInstrument:(BKCInstrument *)newInstrument
+{
+	[instrument removeTrack:self];
+	instrument = newInstrument;
+	[instrument addTrack:self];
+}
+
 - (void)setInstrument:(BKCInstrument *)newInstrument
 {
+	BKCCommand command;
+	BKCCommandQueue * queue = context.commandQueue;
+
+	if (queue) {
+		BKCCommandInit (& command, BKCCommandTypeSetPointer, self.track, BK_INSTRUMENT);
+		command.pointer = newInstrument.instrument;
+
+		// previous instrument may be used until command is executed
+		if (pushCommand (queue, & command, instrument)) {
+			[self replaceInstrument:newInstrument];
+		}
+
+		return;
+	}
+
 	[context lock];
 
-	instrument = newInstrument;
+	[self replaceInstrument:newInstrument];
 	BKSetPtr (self.track, BK_INSTRUMENT, instrument.instrument, 0);
 
 	[context unlock];
@@ -129,14 +299,45 @@
 	return waveform;
 }
 
+/**
+ * Exchange waveform and update its tracks
+ */
+- (void)replaceWaveform:(BKCWaveform *)newWaveform
+{
+	[waveform removeTrack:self];
+	waveform = newWaveform;
+	[waveform addTrack:self];
+}
+
 - (void)setWaveform:(BKCWaveform *)newWaveform
 {
-	[context lock];
+	BKCCommand command;
+	BKCCommandQueue * queue = context.commandQueue;
 
 	if (newWaveform == nil)
 		newWaveform = [BKCWaveform squareWaveform];
 
-	waveform = newWaveform;
+	if (queue) {
+		if (newWaveform.type == BK_CUSTOM) {
+			BKCCommandInit (& command, BKCCommandTypeSetPointer, self.track, BK_WAVEFORM);
+			command.pointer = newWaveform.data;
+		}
+		else {
+			BKCCommandInit (& command, BKCCommandTypeSetAttribute, self.track, BK_WAVEFORM);
+			command.value = newWaveform.type;
+		}
+
+		// previous waveform may be used until command is executed
+		if (pushCommand (queue, & command, waveform)) {
+			[self replaceWaveform:newWaveform];
+		}
+
+		return;
+	}
+
+	[context lock];
+
+	[self replaceWaveform:newWaveform];
 
 	if (waveform.type == BK_CUSTOM) {
 		BKSetPtr (self.track, BK_WAVEFORM, waveform.data, 0);
@@ -155,6 +356,25 @@
 
 - (void)setSample:(BKCSample *)newSample
 {
+	BKCCommand command;
+	BKCCommandQueue * queue = context.commandQueue;
+
+	if (sampleStream) {
+		self.sampleStream = nil;
+	}
+
+	if (queue) {
+		BKCCommandInit (& command, BKCCommandTypeSetPointer, self.track, BK_SAMPLE);
+		command.pointer = newSample.data;
+
+		// previous sample may be used until command is executed
+		if (pushCommand (queue, & command, sample)) {
+			sample = newSample;
+		}
+
+		return;
+	}
+
 	[context lock];
 
 	sample = newSample;
@@ -164,19 +384,74 @@
 	[context unlock];
 }
 
+- (BKCSampleStream *)sampleStream
+{
+	return sampleStream;
+}
+
+- (void)setSampleStream:(BKCSampleStream *)newSampleStream
+{
+	BKCallback callback;
+	BKCSampleStream * oldSampleStream = sampleStream;
+
+	if (newSampleStream && [newSampleStream attachToTrack:self.track] == NO) {
+		NSLog (@"*** Couldn't attach sample stream");
+		return;
+	}
+
+	[oldSampleStream detach];
+	sampleStream = nil;
+
+	if (newSampleStream) {
+		callback = newSampleStream.sampleCallback;
+	}
+	else {
+		memset (& callback, 0, sizeof (callback));
+	}
+
+	// previous stream may be used until its callback is replaced
+	[self setPointer:BK_SAMPLE_CALLBACK value:& callback size:sizeof (callback) retainingObject:oldSampleStream];
+	[self setPointer:BK_SAMPLE value:newSampleStream.currentChunk size:0];
+
+	if (newSampleStream) {
+		[self setAttribute:BK_SAMPLE_REPEAT value:BK_REPEAT];
+	}
+
+	sample       = nil;
+	sampleStream = newSampleStream;
+}
+
 - (BOOL)attachToContext:(BKCContext *)newContext
 {
 	BKInt res;
+	BKCCommand command;
+	BKCCommandQueue * queue;
 
 	if (!newContext)
 		return NO;
 
 	[context detachTrack:self];
+	[self cancelIdle];
 
 	[newContext lock];
 
-	if (![newContext attachTrack:self])
+	if (![newContext attachTrack:self]) {
+		[newContext unlock];
 		return NO;
+	}
+
+	queue = newContext.commandQueue;
+
+	if (queue) {
+		BKCCommandInit (& command, BKCCommandTypeAttachTrack, self.track, 0);
+		command.pointer = newContext.renderContext;
+
+		res = pushCommand (queue, & command, nil) ? 0 : -1;
+
+		[newContext unlock];
+
+		return res >= 0;
+	}
 
 	res = BKTrackAttach (track, context.renderContext);
 
@@ -187,29 +462,188 @@
 
 - (void)detach
 {
-	[context lock];
+	BKCCommand command;
+	BKCContext * theContext = context;
+	BKCCommandQueue * queue = theContext.commandQueue;
 
-	if ([context detachTrack:self])
-		BKTrackDetach (track);
+	[self cancelIdle];
+	[theContext lock];
 
-	[context unlock];
-	context = nil;
+	if ([theContext detachTrack:self]) {
+		if (queue) {
+			BKCCommandInit (& command, BKCCommandTypeDetachTrack, track, 0);
+
+			// track may be used until command is executed
+			pushCommand (queue, & command, self);
+		}
+		else {
+			BKTrackDetach (track);
+		}
+	}
+
+	[theContext unlock];
 }
 
 - (void)reset
 {
+	BKCCommand command;
+	BKCCommandQueue * queue = context.commandQueue;
+
+	if (queue) {
+		BKCCommandInit (& command, BKCCommandTypeResetTrack, track, 0);
+		pushCommand (queue, & command, nil);
+		[self forgetIdleValues];
+		[self wake];
+
+		return;
+	}
+
 	[context lock];
 	BKTrackReset (track);
 	[context unlock];
+
+	[self forgetIdleValues];
+	[self wake];
 }
 
-- (BOOL)setAttribute:(BKCAttr)attribute value:(BKInt)value
+/**
+ * Reset recorded values to a state which is not silent
+ */
+- (void)forgetIdleValues
 {
-	BKInt res;
+	idleValues [0] = -1;
+	idleValues [1] = -1;
+	idleValues [2] = 0;
+	volumeSlides   = NO;
+}
+
+/**
+ * Record an attribute which may make the track silent
+ */
+- (BOOL)recordIdleAttribute:(BKEnum)attribute value:(BKInt)value
+{
+	switch (attribute) {
+		case BK_VOLUME: {
+			idleValues [0] = value;
+			break;
+		}
+		case BK_MASTER_VOLUME: {
+			idleValues [1] = value;
+			break;
+		}
+		case BK_MUTE: {
+			idleValues [2] = value;
+			break;
+		}
+		case BK_EFFECT_VOLUME_SLIDE: {
+			volumeSlides = value != 0;
+			break;
+		}
+		default: {
+			return NO;
+		}
+	}
+
+	return YES;
+}
+
+/**
+ * Suspend the track if it became silent or wake it
+ */
+- (void)updateIdleState
+{
+	BKCCommand command;
+	BKCContext * theContext = context;
+	UInt64 delay = (UInt64) (theContext.idleTrackTimeout * theContext.sampleRate);
+	BOOL silent = (idleValues [0] == 0 || idleValues [1] == 0 || idleValues [2]) && !volumeSlides;
+
+	// tracks of the program are changed by the parser
+	if (theContext == nil || delay == 0 || [theContext parserDividerOfTrack:self]) {
+		silent = NO;
+	}
+
+	if (silent == idle) {
+		return;
+	}
+
+	if (!silent) {
+		[self wake];
+		return;
+	}
+
+	idle = YES;
+
+	BKCCommandInit (& command, BKCCommandTypeSuspendTrack, self.track, 0);
+	command.pointer = & idleGeneration;
+	command.value   = atomic_load_explicit (& idleGeneration, memory_order_relaxed);
+
+	// the fade to silence is still generated before detaching
+	[theContext scheduleCommand:& command atTime:MAX (theContext.frameTime, lastScheduledTime) + delay retainingObject:self];
+}
+
+/**
+ * Cancel pending suspending
+ */
+- (void)cancelIdle
+{
+	atomic_fetch_add_explicit (& idleGeneration, 1, memory_order_relaxed);
+	idle = NO;
+}
+
+/**
+ * Reattach track if it was suspended
+ */
+- (void)wake
+{
+	BKCCommand command;
+	BKCCommandQueue * queue = context.commandQueue;
+
+	if (!idle) {
+		return;
+	}
+
+	[self cancelIdle];
+
+	if (queue) {
+		BKCCommandInit (& command, BKCCommandTypeAttachTrack, self.track, 0);
+		command.pointer = [context synthesisContextOfTrack:self];
+		pushCommand (queue, & command, nil);
+
+		return;
+	}
 
 	[context lock];
-	res = BKSetAttr (self.track, attribute, value);
+	BKTrackAttach (track, [context synthesisContextOfTrack:self]);
 	[context unlock];
+}
+
+- (BOOL)setAttribute:(BKCAttr)attribute value:(BKInt)value
+{
+	BKInt res;
+	BKCCommand command;
+	BKCCommandQueue * queue = context.commandQueue;
+
+	if (sampleStream && attribute == BK_SAMPLE_REPEAT) {
+		sampleStream.repeatMode = value;
+
+		return YES;
+	}
+
+	if (queue) {
+		BKCCommandInit (& command, BKCCommandTypeSetAttribute, self.track, attribute);
+		command.value = value;
+
+		res = pushCommand (queue, & command, nil) ? 0 : -1;
+	}
+	else {
+		[context lock];
+		res = BKSetAttr (self.track, attribute, value);
+		[context unlock];
+	}
+
+	if (res >= 0 && [self recordIdleAttribute:attribute value:value]) {
+		[self updateIdleState];
+	}
 
 	return res >= 0;
 }
@@ -226,19 +660,60 @@
 }
 
 - (BOOL)setPointer:(BKCAttr)attribute value:(void *)value size:(NSUInteger)size
+{
+	BKInt const * values = value;
+
+	if (sampleStream && attribute == BK_SAMPLE_RANGE && size == sizeof (BKInt [2])) {
+		sampleStream.range = NSMakeRange (MIN (values [0], values [1]), ABS (values [1] - values [0]));
+		[sampleStream rewind];
+
+		return YES;
+	}
+
+	return [self setPointer:attribute value:value size:size retainingObject:nil];
+}
+
+/**
+ * Set pointer
+ *
+ * If queued, `object` is kept alive until the command was executed
+ */
+- (BOOL)setPointer:(BKCAttr)attribute value:(void *)value size:(NSUInteger)size retainingObject:(id)object
 {
 	BKInt res;
+	BKCCommand command;
+	BKCCommandQueue * queue = context.commandQueue;
 
-	[context lock];
+	if (queue) {
+		BKCCommandType type = (attribute & BK_EFFECT_TYPE) ? BKCCommandTypeSetEffect : BKCCommandTypeSetPointer;
 
-	if (attribute & BK_EFFECT_TYPE) {
-		res = BKTrackSetEffect (track, attribute, value, (BKInt)size);
+		BKCCommandInit (& command, type, self.track, attribute);
+
+		if (!BKCCommandSetValues (& command, value, size)) {
+			NSLog (@"*** Value of size %lu is too large to be queued", (unsigned long) size);
+
+			return NO;
+		}
+
+		res = pushCommand (queue, & command, object) ? 0 : -1;
 	}
 	else {
-		res = BKSetPtr (self.track, attribute, value, size);
+		[context lock];
+
+		if (attribute & BK_EFFECT_TYPE) {
+			res = BKTrackSetEffect (track, attribute, value, (BKInt)size);
+		}
+		else {
+			res = BKSetPtr (self.track, attribute, value, size);
+		}
+
+		[context unlock];
+	}
+
+	if (res >= 0 && attribute == BK_EFFECT_VOLUME_SLIDE && size >= sizeof (BKInt)) {
+		[self recordIdleAttribute:attribute value:*(BKInt const *) value];
+		[self updateIdleState];
 	}
-	
-	[context unlock];
 
 	return res >= 0;
 }
@@ -273,7 +748,88 @@
 
 - (BKInt)setEffect:(BKCAttr)effect values:(BKInt const [3])values
 {
-	return BKTrackSetEffect (track, effect, values, (BKInt)sizeof (BKInt [3]));
+	BKInt res;
+	BKCCommand command;
+	BKCCommandQueue * queue = context.commandQueue;
+
+	if (queue) {
+		BKCCommandInit (& command, BKCCommandTypeSetEffect, self.track, effect);
+		BKCCommandSetValues (& command, values, sizeof (BKInt [3]));
+
+		res = pushCommand (queue, & command, nil) ? 0 : -1;
+	}
+	else {
+		res = BKTrackSetEffect (track, effect, values, (BKInt)sizeof (BKInt [3]));
+	}
+
+	if (res >= 0 && [self recordIdleAttribute:effect value:values [0]]) {
+		[self updateIdleState];
+	}
+
+	return res;
+}
+
+- (BOOL)setAttribute:(BKCAttr)attribute value:(BKInt)value atTime:(UInt64)time
+{
+	BKCCommand command;
+
+	BKCCommandInit (& command, BKCCommandTypeSetAttribute, self.track, attribute);
+	command.value = value;
+
+	[self recordScheduledAttribute:attribute value:value atTime:time];
+
+	return [context scheduleCommand:& command atTime:time retainingObject:self];
+}
+
+/**
+ * Wake track before a scheduled change
+ *
+ * The track is suspended earliest after the last scheduled change.
+ */
+- (void)recordScheduledTime:(UInt64)time
+{
+	lastScheduledTime = MAX (lastScheduledTime, time);
+	[self wake];
+}
+
+/**
+ * Wake track before a scheduled change of an attribute
+ *
+ * Recorded values are those after the change.
+ */
+- (void)recordScheduledAttribute:(BKEnum)attribute value:(BKInt)value atTime:(UInt64)time
+{
+	[self recordIdleAttribute:attribute value:value];
+	[self recordScheduledTime:time];
+}
+
+- (BOOL)setPointer:(BKCAttr)attribute value:(void *)value size:(NSUInteger)size atTime:(UInt64)time
+{
+	BKCCommand command;
+	BKCCommandType type = (attribute & BK_EFFECT_TYPE) ? BKCCommandTypeSetEffect : BKCCommandTypeSetPointer;
+
+	BKCCommandInit (& command, type, self.track, attribute);
+
+	// pointers to other objects are not kept alive
+	if (size == 0 || !BKCCommandSetValues (& command, value, size)) {
+		NSLog (@"*** Only copied values can be scheduled");
+		return NO;
+	}
+
+	// values of other attributes may be smaller than BKInt
+	if (attribute == BK_EFFECT_VOLUME_SLIDE && size >= sizeof (BKInt)) {
+		[self recordScheduledAttribute:attribute value:*(BKInt const *) value atTime:time];
+	}
+	else {
+		[self recordScheduledTime:time];
+	}
+
+	return [context scheduleCommand:& command atTime:time retainingObject:self];
+}
+
+- (BOOL)setEffect:(BKCAttr)effect values:(BKInt const [3])values atTime:(UInt64)time
+{
+	return [self setPointer:effect value:(void *) values size:sizeof (BKInt [3]) atTime:time];
 }
 
 - (BKInt)getEffect:(BKCAttr)effect values:(BKInt [3])values
@@ -0,0 +1,71 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import "BKCTrack.h"
+
+/**
+ * Set pointer attribute of tracks at the next buffer boundary
+ *
+ * All tracks of a context are changed in the same buffer: with a
+ * commandQueue the commands are pushed at once, otherwise the lock is taken
+ * once. If the command queue is full, the pointer is set with the lock held
+ * or, while the render thread renders without lock, pushing is retried.
+ * `dispose` is called after no track uses the previous pointer anymore.
+ */
+extern void BKCTrackSetPointerOfTracks (NSArray * tracks, BKEnum attribute, void * pointer, void (^ dispose) (void));
+
+@interface BKCTrack ()
+
+/**
+ * Whether the track is suspended or about to be suspended
+ *
+ * Idle tracks are detached from the BlipKit context and reattached by the
+ * next change.
+ */
+@property (readonly, nonatomic, getter=isIdle) BOOL idle;
+
+@end
+
+@interface BKCWaveform (BKCTrackUsers)
+
+/**
+ * Tracks using the waveform
+ */
+- (NSArray *)tracks;
+
+- (void)addTrack:(BKCTrack *)track;
+- (void)removeTrack:(BKCTrack *)track;
+
+@end
+
+@interface BKCInstrument (BKCTrackUsers)
+
+/**
+ * Tracks using the instrument
+ */
+- (NSArray *)tracks;
+
+- (void)addTrack:(BKCTrack *)track;
+- (void)removeTrack:(BKCTrack *)track;
+
+@end
@@ -0,0 +1,156 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+#import <stdatomic.h>
+#import "BKCContext.h"
+#import "BKCInstrument.h"
+#import "BKCTrack.h"
+#import "BKCWaveform.h"
+
+typedef NS_ENUM(NSInteger, BKCVoiceStealing)
+{
+	BKCVoiceStealingOldest,    // Steal voice which was triggered first
+	BKCVoiceStealingQuietest,  // Steal released voice or voice with the lowest volume
+};
+
+struct BKCVoice;
+
+/**
+ * A fixed number of tracks which play notes triggered on demand
+ *
+ * All tracks are allocated and attached once when the pool is created.
+ * Triggering a note takes a free voice in constant time without allocating
+ * memory or taking the render lock; the note is played using the context's
+ * event scheduler. A voice is returned to the pool when its note and the
+ * release phase of the instrument's volume envelope have finished. If no
+ * voice is free, a playing voice is stolen.
+ *
+ * Trigger methods have to be called from a single thread at a time.
+ */
+@interface BKCVoicePool : NSObject
+{
+	NSArray          * voices;
+	struct BKCVoice  * states;
+	atomic_int       * generations;
+	NSMutableData    * generationData;
+	NSUInteger       * freeVoices;
+	NSUInteger         numFreeVoices;
+	NSUInteger       * heap;
+	NSUInteger         heapSize;
+	NSUInteger         firstVoice;
+	NSUInteger         lastVoice;
+	NSUInteger         numStolenVoices;
+	UInt64             releaseFrames;
+	BKCInstrument    * instrument;
+}
+
+/**
+ * The context the voices are attached to
+ */
+@property (readonly, nonatomic, weak) BKCContext * context;
+
+/**
+ * The tracks of the voices
+ *
+ * Tracks can be configured but must not be detached.
+ */
+@property (readonly, nonatomic) NSArray * voices;
+
+/**
+ * Number of voices
+ */
+@property (readonly, nonatomic) NSUInteger numberOfVoices;
+
+/**
+ * Number of voices which are currently playing
+ */
+@property (readonly, nonatomic) NSUInteger numberOfPlayingVoices;
+
+/**
+ * Number of voices which were stolen so far
+ */
+@property (readonly, nonatomic) NSUInteger numberOfStolenVoices;
+
+/**
+ * Which voice is stolen if all are playing
+ *
+ * Default is BKCVoiceStealingOldest
+ */
+@property (readwrite, nonatomic) BKCVoiceStealing stealing;
+
+/**
+ * Instrument assigned to all voices
+ *
+ * Its volume envelope determines when a released voice is free again.
+ * Should be set before triggering notes.
+ */
+@property (readwrite, nonatomic) BKCInstrument * instrument;
+
+/**
+ * Default note duration in frames used by `trigger:`
+ */
+@property (readwrite, nonatomic) UInt64 noteDuration;
+
+/**
+ * Default volume used by `trigger:`
+ */
+@property (readwrite, nonatomic) BKInt volume;
+
+/**
+ * Allocate tracks with waveform and attach them to context
+ */
+- (instancetype)initWithContext:(BKCContext *)context numberOfVoices:(NSUInteger)numberOfVoices waveform:(BKCWaveform *)waveform;
+
+/**
+ * Play note immediately with default volume and duration
+ *
+ * `note` is the value of BK_NOTE.
+ * Returns the track of the voice. Returns nil if the note couldn't be
+ * scheduled.
+ */
+- (BKCTrack *)trigger:(BKInt)note;
+
+/**
+ * Play note immediately
+ */
+- (BKCTrack *)trigger:(BKInt)note volume:(BKInt)volume duration:(UInt64)duration;
+
+/**
+ * Play note at frame time of context
+ *
+ * The note is released after `duration` frames. Times of successive
+ * triggers should not decrease.
+ */
+- (BKCTrack *)trigger:(BKInt)note volume:(BKInt)volume duration:(UInt64)duration atTime:(UInt64)time;
+
+@end
+
+@interface BKCContext (BKCVoicePool)
+
+/**
+ * Create voice pool attached to this context
+ */
+- (BKCVoicePool *)voicePoolWithNumberOfVoices:(NSUInteger)numberOfVoices waveform:(BKCWaveform *)waveform;
+
+@end
@@ -0,0 +1,412 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import "BKCVoicePool.h"
+
+#define DEFAULT_NOTE_DURATION 0.25
+
+struct BKCVoice
+{
+	NSUInteger prev;       // Playing voices ordered by trigger time
+	NSUInteger next;
+	NSUInteger heapIndex;  // Position in `heap` ordered by `endTime`
+	UInt64     startTime;
+	UInt64     releaseTime;
+	UInt64     endTime;    // Time at which the note and the envelope have finished
+	BKInt      volume;
+};
+
+typedef struct BKCVoice BKCVoice;
+
+@interface BKCVoicePool ()
+
+@property (readwrite, nonatomic, weak) BKCContext * context;
+
+@end
+
+@implementation BKCVoicePool
+
+@synthesize context;
+@synthesize voices;
+@synthesize stealing;
+@synthesize noteDuration;
+@synthesize volume;
+
+/**
+ * Swap heap items and update their positions
+ */
+static void heapSwap (BKCVoice * states, NSUInteger * heap, NSUInteger a, NSUInteger b)
+{
+	NSUInteger voice = heap [a];
+
+	heap [a] = heap [b];
+	heap [b] = voice;
+
+	states [heap [a]].heapIndex = a;
+	states [heap [b]].heapIndex = b;
+}
+
+/**
+ * Restore heap order after item at `index` has changed
+ */
+static void heapUpdate (BKCVoice * states, NSUInteger * heap, NSUInteger size, NSUInteger index)
+{
+	NSUInteger child;
+
+	while (index > 0 && states [heap [index]].endTime < states [heap [(index - 1) / 2]].endTime) {
+		heapSwap (states, heap, index, (index - 1) / 2);
+		index = (index - 1) / 2;
+	}
+
+	while ((child = 2 * index + 1) < size) {
+		if (child + 1 < size && states [heap [child + 1]].endTime < states [heap [child]].endTime) {
+			child ++;
+		}
+
+		if (states [heap [index]].endTime <= states [heap [child]].endTime) {
+			break;
+		}
+
+		heapSwap (states, heap, index, child);
+		index = child;
+	}
+}
+
+- (instancetype)init
+{
+	return [self initWithContext:nil numberOfVoices:0 waveform:nil];
+}
+
+- (instancetype)initWithContext:(BKCContext *)theContext numberOfVoices:(NSUInteger)numberOfVoices waveform:(BKCWaveform *)waveform
+{
+	if ((self = [super init])) {
+		NSMutableArray * tracks;
+
+		if (theContext == nil || numberOfVoices == 0) {
+			NSLog (@"*** Voice pool needs a context and at least one voice");
+			return nil;
+		}
+
+		states         = calloc (numberOfVoices, sizeof (BKCVoice));
+		freeVoices     = malloc (numberOfVoices * sizeof (NSUInteger));
+		heap           = malloc (numberOfVoices * sizeof (NSUInteger));
+		generationData = [[NSMutableData alloc] initWithLength:numberOfVoices * sizeof (atomic_int)];
+		generations    = generationData.mutableBytes;
+
+		if (states == NULL || freeVoices == NULL || heap == NULL) {
+			NSLog (@"*** Couldn't allocate voices");
+			return nil;
+		}
+
+		tracks = [[NSMutableArray alloc] initWithCapacity:numberOfVoices];
+
+		for (NSUInteger i = 0; i < numberOfVoices; i ++) {
+			BKCTrack * track = [[BKCTrack alloc] initWithWaveform:waveform ?: [BKCWaveform squareWaveform]];
+
+			if (![track attachToContext:theContext]) {
+				NSLog (@"*** Couldn't attach voice");
+				return nil;
+			}
+
+			[tracks addObject:track];
+			atomic_init (& generations [i], 0);
+
+			// voice 0 is on top
+			freeVoices [i] = numberOfVoices - 1 - i;
+		}
+
+		voices        = tracks;
+		context       = theContext;
+		numFreeVoices = numberOfVoices;
+		firstVoice    = NSNotFound;
+		lastVoice     = NSNotFound;
+		noteDuration  = (UInt64) (DEFAULT_NOTE_DURATION * theContext.sampleRate);
+		volume        = BK_MAX_VOLUME;
+
+		[self updateReleaseFrames];
+	}
+
+	return self;
+}
+
+- (void)dealloc
+{
+	UInt64 endTime = 0;
+	BKCContext * theContext = context;
+
+	for (NSUInteger i = 0; i < heapSize; i ++) {
+		endTime = MAX (endTime, states [heap [i]].endTime);
+	}
+
+	for (BKCTrack * track in voices) {
+		[track detach];
+	}
+
+	// scheduled notes reference the tracks and generations
+	if (theContext && heapSize) {
+		[theContext.eventScheduler retainObject:@[voices, generationData] untilTime:endTime];
+	}
+
+	if (states) {
+		free (states);
+	}
+
+	if (freeVoices) {
+		free (freeVoices);
+	}
+
+	if (heap) {
+		free (heap);
+	}
+}
+
+- (NSUInteger)numberOfVoices
+{
+	return voices.count;
+}
+
+- (NSUInteger)numberOfPlayingVoices
+{
+	[self reclaimVoicesUntilTime:context.frameTime];
+
+	return voices.count - numFreeVoices;
+}
+
+- (NSUInteger)numberOfStolenVoices
+{
+	return numStolenVoices;
+}
+
+- (BKCInstrument *)instrument
+{
+	return instrument;
+}
+
+- (void)setInstrument:(BKCInstrument *)newInstrument
+{
+	instrument = newInstrument;
+
+	for (BKCTrack * track in voices) {
+		track.instrument = instrument;
+	}
+
+	[self updateReleaseFrames];
+}
+
+/**
+ * Calculate number of frames the volume envelope needs after the note was
+ * released
+ *
+ * Adds a tick because sequences only advance at ticks.
+ */
+- (void)updateReleaseFrames
+{
+	BKTime period;
+	BKInt divider = 1;
+	NSUInteger ticks = 0;
+	BKCTrack * track = voices [0];
+	BKCInstrumentSequence * sequence = [instrument sequenceWithType:BK_SEQUENCE_VOLUME];
+
+	if (sequence == nil || sequence.format == BKCSequenceFormatUndefined) {
+		releaseFrames = 0;
+		return;
+	}
+
+	if (sequence.format == BKCSequenceFormatEnvelope) {
+		BKSequencePhase const * phases = sequence.phases;
+
+		for (NSUInteger i = NSMaxRange (sequence.sustainRange); i < sequence.length; i ++) {
+			ticks += phases [i].steps;
+		}
+	}
+	else if (NSMaxRange (sequence.sustainRange) < sequence.length) {
+		ticks = sequence.length - NSMaxRange (sequence.sustainRange);
+	}
+
+	[context lock];
+	BKGetPtr (context.renderContext, BK_CLOCK_PERIOD, & period, sizeof (period));
+	BKGetAttr (track.track, BK_INSTRUMENT_DIVIDER, & divider);
+	[context unlock];
+
+	releaseFrames = (UInt64) ((ticks + 1) * MAX (divider, 1) * ((double) BKTimeGetTime (period) + (double) BKTimeGetFrac (period) / BK_FINT20_UNIT));
+}
+
+/**
+ * Remove voice from playing voices
+ */
+- (void)removePlayingVoice:(NSUInteger)index
+{
+	BKCVoice * voice = & states [index];
+	NSUInteger position;
+
+	if (voice -> prev != NSNotFound) {
+		states [voice -> prev].next = voice -> next;
+	}
+	else {
+		firstVoice = voice -> next;
+	}
+
+	if (voice -> next != NSNotFound) {
+		states [voice -> next].prev = voice -> prev;
+	}
+	else {
+		lastVoice = voice -> prev;
+	}
+
+	position = voice -> heapIndex;
+	heapSize --;
+
+	if (position != heapSize) {
+		heapSwap (states, heap, position, heapSize);
+		heapUpdate (states, heap, heapSize, position);
+	}
+}
+
+/**
+ * Return voices which have finished before `time`
+ */
+- (void)reclaimVoicesUntilTime:(UInt64)time
+{
+	while (heapSize && states [heap [0]].endTime <= time) {
+		NSUInteger index = heap [0];
+
+		[self removePlayingVoice:index];
+		freeVoices [numFreeVoices ++] = index;
+	}
+}
+
+/**
+ * Select voice to steal
+ */
+- (NSUInteger)voiceToStealAtTime:(UInt64)time
+{
+	NSUInteger selected = firstVoice;
+
+	if (stealing == BKCVoiceStealingQuietest) {
+		for (NSUInteger index = states [firstVoice].next; index != NSNotFound; index = states [index].next) {
+			BKCVoice const * voice = & states [index];
+			BKCVoice const * other = & states [selected];
+			BOOL released = voice -> releaseTime <= time;
+			BOOL otherReleased = other -> releaseTime <= time;
+
+			// prefer released voices which end first, then voices with the lowest volume
+			if (released != otherReleased) {
+				if (released) {
+					selected = index;
+				}
+			}
+			else if (released ? voice -> endTime < other -> endTime : voice -> volume < other -> volume) {
+				selected = index;
+			}
+		}
+	}
+
+	return selected;
+}
+
+- (BKCTrack *)trigger:(BKInt)note
+{
+	return [self trigger:note volume:volume duration:noteDuration];
+}
+
+- (BKCTrack *)trigger:(BKInt)note volume:(BKInt)noteVolume duration:(UInt64)duration
+{
+	return [self trigger:note volume:noteVolume duration:duration atTime:context.frameTime];
+}
+
+- (BKCTrack *)trigger:(BKInt)note volume:(BKInt)noteVolume duration:(UInt64)duration atTime:(UInt64)time
+{
+	NSUInteger index;
+	BKCVoice * voice;
+	BKCCommand command;
+	BKCTrack * track;
+	BKCContext * theContext = context;
+	BOOL success;
+
+	// voices which have finished until `time` are free
+	[self reclaimVoicesUntilTime:time];
+
+	if (numFreeVoices) {
+		index = freeVoices [-- numFreeVoices];
+	}
+	else {
+		index = [self voiceToStealAtTime:time];
+		[self removePlayingVoice:index];
+		numStolenVoices ++;
+
+		// the previous note must not release the new one
+		atomic_fetch_add_explicit (& generations [index], 1, memory_order_relaxed);
+	}
+
+	track = voices [index];
+	voice = & states [index];
+
+	voice -> startTime   = time;
+	voice -> releaseTime = time + duration;
+	voice -> endTime     = voice -> releaseTime + releaseFrames;
+	voice -> volume      = noteVolume;
+
+	// append to playing voices
+	voice -> prev = lastVoice;
+	voice -> next = NSNotFound;
+
+	if (lastVoice != NSNotFound) {
+		states [lastVoice].next = index;
+	}
+	else {
+		firstVoice = index;
+	}
+
+	lastVoice = index;
+
+	voice -> heapIndex = heapSize;
+	heap [heapSize ++] = index;
+	heapUpdate (states, heap, heapSize, voice -> heapIndex);
+
+	// tracks are kept alive by the pool
+	BKCCommandInit (& command, BKCCommandTypeSetAttribute, track.track, BK_VOLUME);
+	command.value = noteVolume;
+	success = [theContext scheduleCommand:& command atTime:time retainingObject:nil];
+
+	BKCCommandInit (& command, BKCCommandTypeSetAttribute, track.track, BK_NOTE);
+	command.value = note;
+	success = success && [theContext scheduleCommand:& command atTime:time retainingObject:nil];
+
+	BKCCommandInit (& command, BKCCommandTypeReleaseNote, track.track, 0);
+	command.value   = atomic_load_explicit (& generations [index], memory_order_relaxed);
+	command.pointer = & generations [index];
+	success = success && [theContext scheduleCommand:& command atTime:voice -> releaseTime retainingObject:nil];
+
+	return success ? track : nil;
+}
+
+@end
+
+@implementation BKCContext (BKCVoicePool)
+
+- (BKCVoicePool *)voicePoolWithNumberOfVoices:(NSUInteger)numberOfVoices waveform:(BKCWaveform *)waveform
+{
+	return [[BKCVoicePool alloc] initWithContext:self numberOfVoices:numberOfVoices waveform:waveform];
+}
+
+@end
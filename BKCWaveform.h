@@ -29,7 +29,10 @@
 
 @interface BKCWaveform : BKCSequence
 {
-	BKData data;
+	BKData      * data;
+	NSHashTable * tracks;
+	NSInteger     editCount;
+	NSRange       editedRange;
 }
 
 /**
@@ -39,9 +42,16 @@
 
 /**
  * Underlaying data object
+ *
+ * Is replaced by commitEditing
  */
 @property (readonly, nonatomic) BKData * data;
 
+/**
+ * Range of values changed since beginEditing
+ */
+@property (readonly, nonatomic) NSRange editedRange;
+
 /**
  * Get square waveform
  */
@@ -86,4 +96,21 @@
  */
 - (BOOL)setValues:(BKFrame const *)values length:(NSUInteger)length;
 
+/**
+ * Begin a batch of edits
+ *
+ * Until the matching commitEditing, changed values are only collected and
+ * tracks keep playing the previous data. Calls can be nested.
+ */
+- (void)beginEditing;
+
+/**
+ * Apply edits made since beginEditing
+ *
+ * Builds new data without holding the lock and replaces the data of all
+ * tracks using this waveform at the next buffer boundary. The previous data
+ * is disposed after no track uses it anymore.
+ */
+- (BOOL)commitEditing;
+
 @end
@@ -22,6 +22,7 @@
  */
 
 #import "BKCWaveform.h"
+#import "BKCTrack_internal.h"
 
 @implementation BKCWaveform
 
@@ -32,6 +33,40 @@ static id sawtoothWaveform;
 static id sineWaveform;
 
 @synthesize type;
+@synthesize editedRange;
+
+/**
+ * Allocate empty data object
+ */
+static BKData * allocData (void)
+{
+	BKInt res;
+	BKData * data = malloc (sizeof (BKData));
+
+	if (data == NULL) {
+		NSLog (@"*** Couldn't allocate BKData");
+		return NULL;
+	}
+
+	res = BKDataInit (data);
+
+	if (res < 0) {
+		NSLog (@"*** Couldn't initialize BKData: %d", res);
+		free (data);
+		return NULL;
+	}
+
+	return data;
+}
+
+/**
+ * Dispose and free data object
+ */
+static void freeData (BKData * data)
+{
+	BKDispose (data);
+	free (data);
+}
 
 + (instancetype)squareWaveform
 {
@@ -85,14 +120,12 @@ static id sineWaveform;
 
 - (instancetype)initWithType:(BKEnum)theType
 {
-	BKInt res;
-
 	if (self = [super initWithLength:0 numberOfComponents:1 valueSize:sizeof (BKFrame)]) {
-		type = theType;
-		res  = BKDataInit (& data);
+		type   = theType;
+		data   = allocData ();
+		tracks = [NSHashTable weakObjectsHashTable];
 
-		if (res < 0) {
-			NSLog (@"*** Couldn't initialize BKData: %d", res);
+		if (data == NULL) {
 			return nil;
 		}
 	}
@@ -116,11 +149,21 @@ static id sineWaveform;
 	BKInt res;
 
 	if (self = [super init]) {
-		type = BK_CUSTOM;
-		res  = BKDataInitCopy(& data, newData);
+		type   = BK_CUSTOM;
+		data   = malloc (sizeof (BKData));
+		tracks = [NSHashTable weakObjectsHashTable];
+
+		if (data == NULL) {
+			NSLog (@"*** Couldn't allocate BKData");
+			return nil;
+		}
+
+		res = BKDataInitCopy (data, newData);
 
 		if (res < 0) {
 			NSLog (@"*** Couldn't initialize BKData: %d", res);
+			free (data);
+			data = NULL;
 			return nil;
 		}
 	}
@@ -130,7 +173,9 @@ static id sineWaveform;
 
 - (void)dealloc
 {
-	BKDispose (& data);
+	if (data) {
+		freeData (data);
+	}
 }
 
 - (BKFrame const *)phases
@@ -140,7 +185,7 @@ static id sineWaveform;
 
 - (BKData *)data
 {
-	return & data;
+	return data;
 }
 
 - (BOOL)updateData
@@ -151,7 +196,7 @@ static id sineWaveform;
 		return NO;
 	}
 
-	res = BKDataSetFrames (& data, values, (BKInt)self.length, 1, YES);
+	res = BKDataSetFrames (data, values, (BKInt)self.length, 1, YES);
 	
 	if (res < 0) {
 		NSLog (@"*** Setting frames failed: %d", res);
@@ -185,8 +230,87 @@ static id sineWaveform;
 
 - (void)replaceValuesInRange:(NSRange)range withValues:(const void *)newValues length:(NSUInteger)length
 {
+	NSRange changedRange;
+
 	[super replaceValuesInRange:range withValues:newValues length:length];
-	[self updateData];
+
+	if (editCount == 0) {
+		[self updateData];
+		return;
+	}
+
+	// values after a change in length are shifted
+	changedRange.location = range.location;
+	changedRange.length   = range.length != length ? self.length - range.location : length;
+
+	editedRange = editedRange.length ? NSUnionRange (editedRange, changedRange) : changedRange;
+}
+
+- (void)beginEditing
+{
+	if (editCount ++ == 0) {
+		editedRange = NSMakeRange (0, 0);
+	}
+}
+
+- (BOOL)commitEditing
+{
+	BKInt res;
+	BKData * oldData;
+	BKData * changedData;
+
+	if (editCount == 0) {
+		NSLog (@"*** commitEditing called without beginEditing");
+		return NO;
+	}
+
+	if (-- editCount > 0 || editedRange.length == 0) {
+		return YES;
+	}
+
+	if (self.length < 2) {
+		NSLog (@"*** Number of phases must be at least 2");
+		return NO;
+	}
+
+	// BKDataSetFrames normalizes all frames; the data is always rebuilt
+	if ((changedData = allocData ()) == NULL) {
+		return NO;
+	}
+
+	res = BKDataSetFrames (changedData, values, (BKInt)self.length, 1, YES);
+
+	if (res < 0) {
+		NSLog (@"*** Setting frames failed: %d", res);
+		freeData (changedData);
+		return NO;
+	}
+
+	oldData = data;
+	data    = changedData;
+
+	BKCTrackSetPointerOfTracks (tracks.allObjects, BK_WAVEFORM, data, ^{
+		freeData (oldData);
+	});
+
+	return YES;
+}
+
+- (NSArray *)tracks
+{
+	return tracks.allObjects;
+}
+
+- (void)addTrack:(BKCTrack *)track
+{
+	if (type == BK_CUSTOM) {
+		[tracks addObject:track];
+	}
+}
+
+- (void)removeTrack:(BKCTrack *)track
+{
+	[tracks removeObject:track];
 }
 
 @end
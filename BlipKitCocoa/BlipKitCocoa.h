@@ -20,8 +20,24 @@ FOUNDATION_EXPORT const unsigned char BlipKitCocoaVersionString[];
 #import <BlipKitCocoa/BKTK.h>
 #import <BlipKitCocoa/BKCAudioUnit.h>
 #import <BlipKitCocoa/BKCBase.h>
+#import <BlipKitCocoa/BKCBatchRenderer.h>
+#import <BlipKitCocoa/BKCCheckpoints.h>
+#import <BlipKitCocoa/BKCCommandQueue.h>
 #import <BlipKitCocoa/BKCContext.h>
 #import <BlipKitCocoa/BKCDivider.h>
+#import <BlipKitCocoa/BKCEventScheduler.h>
 #import <BlipKitCocoa/BKCInstrument.h>
+#import <BlipKitCocoa/BKCLoadStatistics.h>
+#import <BlipKitCocoa/BKCOutputKernels.h>
+#import <BlipKitCocoa/BKCParallelSynthesis.h>
+#import <BlipKitCocoa/BKCProgram.h>
+#import <BlipKitCocoa/BKCProgramArchive.h>
+#import <BlipKitCocoa/BKCRealtimeChecker.h>
+#import <BlipKitCocoa/BKCRenderCounters.h>
+#import <BlipKitCocoa/BKCRenderPipeline.h>
+#import <BlipKitCocoa/BKCResampler.h>
 #import <BlipKitCocoa/BKCSample.h>
+#import <BlipKitCocoa/BKCSampleStream.h>
+#import <BlipKitCocoa/BKCStems.h>
 #import <BlipKitCocoa/BKCTrack.h>
+#import <BlipKitCocoa/BKCVoicePool.h>
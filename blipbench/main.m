@@ -0,0 +1,652 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+#import <getopt.h>
+#ifdef __APPLE__
+#import <malloc/malloc.h>
+#import <mach/mach.h>
+#endif
+#import "BKCContext.h"
+#import "BKCDivider.h"
+#import "BKCInstrument.h"
+#import "BKCOutputKernels.h"
+#import "BKCRealtimeChecker.h"
+#import "BKCRenderCounters.h"
+#import "BKCSample.h"
+#import "BKCTrack.h"
+#import "BKCWaveform.h"
+
+#define BENCHMARK_VERSION 2
+#define DEFAULT_DURATION 5.0
+#define WARMUP_DURATION 0.25
+#define NUM_CHANNELS 2
+#define NOTE_TICKS 24
+
+typedef NS_ENUM(NSUInteger, BKCBenchmarkWaveform)
+{
+	BKCBenchmarkWaveformSquare,
+	BKCBenchmarkWaveformTriangle,
+	BKCBenchmarkWaveformNoise,
+	BKCBenchmarkWaveformSawtooth,
+	BKCBenchmarkWaveformSine,
+	BKCBenchmarkWaveformCustom,
+	BKCBenchmarkWaveformSample,
+	BKCBenchmarkWaveformCount,
+};
+
+typedef NS_ENUM(NSUInteger, BKCBenchmarkEffect)
+{
+	BKCBenchmarkEffectNone,
+	BKCBenchmarkEffectVibrato,
+	BKCBenchmarkEffectTremolo,
+	BKCBenchmarkEffectPortamento,
+	BKCBenchmarkEffectSlides,
+	BKCBenchmarkEffectCount,
+};
+
+typedef NS_ENUM(NSUInteger, BKCBenchmarkOutput)
+{
+	BKCBenchmarkOutputInt16,
+	BKCBenchmarkOutputInt16Planar,
+	BKCBenchmarkOutputFloat32,
+	BKCBenchmarkOutputFloat32Planar,
+	BKCBenchmarkOutputCount,
+};
+
+typedef NS_ENUM(NSUInteger, BKCBenchmarkFormat)
+{
+	BKCBenchmarkFormatJSON,
+	BKCBenchmarkFormatCSV,
+};
+
+typedef struct
+{
+	char const         * sweep;
+	NSUInteger           numTracks;
+	BKCBenchmarkWaveform waveform;
+	BKCBenchmarkEffect   effect;
+	BOOL                 instrument;
+	UInt32               sampleRate;
+	UInt32               bufferSize;
+	BKCBenchmarkOutput   output;
+	BKCOutputKernelType  kernel;
+} BKCBenchmarkCase;
+
+typedef struct
+{
+	UInt64 numFrames;
+	UInt64 time;
+	UInt64 numAllocations;
+} BKCBenchmarkResult;
+
+static char const * const waveformNames [BKCBenchmarkWaveformCount] = {
+	"square", "triangle", "noise", "sawtooth", "sine", "custom", "sample",
+};
+
+static char const * const effectNames [BKCBenchmarkEffectCount] = {
+	"none", "vibrato", "tremolo", "portamento", "slides",
+};
+
+static char const * const outputNames [BKCBenchmarkOutputCount] = {
+	"int16", "int16Planar", "float32", "float32Planar",
+};
+
+static BKCBenchmarkCase baseline = {
+	.sweep      = "baseline",
+	.numTracks  = 8,
+	.waveform   = BKCBenchmarkWaveformSquare,
+	.effect     = BKCBenchmarkEffectNone,
+	.instrument = NO,
+	.sampleRate = 44100,
+	.bufferSize = 512,
+	.output     = BKCBenchmarkOutputInt16,
+	.kernel     = BKCOutputKernelTypeScalar,  // Set to the best supported kernels in main
+};
+
+static NSUInteger const trackCounts [] = {1, 2, 4, 8, 16, 32, 64};
+static UInt32 const sampleRates [] = {22050, 44100, 48000, 96000};
+static UInt32 const bufferSizes [] = {64, 128, 256, 512, 1024, 4096};
+
+static atomic_ullong numAllocations;
+
+#ifdef __APPLE__
+
+/**
+ * Allocation counting
+ *
+ * Wraps the allocation functions of the default malloc zone
+ */
+static void * (* zoneMalloc) (malloc_zone_t *, size_t);
+static void * (* zoneCalloc) (malloc_zone_t *, size_t, size_t);
+static void * (* zoneRealloc) (malloc_zone_t *, void *, size_t);
+
+static void * countingMalloc (malloc_zone_t * zone, size_t size)
+{
+	atomic_fetch_add_explicit (& numAllocations, 1, memory_order_relaxed);
+
+	return zoneMalloc (zone, size);
+}
+
+static void * countingCalloc (malloc_zone_t * zone, size_t count, size_t size)
+{
+	atomic_fetch_add_explicit (& numAllocations, 1, memory_order_relaxed);
+
+	return zoneCalloc (zone, count, size);
+}
+
+static void * countingRealloc (malloc_zone_t * zone, void * ptr, size_t size)
+{
+	atomic_fetch_add_explicit (& numAllocations, 1, memory_order_relaxed);
+
+	return zoneRealloc (zone, ptr, size);
+}
+
+static BOOL installAllocationCounter (void)
+{
+	malloc_zone_t * zone = malloc_default_zone ();
+
+	if (vm_protect (mach_task_self (), (vm_address_t) zone, sizeof (*zone), 0, VM_PROT_READ | VM_PROT_WRITE) != KERN_SUCCESS) {
+		return NO;
+	}
+
+	zoneMalloc  = zone -> malloc;
+	zoneCalloc  = zone -> calloc;
+	zoneRealloc = zone -> realloc;
+
+	zone -> malloc  = countingMalloc;
+	zone -> calloc  = countingCalloc;
+	zone -> realloc = countingRealloc;
+
+	vm_protect (mach_task_self (), (vm_address_t) zone, sizeof (*zone), 0, VM_PROT_READ);
+
+	return YES;
+}
+
+#elif defined (__linux__) && !BKC_REALTIME_CHECKS
+
+/**
+ * Allocation counting
+ *
+ * Replaces the allocation functions of the C library and forwards to its
+ * internal entry points; `free` is left untouched
+ */
+extern void * __libc_malloc (size_t size);
+extern void * __libc_calloc (size_t count, size_t size);
+extern void * __libc_realloc (void * ptr, size_t size);
+
+void * malloc (size_t size)
+{
+	atomic_fetch_add_explicit (& numAllocations, 1, memory_order_relaxed);
+
+	return __libc_malloc (size);
+}
+
+void * calloc (size_t count, size_t size)
+{
+	atomic_fetch_add_explicit (& numAllocations, 1, memory_order_relaxed);
+
+	return __libc_calloc (count, size);
+}
+
+void * realloc (void * ptr, size_t size)
+{
+	atomic_fetch_add_explicit (& numAllocations, 1, memory_order_relaxed);
+
+	return __libc_realloc (ptr, size);
+}
+
+static BOOL installAllocationCounter (void)
+{
+	return YES;
+}
+
+#else
+
+static BOOL installAllocationCounter (void)
+{
+	return NO;
+}
+
+#endif
+
+static BKCWaveform * makeCustomWaveform (void)
+{
+	BKFrame values [32];
+
+	for (NSUInteger i = 0; i < 32; i ++) {
+		values [i] = (BKFrame) ((i < 16 ? i : 31 - i) * BK_FRAME_MAX / 16);
+	}
+
+	return [[BKCWaveform alloc] initWithValues:values length:32];
+}
+
+static BKCSample * makeSample (UInt32 sampleRate)
+{
+	NSUInteger length = sampleRate / 2;
+	NSMutableData * frames = [[NSMutableData alloc] initWithLength:length * sizeof (SInt16)];
+	SInt16 * values = frames.mutableBytes;
+	BKCSample * sample = [[BKCSample alloc] init];
+
+	for (NSUInteger i = 0; i < length; i ++) {
+		values [i] = (SInt16) (sin (i * 2.0 * M_PI * 440.0 / sampleRate) * BK_FRAME_MAX);
+	}
+
+	if ([sample loadFrames:values dataSize:frames.length numberOfChannels:1 params:BK_16_BIT_SIGNED] < 0) {
+		return nil;
+	}
+
+	return sample;
+}
+
+static BKCInstrument * makeInstrument (void)
+{
+	BKInt const arpeggio [] = {0, 4 * BK_FINT20_UNIT, 7 * BK_FINT20_UNIT};
+	BKCInstrument * instrument = [[BKCInstrument alloc] init];
+
+	[instrument setEnvelopeADSR:2 decay:8 sustain:BK_MAX_VOLUME / 2 release:12];
+	[[instrument sequenceWithType:BK_SEQUENCE_ARPEGGIO] setSequencePhases:arpeggio length:3 sustainRange:NSMakeRange (0, 3)];
+
+	return instrument;
+}
+
+static void applyEffect (BKCTrack * track, BKCBenchmarkEffect effect)
+{
+	switch (effect) {
+		case BKCBenchmarkEffectNone: {
+			break;
+		}
+		case BKCBenchmarkEffectVibrato: {
+			[track setEffect:BK_EFFECT_VIBRATO values:(BKInt const [3]) {12, 2 * BK_FINT20_UNIT, 0}];
+			break;
+		}
+		case BKCBenchmarkEffectTremolo: {
+			[track setEffect:BK_EFFECT_TREMOLO values:(BKInt const [3]) {12, BK_MAX_VOLUME / 2, 0}];
+			break;
+		}
+		case BKCBenchmarkEffectPortamento: {
+			[track setEffect:BK_EFFECT_PORTAMENTO values:(BKInt const [3]) {NOTE_TICKS / 2, 0, 0}];
+			break;
+		}
+		case BKCBenchmarkEffectSlides: {
+			[track setEffect:BK_EFFECT_VOLUME_SLIDE values:(BKInt const [3]) {NOTE_TICKS / 2, 0, 0}];
+			[track setEffect:BK_EFFECT_PANNING_SLIDE values:(BKInt const [3]) {NOTE_TICKS / 2, 0, 0}];
+			break;
+		}
+		default: {
+			break;
+		}
+	}
+}
+
+/**
+ * Create context with tracks which play changing notes
+ */
+static BKCContext * makeContext (BKCBenchmarkCase const * bench, BKCDivider * divider)
+{
+	BKCContext * context = [[BKCContext alloc] initWithNumberOfChannels:NUM_CHANNELS sampleRate:bench -> sampleRate];
+	BKCWaveform * custom = makeCustomWaveform ();
+	BKCSample * sample = bench -> waveform == BKCBenchmarkWaveformSample ? makeSample (bench -> sampleRate) : nil;
+	BKCInstrument * instrument = bench -> instrument ? makeInstrument () : nil;
+	NSMutableArray * tracks = [[NSMutableArray alloc] init];
+	__block NSUInteger step = 0;
+
+	for (NSUInteger i = 0; i < bench -> numTracks; i ++) {
+		BKCTrack * track;
+
+		switch (bench -> waveform) {
+			case BKCBenchmarkWaveformTriangle: track = [[BKCTrack alloc] initWithWaveform:[BKCWaveform triangleWaveform]]; break;
+			case BKCBenchmarkWaveformNoise:    track = [[BKCTrack alloc] initWithWaveform:[BKCWaveform noiseWaveform]]; break;
+			case BKCBenchmarkWaveformSawtooth: track = [[BKCTrack alloc] initWithWaveform:[BKCWaveform sawtoothWaveform]]; break;
+			case BKCBenchmarkWaveformSine:     track = [[BKCTrack alloc] initWithWaveform:[BKCWaveform sineWaveform]]; break;
+			case BKCBenchmarkWaveformCustom:   track = [[BKCTrack alloc] initWithWaveform:custom]; break;
+			default:                           track = [[BKCTrack alloc] initWithWaveform:[BKCWaveform squareWaveform]]; break;
+		}
+
+		if (sample) {
+			track.sample = sample;
+			[track setAttribute:BK_SAMPLE_REPEAT value:BK_REPEAT];
+		}
+
+		if (instrument) {
+			track.instrument = instrument;
+		}
+
+		[track setAttribute:BK_MASTER_VOLUME value:BK_MAX_VOLUME / (BKInt) bench -> numTracks];
+		[track setAttribute:BK_VOLUME value:BK_MAX_VOLUME];
+		[track setAttribute:BK_NOTE value:(BK_C_4 + (BKInt) (i % 24)) * BK_FINT20_UNIT];
+		applyEffect (track, bench -> effect);
+		[track attachToContext:context];
+		[tracks addObject:track];
+	}
+
+	// change notes, volume and panning to drive effects
+	divider.block = ^BKInt (BKCContext * context, BKCallbackInfo * info) {
+		step ++;
+
+		for (NSUInteger i = 0; i < tracks.count; i ++) {
+			BKCTrack * track = tracks [i];
+
+			[track setAttribute:BK_NOTE value:(BK_C_4 + (BKInt) ((i + step * 5) % 24)) * BK_FINT20_UNIT];
+			[track setAttribute:BK_VOLUME value:step & 1 ? BK_MAX_VOLUME / 4 : BK_MAX_VOLUME];
+			[track setAttribute:BK_PANNING value:step & 1 ? -BK_MAX_VOLUME / 2 : BK_MAX_VOLUME / 2];
+		}
+
+		return 0;
+	};
+
+	[divider attachToContext:context];
+
+	return context;
+}
+
+/**
+ * Generate a buffer in the output format of the case
+ */
+static BKInt generateFrames (BKCContext * context, BKCBenchmarkCase const * bench, void * const * buffers)
+{
+	switch (bench -> output) {
+		case BKCBenchmarkOutputInt16Planar: {
+			return [context generateFrames:buffers numberFrames:bench -> bufferSize sampleFormat:BKCSampleFormatInt16 interleaved:NO];
+		}
+		case BKCBenchmarkOutputFloat32: {
+			return [context generateFrames:buffers numberFrames:bench -> bufferSize sampleFormat:BKCSampleFormatFloat32 interleaved:YES];
+		}
+		case BKCBenchmarkOutputFloat32Planar: {
+			return [context generateFrames:buffers numberFrames:bench -> bufferSize sampleFormat:BKCSampleFormatFloat32 interleaved:NO];
+		}
+		default: {
+			return [context generateFrames:(SInt16 *) buffers [0] numberFrames:bench -> bufferSize];
+		}
+	}
+}
+
+/**
+ * Compare output of all supported kernels with the scalar kernels
+ */
+static BOOL verifyKernels (void)
+{
+	BOOL success = YES;
+	NSUInteger const numFrames = 4099;
+	NSUInteger const size = numFrames * NUM_CHANNELS;
+	BKCOutputKernelType type = BKCOutputGetKernelType ();
+	NSMutableData * input = [[NSMutableData alloc] initWithLength:size * sizeof (SInt16)];
+	NSData * reference = nil;
+	SInt16 * frames = input.mutableBytes;
+
+	for (NSUInteger i = 0; i < size; i ++) {
+		frames [i] = (SInt16) arc4random ();
+	}
+
+	frames [0] = INT16_MIN;
+	frames [1] = INT16_MAX;
+
+	for (NSInteger t = 0; t < BKCOutputKernelTypeCount; t ++) {
+		NSMutableData * output = [[NSMutableData alloc] initWithLength:size * (sizeof (float) * 2 + sizeof (SInt16) * 2)];
+		float * floats = output.mutableBytes;
+		float * planarFloats = floats + size;
+		SInt16 * planar = (SInt16 *) (planarFloats + size);
+		SInt16 * mixed = planar + size;
+		float * floatBuffers [NUM_CHANNELS] = {planarFloats, planarFloats + numFrames};
+		SInt16 * buffers [NUM_CHANNELS] = {planar, planar + numFrames};
+
+		if (!BKCOutputSetKernelType (t)) {
+			continue;
+		}
+
+		BKCOutputInt16ToFloat (floats, frames, size);
+		BKCOutputDeinterleaveFloat (floatBuffers, 0, frames, numFrames, NUM_CHANNELS);
+		BKCOutputDeinterleaveInt16 (buffers, 0, frames, numFrames, NUM_CHANNELS);
+
+		memcpy (mixed, frames, size * sizeof (SInt16));
+		BKCOutputMixInt16 (mixed, frames, size);
+
+		if (t == BKCOutputKernelTypeScalar) {
+			reference = output;
+		}
+		else if (![output isEqualToData:reference]) {
+			fprintf (stderr, "*** Output of %s kernels differs from scalar kernels\n", BKCOutputKernelTypeName (t));
+			success = NO;
+		}
+	}
+
+	BKCOutputSetKernelType (type);
+
+	return success;
+}
+
+static BOOL runCase (BKCBenchmarkCase const * bench, NSTimeInterval duration, BKCBenchmarkResult * result)
+{
+	UInt64 startTime, startAllocations;
+	UInt64 numFrames = 0;
+	UInt64 warmupFrames = (UInt64) (bench -> sampleRate * WARMUP_DURATION);
+	UInt64 maxFrames = (UInt64) (bench -> sampleRate * duration);
+	BKCDivider * divider = [[BKCDivider alloc] initWithTicks:NOTE_TICKS];
+	BKCContext * context = makeContext (bench, divider);
+	NSMutableData * buffer = [[NSMutableData alloc] initWithLength:bench -> bufferSize * NUM_CHANNELS * sizeof (float)];
+	void * buffers [NUM_CHANNELS];
+
+	if (context == nil || !BKCOutputSetKernelType (bench -> kernel)) {
+		return NO;
+	}
+
+	for (NSUInteger c = 0; c < NUM_CHANNELS; c ++) {
+		buffers [c] = (char *) buffer.mutableBytes + c * bench -> bufferSize * sizeof (float);
+	}
+
+	for (UInt64 i = 0; i < warmupFrames; i += bench -> bufferSize) {
+		if (generateFrames (context, bench, buffers) < 0) {
+			return NO;
+		}
+	}
+
+	startAllocations = atomic_load (& numAllocations);
+	startTime = BKCRenderClockNow ();
+
+	while (numFrames < maxFrames) {
+		if (generateFrames (context, bench, buffers) < 0) {
+			return NO;
+		}
+
+		numFrames += bench -> bufferSize;
+	}
+
+	result -> time           = BKCRenderClockNow () - startTime;
+	result -> numAllocations = atomic_load (& numAllocations) - startAllocations;
+	result -> numFrames      = numFrames;
+
+	[divider detach];
+
+	return YES;
+}
+
+static void printResult (BKCBenchmarkFormat format, BKCBenchmarkCase const * bench, BKCBenchmarkResult const * result, BOOL first)
+{
+	double seconds = result -> time * 1e-9;
+	double framesPerSecond = seconds > 0 ? result -> numFrames / seconds : 0;
+	double nsPerFrameTrack = (double) result -> time / result -> numFrames / bench -> numTracks;
+
+	if (format == BKCBenchmarkFormatCSV) {
+		printf ("%s,%lu,%s,%s,%d,%u,%u,%s,%s,%llu,%.6f,%.1f,%.3f,%llu\n",
+			bench -> sweep, (unsigned long) bench -> numTracks, waveformNames [bench -> waveform], effectNames [bench -> effect],
+			bench -> instrument, bench -> sampleRate, bench -> bufferSize, outputNames [bench -> output],
+			BKCOutputKernelTypeName (bench -> kernel), (unsigned long long) result -> numFrames, seconds, framesPerSecond,
+			nsPerFrameTrack, (unsigned long long) result -> numAllocations);
+	}
+	else {
+		printf ("%s\t\t{\"sweep\": \"%s\", \"tracks\": %lu, \"waveform\": \"%s\", \"effect\": \"%s\", \"instrument\": %s, "
+			"\"sampleRate\": %u, \"bufferSize\": %u, \"output\": \"%s\", \"kernel\": \"%s\", \"frames\": %llu, "
+			"\"seconds\": %.6f, \"framesPerSecond\": %.1f, \"nsPerFrameTrack\": %.3f, \"allocations\": %llu}",
+			first ? "" : ",\n", bench -> sweep, (unsigned long) bench -> numTracks, waveformNames [bench -> waveform],
+			effectNames [bench -> effect], bench -> instrument ? "true" : "false", bench -> sampleRate, bench -> bufferSize,
+			outputNames [bench -> output], BKCOutputKernelTypeName (bench -> kernel), (unsigned long long) result -> numFrames,
+			seconds, framesPerSecond, nsPerFrameTrack, (unsigned long long) result -> numAllocations);
+	}
+
+	fflush (stdout);
+}
+
+static NSArray * makeCases (void)
+{
+	NSMutableArray * cases = [[NSMutableArray alloc] init];
+	BKCBenchmarkCase bench;
+
+#define ADD_CASE(name, field, value) \
+	bench = baseline; \
+	bench.sweep = name; \
+	bench.field = value; \
+	[cases addObject:[NSValue valueWithBytes:& bench objCType:@encode (BKCBenchmarkCase)]];
+
+	for (NSUInteger i = 0; i < sizeof (trackCounts) / sizeof (*trackCounts); i ++) {
+		ADD_CASE ("tracks", numTracks, trackCounts [i]);
+	}
+
+	for (NSUInteger i = 0; i < BKCBenchmarkWaveformCount; i ++) {
+		ADD_CASE ("waveform", waveform, i);
+	}
+
+	for (NSUInteger i = 0; i < BKCBenchmarkEffectCount; i ++) {
+		ADD_CASE ("effect", effect, i);
+	}
+
+	for (NSUInteger i = 0; i < 2; i ++) {
+		ADD_CASE ("instrument", instrument, i);
+	}
+
+	for (NSUInteger i = 0; i < sizeof (sampleRates) / sizeof (*sampleRates); i ++) {
+		ADD_CASE ("sampleRate", sampleRate, sampleRates [i]);
+	}
+
+	for (NSUInteger i = 0; i < sizeof (bufferSizes) / sizeof (*bufferSizes); i ++) {
+		ADD_CASE ("bufferSize", bufferSize, bufferSizes [i]);
+	}
+
+	// output conversion with each supported kernel
+	for (NSUInteger i = 0; i < BKCBenchmarkOutputCount; i ++) {
+		for (NSInteger k = 0; k < BKCOutputKernelTypeCount; k ++) {
+			if (BKCOutputKernelTypeIsSupported (k)) {
+				bench = baseline;
+				bench.sweep  = "output";
+				bench.output = i;
+				bench.kernel = k;
+				[cases addObject:[NSValue valueWithBytes:& bench objCType:@encode (BKCBenchmarkCase)]];
+			}
+		}
+	}
+
+#undef ADD_CASE
+
+	return cases;
+}
+
+static void printUsage (char const * name)
+{
+	fprintf (stderr, "usage: %s [-f json|csv] [-d seconds] [-s sweep]\n"
+		"  -f  output format (default json)\n"
+		"  -d  seconds of audio rendered per case (default %.0f)\n"
+		"  -s  only run cases of sweep: tracks, waveform, effect, instrument, sampleRate, bufferSize, output\n",
+		name, DEFAULT_DURATION);
+}
+
+int main (int argc, char * const argv [])
+{
+	@autoreleasepool {
+		int opt;
+		BOOL first = YES;
+		BOOL success = YES;
+		char const * sweep = NULL;
+		NSTimeInterval duration = DEFAULT_DURATION;
+		BKCBenchmarkFormat format = BKCBenchmarkFormatJSON;
+		BKCBenchmarkCase bench;
+		BKCBenchmarkResult result;
+
+		while ((opt = getopt (argc, argv, "f:d:s:h")) != -1) {
+			switch (opt) {
+				case 'f': {
+					if (strcmp (optarg, "csv") == 0) {
+						format = BKCBenchmarkFormatCSV;
+					}
+					else if (strcmp (optarg, "json") != 0) {
+						printUsage (argv [0]);
+						return 1;
+					}
+					break;
+				}
+				case 'd': {
+					duration = MAX (atof (optarg), 0.01);
+					break;
+				}
+				case 's': {
+					sweep = optarg;
+					break;
+				}
+				default: {
+					printUsage (argv [0]);
+					return 1;
+				}
+			}
+		}
+
+		baseline.kernel = BKCOutputGetKernelType ();
+
+		if ((sweep == NULL || strcmp (sweep, "output") == 0) && verifyKernels () == NO) {
+			success = NO;
+		}
+
+		if (installAllocationCounter () == NO) {
+			fprintf (stderr, "*** Couldn't install allocation counter; allocations are not counted\n");
+		}
+
+		if (format == BKCBenchmarkFormatCSV) {
+			printf ("sweep,tracks,waveform,effect,instrument,sampleRate,bufferSize,output,kernel,frames,seconds,framesPerSecond,nsPerFrameTrack,allocations\n");
+		}
+		else {
+			printf ("{\n\t\"version\": %d,\n\t\"duration\": %.3f,\n\t\"results\": [\n", BENCHMARK_VERSION, duration);
+		}
+
+		for (NSValue * value in makeCases ()) {
+			[value getValue:& bench];
+
+			if (sweep && strcmp (sweep, bench.sweep) != 0) {
+				continue;
+			}
+
+			@autoreleasepool {
+				if (runCase (& bench, duration, & result) == NO) {
+					fprintf (stderr, "*** Case failed: %s\n", bench.sweep);
+					success = NO;
+					continue;
+				}
+			}
+
+			printResult (format, & bench, & result, first);
+			first = NO;
+		}
+
+		if (format == BKCBenchmarkFormatJSON) {
+			printf ("\n\t]\n}\n");
+		}
+
+		return success ? 0 : 1;
+	}
+}
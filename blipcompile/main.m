@@ -0,0 +1,227 @@
+/**
+ * Copyright (c) 2014 Simon Schoenenberger
+ * http://blipkit.monoxid.net/
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+#import <getopt.h>
+#import "BKCCompiler.h"
+#import "BKCContext.h"
+#import "BKCProgram.h"
+#import "BKCLoadStatistics.h"
+#import "BKCProgramArchive.h"
+#import "BKCRealtimeChecker.h"
+
+#define ARCHIVE_EXTENSION @"blipc"
+
+static void printUsage (char const * name)
+{
+	fprintf (stderr, "usage: %s [-c] [-p] [-t seconds] [-o output] file ...\n"
+		"  -o  output file; only with a single input file\n"
+		"      default is the input file with extension .blipc\n"
+		"  -c  load each written archive again to check it\n"
+		"  -p  print compile and attach profile of each file as JSON\n"
+		"  -t  render each archive offline for seconds and fail on\n"
+		"      real-time violations; needs BKC_REALTIME_CHECKS\n", name);
+}
+
+/**
+ * Print load statistics of phase as JSON line
+ */
+static void printLoadStatistics (NSString * path, NSString * phase, BKCLoadStatistics const * statistics)
+{
+	NSMutableDictionary * dict = [BKCLoadStatisticsDictionary (statistics) mutableCopy];
+	NSData * json;
+
+	dict [@"file"]  = path;
+	dict [@"phase"] = phase;
+
+	if ((json = [NSJSONSerialization dataWithJSONObject:dict options:0 error:NULL])) {
+		fwrite (json.bytes, 1, json.length, stdout);
+		fputc ('\n', stdout);
+	}
+}
+
+/**
+ * Attach program to a context and print attach statistics
+ */
+static BOOL profileAttach (BKCProgram * program, NSString * path)
+{
+	BKCContext * context = [[BKCContext alloc] init];
+	BKCLoadStatistics statistics;
+
+	if (context == nil || [context addTracksFromProgram:program] == NO) {
+		fprintf (stderr, "*** Couldn't attach %s\n", path.UTF8String);
+		return NO;
+	}
+
+	statistics = context.lastAttachStatistics;
+	printLoadStatistics (path, @"attach", & statistics);
+
+	return YES;
+}
+
+/**
+ * Render program offline and report real-time violations
+ */
+static BOOL checkRealtimeSafety (BKCProgram * program, NSString * path, NSTimeInterval duration)
+{
+	BKCContext * context = [[BKCContext alloc] init];
+
+	if (context == nil || [context addTracksFromProgram:program] == NO) {
+		fprintf (stderr, "*** Couldn't attach %s\n", path.UTF8String);
+		return NO;
+	}
+
+	BKCRealtimeReset ();
+
+	if ([context renderWithChunkHandler:^BOOL (SInt16 const * frames, UInt32 numberFrames) {
+		return YES;
+	} duration:duration] == NO) {
+		fprintf (stderr, "*** Couldn't render %s\n", path.UTF8String);
+		return NO;
+	}
+
+	if (BKCRealtimeTotalViolationCount ()) {
+		fprintf (stderr, "*** %s violates real-time safety\n%s", path.UTF8String, BKCRealtimeReport ().UTF8String);
+		return NO;
+	}
+
+	return YES;
+}
+
+/**
+ * Compile source file and write archive
+ */
+static BOOL convertFile (NSString * inputPath, NSString * outputPath, BOOL check, BOOL profile, NSTimeInterval renderDuration)
+{
+	NSError * error = nil;
+	NSData * source = [NSData dataWithContentsOfFile:inputPath options:0 error:& error];
+	BKCCompiler * compiler = [[BKCCompiler alloc] init];
+	BKCProgram * program;
+	BKCLoadStatistics statistics;
+	NSData * archive;
+
+	if (source == nil) {
+		fprintf (stderr, "*** Couldn't read %s: %s\n", inputPath.UTF8String, error.localizedDescription.UTF8String);
+		return NO;
+	}
+
+	// needed to archive the commands
+	compiler.recordsCommandPointers = YES;
+
+	if ([compiler compileData:source error:& error] == NO || (program = [compiler program]) == nil) {
+		fprintf (stderr, "*** Couldn't compile %s: %s", inputPath.UTF8String, error.localizedDescription.UTF8String);
+		return NO;
+	}
+
+	if (profile) {
+		statistics = compiler.lastCompileStatistics;
+		printLoadStatistics (inputPath, @"compile", & statistics);
+
+		if (profileAttach (program, inputPath) == NO) {
+			return NO;
+		}
+	}
+
+	if ((archive = [program archivedDataWithError:& error]) == nil) {
+		fprintf (stderr, "*** Couldn't archive %s: %s\n", inputPath.UTF8String, error.localizedDescription.UTF8String);
+		return NO;
+	}
+
+	if ([archive writeToFile:outputPath options:NSDataWritingAtomic error:& error] == NO) {
+		fprintf (stderr, "*** Couldn't write %s: %s\n", outputPath.UTF8String, error.localizedDescription.UTF8String);
+		return NO;
+	}
+
+	if (check || renderDuration > 0.0) {
+		program = [BKCProgram programWithContentsOfArchiveFile:outputPath error:& error];
+
+		if (program == nil) {
+			fprintf (stderr, "*** Archive %s doesn't load back: %s\n", outputPath.UTF8String, error.localizedDescription.UTF8String);
+			return NO;
+		}
+	}
+
+	if (renderDuration > 0.0) {
+		return checkRealtimeSafety (program, outputPath, renderDuration);
+	}
+
+	return YES;
+}
+
+int main (int argc, char * const argv [])
+{
+	@autoreleasepool {
+		int opt;
+		BOOL check = NO;
+		BOOL profile = NO;
+		BOOL success = YES;
+		NSString * outputPath = nil;
+		NSTimeInterval renderDuration = 0.0;
+
+		while ((opt = getopt (argc, argv, "cpo:t:h")) != -1) {
+			switch (opt) {
+				case 'c': {
+					check = YES;
+					break;
+				}
+				case 'p': {
+					profile = YES;
+					break;
+				}
+				case 't': {
+					renderDuration = MAX (atof (optarg), 0.01);
+					break;
+				}
+				case 'o': {
+					outputPath = [NSString stringWithUTF8String:optarg];
+					break;
+				}
+				default: {
+					printUsage (argv [0]);
+					return 1;
+				}
+			}
+		}
+
+		if (optind >= argc || (outputPath && argc - optind > 1)) {
+			printUsage (argv [0]);
+			return 1;
+		}
+
+		if (renderDuration > 0.0 && BKCRealtimeCheckerInstall () == NO) {
+			fprintf (stderr, "*** Real-time checks are not available; build with BKC_REALTIME_CHECKS=1\n");
+			return 1;
+		}
+
+		for (int i = optind; i < argc; i ++) {
+			NSString * inputPath = [NSString stringWithUTF8String:argv [i]];
+			NSString * path = outputPath ?: [inputPath.stringByDeletingPathExtension stringByAppendingPathExtension:ARCHIVE_EXTENSION];
+
+			if (convertFile (inputPath, path, check, profile, renderDuration) == NO) {
+				success = NO;
+			}
+		}
+
+		return success ? 0 : 1;
+	}
+}